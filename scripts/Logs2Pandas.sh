@@ -22,8 +22,8 @@ do
     CallRR ${bf} ${rfn}_img_tmp_D.csv ${rfn}_callrr.rpt
     grep '^H' rx_${rfn}_callrr.rpt | awk '{ print $2; }' | sort > ${rfn}_exclude_calls.lis
     # now remove the possible problem RX stations
-    grep -v -f ${rfn}_exclude_calls.lis ${rfn}_img_tmp.csv > ${rfn}_img.csv
-    grep -v -f ${rfn}_exclude_calls.lis ${bf} > ${rfn}_clean.csv
+    WSPRLogExclude --calls ${rfn}_exclude_calls.lis ${rfn}_img_tmp.csv ${rfn}_img.csv
+    WSPRLogExclude --calls ${rfn}_exclude_calls.lis ${bf} ${rfn}_clean.csv
     # remove the junk files
     rm ${rfn}_img_tmp.csv [rt]x_${rfn}_callrr.rpt ${rfn}_img_tmp_*.csv 
 
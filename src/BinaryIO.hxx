@@ -0,0 +1,36 @@
+#ifndef BINARYIO_HDR
+#define BINARYIO_HDR
+#include <iostream>
+#include <string>
+#include <cstdint>
+
+// Reading and writing the binary files (partials, sketches) that
+// the tools save for later merging.  Values go out in the byte
+// order of the machine.  Strings are a uint32 length and then the
+// characters.
+namespace BinaryIO {
+  template<typename T> inline void put(std::ostream & os, T v) {
+    os.write((const char *) &v, sizeof(T));
+  }
+
+  template<typename T> inline bool get(std::istream & is, T & v) {
+    is.read((char *) &v, sizeof(T));
+    return is.good();
+  }
+
+  inline void putString(std::ostream & os, const std::string & s) {
+    put<uint32_t>(os, s.size());
+    os.write(s.data(), s.size());
+  }
+
+  // no name in any of our files is anywhere near max_len long, so a
+  // longer one means the file is damaged
+  inline bool getString(std::istream & is, std::string & s, uint32_t max_len = 4096) {
+    uint32_t len;
+    if(!get(is, len) || (len > max_len)) return false;
+    s.resize(len);
+    if(len > 0) is.read(&s[0], len);
+    return is.good();
+  }
+}
+#endif
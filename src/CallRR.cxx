@@ -1,5 +1,7 @@
 #include "WSPRLog.hxx"
 #include "SolarTime.hxx"
+#include "FlatCounter.hxx"
+#include "SpaceSaving.hxx"
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
 #include <string>
@@ -8,6 +10,7 @@
 #include <list>
 #include <math.h>
 #include <set>
+#include <vector>
 
 // accumulate number of reports per callsign -- this is
 // useful in identifying stations that may have multiple
@@ -18,20 +21,17 @@
 // extract a list of possible bad sources like this:
 // CallRR raw_band_file.csv band_file_D.csv band_file_dups.rpt
 // grep "^H" band_file_dups.rpt | awk '{ print $2; }' > band_excludes.lis
-// grep -v -f band_excludes.lis raw_band_file.csv > clean_band_file.csv
+// WSPRLogExclude --calls band_excludes.lis raw_band_file.csv clean_band_file.csv
 //
 // now do the D, 50Hz, 60Hz splits.
 // and the rest.
 
-class myWSPRLog : public WSPRLog {
+class myAccumulator : public WSPRLogAccumulator {
 public:
-  myWSPRLog() : WSPRLog() {
+  myAccumulator() {
     exc_mode = false;
   }
 
-  ~myWSPRLog() {
-  }
-
 
   class CountRec {
   public:
@@ -55,32 +55,57 @@ public:
     unsigned int rx_exception; 
     unsigned int tx_standard; 
     unsigned int tx_exception; 
+
+    void merge(const CountRec & other) {
+      rx_standard += other.rx_standard; 
+      rx_exception += other.rx_exception; 
+      tx_standard += other.tx_standard; 
+      tx_exception += other.tx_exception; 
+    }
   }; 
 
+  // a clone knows all the calls we've seen so far (the standard
+  // log only counts those), but has no counts.
+  WSPRLogAccumulator * clone() const { 
+    myAccumulator * ret = new myAccumulator(); 
+    ret->exc_mode = exc_mode; 
+    ret->calls = calls; 
+    ret->call_table.resize(call_table.size()); 
+    return ret; 
+  }
+
+  void merge(const WSPRLogAccumulator & other) {
+    const myAccumulator & o = static_cast<const myAccumulator &>(other); 
+    for(size_t oid = 0; oid < o.call_table.size(); oid++) {
+      int id = calls.intern(o.calls.name(oid)); 
+      if(id >= (int) call_table.size()) call_table.resize(id + 1); 
+      call_table[id].merge(o.call_table[oid]); 
+    }
+    totals.merge(o.totals); 
+  }
+
 
   void setExcMode(bool fl) { exc_mode = fl; }
 
   void incEntry(const std::string & call, bool is_rx)
   {
-    if(call_table.find(call) == call_table.end()) {
+    int id = calls.find(call); 
+    if(id < 0) {
       // we only collect exc reports
       if(!exc_mode) return; 
-      CountRec * cr = new CountRec(); 
-      call_table[call] = cr; 
+      id = calls.intern(call); 
+      call_table.push_back(CountRec()); 
     }
 
-    call_table[call]->bump(is_rx, exc_mode);
+    call_table[id].bump(is_rx, exc_mode);
     
     totals.bump(is_rx, exc_mode); 
   }
 
 
-  bool processEntry(WSPRLogEntry * ent) {
-    if(ent == NULL) return false; 
-    
+  void add(WSPRLogEntry * ent) {
     incEntry(ent->rxcall, true); 
     incEntry(ent->txcall, false); 
-    return true; 
   }
 
   void dumpTables(const std::string & fname) {
@@ -92,8 +117,14 @@ public:
 
     rxos << "# call std:rx_ct exc:rx_ct er/esum er/sr (er/sr)/(esum/ssum)\n";
     txos << "# call std:tx_ct exc:tx_ct et/esum et/st (et/st)/(esum/ssum)\n";
-    for(auto ent: call_table) {
-      CountRec *crp = ent.second; 
+    // print in call sign order
+    std::vector<int> ids(call_table.size()); 
+    for(size_t i = 0; i < ids.size(); i++) ids[i] = i; 
+    calls.sortByName(ids); 
+
+    for(auto id: ids) {
+      const std::string & call = calls.name(id); 
+      CountRec *crp = &call_table[id]; 
       float er = (float) crp->rx_exception;
       float et = (float) crp->tx_exception;
       float sr = (float) crp->rx_standard; 
@@ -104,7 +135,7 @@ public:
       if (crp->rx_exception != 0) {
 	rxos << boost::format("%c %12s %6d %6d %10g %10g %g\n")
 	  % excess_char
-	  % ent.first
+	  % call
 	  % crp->rx_standard % crp->rx_exception 
 	  % (er / esum) % (er / sr) 
 	  % ((er/sr)/(esum/ssum));
@@ -114,7 +145,7 @@ public:
       if (crp->tx_exception != 0) {
 	txos << boost::format("%c %12s %6d %6d %10g %10g %g\n")
 	  % excess_char
-	  % ent.first
+	  % call
 	  % crp->tx_standard % crp->tx_exception 
 	  % (et / esum) % (et / st) 
 	  % ((et/st)/(esum/ssum));
@@ -127,15 +158,125 @@ public:
 
 private:
   bool exc_mode; 
-  std::map<std::string, CountRec *> call_table;
+  // indexed by call id
+  StringInterner calls; 
+  std::vector<CountRec> call_table;
   CountRec totals; 
 
 }; 
 
+// --top N: only the N rx calls, tx calls, or tx/rx paths with the most
+// exception reports (or the highest exception ratio).  The exception
+// counts come from a Space-Saving summary, so memory stays the same
+// however many stations there are, and the standard log is only
+// counted for the keys in the summary.
+class myTopAccumulator : public WSPRLogAccumulator {
+public:
+  enum KeyType { RX, TX, PAIR };
+
+  myTopAccumulator(KeyType _key_type, size_t _counters) : summary(_counters) {
+    key_type = _key_type;
+    counters = _counters;
+    exc_mode = false;
+    exc_total = std_total = 0;
+  }
+
+  // the standard log only counts keys already in the summary, so
+  // a clone for that pass needs a copy of it.
+  WSPRLogAccumulator * clone() const {
+    myTopAccumulator * ret = new myTopAccumulator(key_type, counters);
+    ret->exc_mode = exc_mode;
+    if(!exc_mode) ret->summary = summary;
+    return ret;
+  }
+
+  void merge(const WSPRLogAccumulator & other) {
+    const myTopAccumulator & o = static_cast<const myTopAccumulator &>(other);
+    if(exc_mode) summary.merge(o.summary);
+    std_counts.merge(o.std_counts);
+    exc_total += o.exc_total;
+    std_total += o.std_total;
+  }
+
+  void setExcMode(bool fl) { exc_mode = fl; }
+
+  void add(WSPRLogEntry * ent) {
+    uint64_t key;
+    switch (key_type) {
+    case RX:
+      key = stableHash(ent->rxcall);
+      break;
+    case TX:
+      key = stableHash(ent->txcall);
+      break;
+    default:
+      key = stableHash(stableHash(ent->txcall), stableHash(ent->rxcall));
+      break;
+    }
+
+    if(exc_mode) {
+      exc_total++;
+      if(key_type == PAIR) summary.add(key, ent->txcall + " " + ent->rxcall);
+      else summary.add(key, (key_type == RX) ? ent->rxcall : ent->txcall);
+    }
+    else {
+      std_total++;
+      if(summary.contains(key)) std_counts.add(key);
+    }
+  }
+
+  void dumpTables(const std::string & fname, size_t top, bool by_ratio) {
+    std::ofstream os(fname);
+
+    std::vector<SpaceSaving::Entry> ents;
+    summary.entries(ents);
+    if(by_ratio) {
+      // ratio of the exception count we're sure of
+      std::stable_sort(ents.begin(), ents.end(),
+		       [this](const SpaceSaving::Entry & a, const SpaceSaving::Entry & b) {
+			 return excRatio(a) > excRatio(b);
+		       });
+    }
+    if(ents.size() > top) ents.resize(top);
+
+    float esum = (float) exc_total;
+    float ssum = (float) std_total;
+    const char * key_names[] = { "rx call", "tx call", "tx call, rx call" };
+    os << boost::format("# top %d by %s of %d counters.  exc counts are high by at most err (err <= %d)\n")
+      % top % (by_ratio ? "exc ratio" : "exc count") % counters % summary.minCount();
+    os << boost::format("# %s, std_ct exc_ct err e/esum e/s (e/s)/(esum/ssum)\n") % key_names[key_type];
+    for(auto & e: ents) {
+      float ec = (float) e.count;
+      float sc = (float) std_counts.get(e.key);
+      os << boost::format("%s %6d %6d %6d %10g %10g %g\n")
+	% e.name % std_counts.get(e.key) % e.count % e.err
+	% (ec / esum) % (ec / sc)
+	% ((ec / sc) / (esum / ssum));
+    }
+    os.close();
+  }
+
+private:
+  double excRatio(const SpaceSaving::Entry & e) const {
+    uint64_t sc = std_counts.get(e.key);
+    return (sc == 0) ? 0.0 : (((double) (e.count - e.err)) / ((double) sc));
+  }
+
+  KeyType key_type;
+  size_t counters;
+  bool exc_mode;
+  SpaceSaving summary;
+  // standard counts, only for the keys in the summary
+  FlatCounter<uint64_t, uint64_t> std_counts;
+  uint64_t exc_total, std_total;
+};
+
 int main(int argc, char * argv[])
 {
   bool input_gzipped; 
-  std::string std_name, exc_name, report_name; 
+  int num_threads; 
+  std::string std_name, exc_name, report_name, key_name, rank_name; 
+  int top, counters; 
   namespace po = boost::program_options;
 
   po::options_description desc("Options:");
@@ -144,7 +285,12 @@ int main(int argc, char * argv[])
     ("help", "help message")
     ("standard", po::value<std::string>(&std_name)->required(), "WSPR log for baseline reports")
     ("exception", po::value<std::string>(&exc_name)->required(), "WSPR log for baseline reports")
-    ("report", po::value<std::string>(&report_name)->required(), "Output data file containing calls, and risk ratios");
+    ("report", po::value<std::string>(&report_name)->required(), "Output data file containing calls, and risk ratios")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of worker threads")
+    ("top", po::value<int>(&top), "Only report the top N keys, counted in bounded memory")
+    ("key", po::value<std::string>(&key_name)->default_value("rx"), "With --top: count by rx call (rx), tx call (tx), or tx/rx path (pair)")
+    ("rank", po::value<std::string>(&rank_name)->default_value("count"), "With --top: rank by exception count (count) or exception ratio (ratio)")
+    ("counters", po::value<int>(&counters)->default_value(0), "With --top: number of counters to keep (default 10 x top).  Counts are within (exception reports)/counters.");
   
   po::positional_options_description pos_opts ;
   pos_opts.add("standard", 1);
@@ -181,13 +327,46 @@ int main(int argc, char * argv[])
 
 
 
-  myWSPRLog wlog;
+  WSPRLog wlog;
+
+  if(vm.count("top")) {
+    myTopAccumulator::KeyType key_type; 
+    if(key_name == "rx") key_type = myTopAccumulator::RX; 
+    else if(key_name == "tx") key_type = myTopAccumulator::TX; 
+    else if(key_name == "pair") key_type = myTopAccumulator::PAIR; 
+    else {
+      std::cerr << "ERROR: key must be one of rx, tx, or pair" << std::endl; 
+      exit(-1); 
+    }
+    if((rank_name != "count") && (rank_name != "ratio")) {
+      std::cerr << "ERROR: rank must be count or ratio" << std::endl; 
+      exit(-1); 
+    }
+    if(top < 1) {
+      std::cerr << "ERROR: top must be at least 1" << std::endl; 
+      exit(-1); 
+    }
+    if(counters < top) counters = 10 * top; 
+
+    myTopAccumulator tacc(key_type, counters); 
+
+    tacc.setExcMode(true);
+    wlog.readLog(exc_name, input_gzipped, tacc, num_threads);
+
+    tacc.setExcMode(false);
+    wlog.readLog(std_name, input_gzipped, tacc, num_threads);
+
+    tacc.dumpTables(report_name, top, rank_name == "ratio"); 
+    return 0; 
+  }
+
+  myAccumulator acc; 
 
-  wlog.setExcMode(true);
-  wlog.readLog(exc_name, input_gzipped);
+  acc.setExcMode(true);
+  wlog.readLog(exc_name, input_gzipped, acc, num_threads);
   
-  wlog.setExcMode(false);
-  wlog.readLog(std_name, input_gzipped);
+  acc.setExcMode(false);
+  wlog.readLog(std_name, input_gzipped, acc, num_threads);
   
-  wlog.dumpTables(report_name);
+  acc.dumpTables(report_name);
 }
@@ -11,6 +11,14 @@
 
 double ChiSquared::pearsonCTS(const std::vector<int> & S, 
 		  const std::vector<int> & X)
+{
+  std::vector<uint64_t> S64(S.begin(), S.end());
+  std::vector<uint64_t> X64(X.begin(), X.end());
+  return pearsonCTS(S64, X64);
+}
+
+double ChiSquared::pearsonCTS(const std::vector<uint64_t> & S, 
+			      const std::vector<uint64_t> & X, bool check)
 {
   // The inputs S[i] and X[i] are in the form of "number of samples in
   // category [i] for the "standard" case (the histogram that fits
@@ -18,8 +26,8 @@ double ChiSquared::pearsonCTS(const std::vector<int> & S,
   
   // first make the p[i] (normative probability of an occurance in
   // bucket [i].
-  int num_Ssamps = 0;
-  int N = 0;   
+  uint64_t num_Ssamps = 0;
+  uint64_t N = 0;   
   for(int i = 0; i < S.size(); i++) {
     num_Ssamps += S[i];
     N += X[i];     
@@ -33,17 +41,22 @@ double ChiSquared::pearsonCTS(const std::vector<int> & S,
   }
 
   // check
-  double sum_c = 0.0; 
-  for(double pi: p) {
-    sum_c += pi; 
+  if(check) {
+    double sum_c = 0.0; 
+    for(double pi: p) {
+      sum_c += pi; 
+    }
+    std::cerr << "sum_c = " << sum_c << " (1-sum_c) = " << (1.0 - sum_c) << std::endl; 
   }
-  std::cerr << "sum_c = " << sum_c << " (1-sum_c) = " << (1.0 - sum_c) << std::endl; 
 
   double X2 = -1.0 * ((double) N);
   
   for(int i = 0; i < S.size(); i++) {
-    double m = N * p[i]; 
+    double m = ((double) N) * p[i]; 
     double xi = ((double) X[i]); 
+    // an empty bucket adds nothing, even where S is empty too
+    if(X[i] == 0) continue; 
+    if(S[i] == 0) return HUGE_VAL; 
     
     X2 += (xi * xi / m); 
   }
@@ -53,9 +66,32 @@ double ChiSquared::pearsonCTS(const std::vector<int> & S,
 
 double ChiSquared::test(const std::vector<int> & S, const std::vector<int> X)
 {
-  int k = S.size(); 
-  
-  return 1.0 - boost::math::gamma_p(((double) k) * 0.5, pearsonCTS(S, X) * 0.5);
+  std::vector<uint64_t> S64(S.begin(), S.end());
+  std::vector<uint64_t> X64(X.begin(), X.end());
+  return test(S64, X64);
+}
+
+bool ChiSquared::impossible(const std::vector<uint64_t> & S, const std::vector<uint64_t> & X)
+{
+  for(size_t i = 0; i < S.size(); i++) {
+    if((S[i] == 0) && (X[i] != 0)) return true; 
+  }
+  return false; 
+}
+
+double ChiSquared::test(const std::vector<uint64_t> & S, const std::vector<uint64_t> & X)
+{
+  // checked here rather than by looking for an infinite X^2, which
+  // -ffast-math lets the compiler assume away
+  if(impossible(S, X)) return 0.0; 
+  return significance(pearsonCTS(S, X), S.size()); 
+}
+
+double ChiSquared::significance(double X2, int k)
+{
+  // a perfect fit can come out a hair below zero
+  if(X2 <= 0.0) return 1.0; 
+  return 1.0 - boost::math::gamma_p(((double) k) * 0.5, X2 * 0.5);
 }
 
 
@@ -2,8 +2,21 @@
 #define CHISQUARED_HDR
 
 #include <vector>
+#include <cstdint>
 
 namespace ChiSquared {
+  // 64 bit counts, so a big histogram's totals don't overflow.
+  // check prints the sum of the standard's proportions on std::cerr.
+  // X^2 is HUGE_VAL where impossible(S, X).
+  double pearsonCTS(const std::vector<uint64_t> & S, 
+		    const std::vector<uint64_t> & X, bool check = true);
+  // true if X has counts in a bucket where S has none: the standard
+  // says it can't happen, so the fit is rejected outright.
+  bool impossible(const std::vector<uint64_t> & S, const std::vector<uint64_t> & X);
+  double test(const std::vector<uint64_t> & S, const std::vector<uint64_t> & X);  
+  // 1 - P(X^2/2, k/2)
+  double significance(double X2, int k);
+
   double pearsonCTS(const std::vector<int> & S, 
 		  const std::vector<int> & X);
   double test(const std::vector<int> & S, const std::vector<int> X);  
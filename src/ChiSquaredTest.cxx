@@ -1,23 +1,30 @@
 #include "ChiSquared.hxx"
+#include "CountHistogram.hxx"
+#include "Resample.hxx"
 
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
 #include <vector>
 #include <iostream>
-#include <fstream>
 #include <map>
 
 int main(int argc, char * argv[])
 {
   std::string S_fname, X_fname; 
+  int resamples; 
+  int num_threads; 
+  uint64_t seed; 
 
   namespace po = boost::program_options;
 
   po::options_description desc("Options:");
   desc.add_options()
     ("help", "help message")
-    ("standard", po::value<std::string>(&S_fname)->required(), "Histogram file for null hypothesis")
-    ("experiment", po::value<std::string>(&X_fname)->required(), "Histogram file for experimental result");
+    ("standard", po::value<std::string>(&S_fname)->required(), "Histogram for null hypothesis (text or binary histogram file, or partial_file:table[:row])")
+    ("experiment", po::value<std::string>(&X_fname)->required(), "Histogram for experimental result (same forms as standard)")
+    ("resamples", po::value<int>(&resamples)->default_value(0), "Also find the significance by parametric bootstrap: this many redraws from the pooled histograms (no asymptotic approximation)")
+    ("seed", po::value<uint64_t>(&seed)->default_value(1), "Random seed for resampling")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of resampling threads");
   
   po::positional_options_description pos_opts ;
   pos_opts.add("standard", 1);
@@ -52,21 +59,21 @@ int main(int argc, char * argv[])
     exit(-1);        
   }
 
-  std::ifstream Sst(S_fname); 
-  std::ifstream Xst(X_fname); 
+  CountHistogram Sh, Xh; 
+  if(!Sh.read(S_fname) || !Xh.read(X_fname) || !Sh.conform(Xh, S_fname, X_fname)) exit(-1);
   
-  std::vector<int> S; 
-  std::vector<int> X; 
-  
-  for(int n; Sst >> n; ) {
-    S.push_back(n); 
-  }
-  for(int n; Xst >> n; ) {
-    X.push_back(n); 
-  }
+  std::vector<uint64_t> & S = Sh.counts; 
+  std::vector<uint64_t> & X = Xh.counts; 
 
   // now calculate the chi-sqared score
   
   std::cout << boost::format("X^2 = %g, significance = %g\n")
     % ChiSquared::pearsonCTS(S, X) % ChiSquared::test(S, X); 
+
+  if(resamples > 0) {
+    Resample::Result res = Resample::nullBootstrap(S, X, Resample::chiSquared, 
+						   resamples, seed, num_threads); 
+    std::cout << boost::format("two sample X^2 = %g, null bootstrap significance = %g (%d resamples)\n")
+      % res.observed % res.p_value % resamples; 
+  }
 }
@@ -0,0 +1,173 @@
+#include "CountHistogram.hxx"
+#include "WSPRLogPartial.hxx"
+#include "BinaryIO.hxx"
+#include <boost/format.hpp>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <cerrno>
+#include <cctype>
+
+const uint32_t CountHistogram::VERSION;
+
+static const char hist_magic[8] = { 'W', 'S', 'P', 'R', 'H', 'I', 'S', 'T' };
+static const char part_magic[8] = { 'W', 'S', 'P', 'R', 'P', 'A', 'R', 'T' };
+
+using namespace BinaryIO;
+
+uint64_t CountHistogram::total() const
+{
+  uint64_t ret = 0;
+  for(auto c: counts) ret += c;
+  return ret;
+}
+
+bool CountHistogram::write(const std::string & fname) const
+{
+  std::ofstream os(fname, std::ios::binary);
+  if(!os.is_open()) {
+    std::cerr << boost::format("Could not open histogram file [%s] for writing.\n") % fname;
+    return false;
+  }
+  os.write(hist_magic, sizeof(hist_magic));
+  put<uint32_t>(os, VERSION);
+  putString(os, label);
+  put<double>(os, lo);
+  put<double>(os, width);
+  put<uint64_t>(os, counts.size());
+  os.write((const char *) counts.data(), counts.size() * sizeof(uint64_t));
+  os.close();
+  if(os.fail()) {
+    std::cerr << boost::format("Could not write histogram file [%s].\n") % fname;
+    return false;
+  }
+  return true;
+}
+
+bool CountHistogram::read(const std::string & spec)
+{
+  counts.clear();
+  lo = 0.0;
+  width = 1.0;
+  label = "";
+
+  std::ifstream is(spec, std::ios::binary);
+  if(!is.is_open()) {
+    // maybe it's file:table[:row]
+    size_t colon = spec.find(':');
+    if(colon == std::string::npos) {
+      std::cerr << boost::format("Could not open histogram file [%s].\n") % spec;
+      return false;
+    }
+    std::string fname = spec.substr(0, colon);
+    std::string table = spec.substr(colon + 1);
+    size_t row = 0;
+    size_t colon2 = table.find(':');
+    if(colon2 != std::string::npos) {
+      row = atoi(table.c_str() + colon2 + 1);
+      table = table.substr(0, colon2);
+    }
+    WSPRLogPartial part;
+    if(!part.read(fname)) return false;
+    return fromPartial(part, table, row);
+  }
+
+  char magic[sizeof(hist_magic)];
+  is.read(magic, sizeof(magic));
+  bool got_magic = is.good();
+  if(got_magic && std::equal(magic, magic + sizeof(magic), part_magic)) {
+    std::cerr << boost::format("[%s] is a partial file: say which table, as %s:table\n") % spec % spec;
+    return false;
+  }
+  if(got_magic && std::equal(magic, magic + sizeof(magic), hist_magic)) {
+    uint32_t version;
+    uint64_t bins;
+    if(!get(is, version) || (version != VERSION)) {
+      std::cerr << boost::format("[%s] is histogram file version %d, but we only read version %d.\n")
+	% spec % version % VERSION;
+      return false;
+    }
+    if(!getString(is, label) || !get(is, lo) || !get(is, width) || !get(is, bins) ||
+       (bins > (((uint64_t) 1) << 32))) {
+      std::cerr << boost::format("Histogram file [%s] is truncated or damaged.\n") % spec;
+      return false;
+    }
+    counts.resize(bins);
+    is.read((char *) counts.data(), bins * sizeof(uint64_t));
+    if(is.fail()) {
+      std::cerr << boost::format("Histogram file [%s] is truncated or damaged.\n") % spec;
+      counts.clear();
+      return false;
+    }
+    return true;
+  }
+
+  // text: whitespace separated counts.  >> into an unsigned would
+  // take "-5" as a huge count, so each word has to be all digits.
+  is.clear();
+  is.seekg(0);
+  std::string word;
+  while(is >> word) {
+    char * end;
+    errno = 0;
+    unsigned long long n = strtoull(word.c_str(), &end, 10);
+    if(!isdigit((unsigned char) word[0]) || (*end != '\0') || (errno == ERANGE)) {
+      std::cerr << boost::format("Histogram file [%s] has [%s] where count %d should be.\n")
+	% spec % word % counts.size();
+      counts.clear();
+      return false;
+    }
+    counts.push_back((uint64_t) n);
+  }
+  if(!is.eof()) {
+    std::cerr << boost::format("Could not read histogram file [%s].\n") % spec;
+    counts.clear();
+    return false;
+  }
+  return true;
+}
+
+bool CountHistogram::conform(CountHistogram & other, const std::string & name, const std::string & other_name)
+{
+  // the axes come from the same doubles, but allow for a round trip
+  // through text
+  double tol = 1e-9 * std::max(fabs(width), fabs(other.width));
+  if((fabs(lo - other.lo) > tol) || (fabs(width - other.width) > tol)) {
+    std::cerr << boost::format("Histograms [%s] (lo %g width %g) and [%s] (lo %g width %g) are not on the same bins.\n")
+      % name % lo % width % other_name % other.lo % other.width;
+    return false;
+  }
+  size_t bins = std::max(counts.size(), other.counts.size());
+  counts.resize(bins, 0);
+  other.counts.resize(bins, 0);
+  return true;
+}
+
+bool CountHistogram::fromPartial(const WSPRLogPartial & part, const std::string & table, size_t row)
+{
+  const std::vector<uint64_t> & tc = part.dense(table);
+  const std::vector<uint32_t> & dims = part.dims(table);
+  if(tc.empty() || dims.empty()) {
+    std::cerr << boost::format("The [%s] partial has no dense table [%s].\n") % part.getKind() % table;
+    return false;
+  }
+  size_t bins = dims.back();
+  size_t rows = tc.size() / bins;
+  if(row >= rows) {
+    std::cerr << boost::format("Table [%s] has %d rows, so there is no row %d.\n") % table % rows % row;
+    return false;
+  }
+  counts.assign(tc.begin() + row * bins, tc.begin() + (row + 1) * bins);
+
+  lo = 0.0;
+  width = 1.0;
+  label = part.getKind() + ":" + table + ":" + std::to_string(row);
+  // these are counts by time of day
+  if((part.getKind() == "TimeHisto") || (part.getKind() == "SolTimeOR")) {
+    width = 24.0 / ((double) bins);
+    label += " (hours)";
+  }
+  return true;
+}
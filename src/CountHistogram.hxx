@@ -0,0 +1,65 @@
+#ifndef COUNTHISTOGRAM_HDR
+#define COUNTHISTOGRAM_HDR
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class WSPRLogPartial;
+
+/// A one dimensional histogram -- 64 bit counts and the axis they are
+/// counted on.  This is what the statistics tools (ChiSquaredTest,
+/// KSTest, RiskRatio, HistoStats, WSPRLogStatScan) compare, and what
+/// the producers hand them, either in a file or, within one program,
+/// directly.
+///
+/// Bin i covers [lo + i * width, lo + (i + 1) * width).
+///
+/// The binary file, in the byte order of the machine that wrote it:
+///   "WSPRHIST"  8 byte magic
+///   version     uint32
+///   label       string (uint32 length, then the characters)
+///   lo, width   double
+///   bins        uint64, then uint64 counts
+class CountHistogram {
+public:
+  static const uint32_t VERSION = 1;
+
+  CountHistogram(size_t bins = 0, double _lo = 0.0, double _width = 1.0,
+		 const std::string & _label = "") : counts(bins, 0) {
+    lo = _lo;
+    width = _width;
+    label = _label;
+  }
+
+  size_t size() const { return counts.size(); }
+  uint64_t & operator[](size_t i) { return counts[i]; }
+  uint64_t operator[](size_t i) const { return counts[i]; }
+  uint64_t total() const;
+  double binLow(size_t i) const { return lo + ((double) i) * width; }
+
+  bool write(const std::string & fname) const;
+
+  /// Read a histogram from
+  ///   a binary histogram file,
+  ///   "file:table" or "file:table:row" -- one row of a dense table in
+  ///     a WSPRLogPartial file (row 0 if not given), or
+  ///   a text file of counts (whitespace separated), as the tools
+  ///     have always read.
+  /// Complains on std::cerr and returns false if it can't.
+  bool read(const std::string & spec);
+
+  /// row of a dense partial table (the last dimension is the bins).
+  /// The axis is hours if the partial's counts are by time of day.
+  bool fromPartial(const WSPRLogPartial & part, const std::string & table, size_t row = 0);
+
+  /// Put this and other on the same bins so they can be compared bin
+  /// by bin: the shorter one gets empty bins on the end.  If the two
+  /// don't share an axis (lo and width) complain on std::cerr, naming
+  /// them name and other_name, and return false.  Never drops a bin.
+  bool conform(CountHistogram & other, const std::string & name, const std::string & other_name);
+
+  std::vector<uint64_t> counts;
+  double lo, width;
+  std::string label;
+};
+#endif
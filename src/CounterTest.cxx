@@ -0,0 +1,179 @@
+#include "FlatCounter.hxx"
+#include "SpaceSaving.hxx"
+#include <boost/format.hpp>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <random>
+#include <cstdlib>
+
+// Checks FlatCounter (insert, erase, lookup) against std::map, and
+// the Space-Saving bounds after a merge against exact counts.
+// Prints what went wrong and exits non-zero on the first failure.
+
+static int failures = 0;
+
+static void fail(const std::string & msg)
+{
+  std::cout << "FAIL: " << msg << std::endl;
+  failures++;
+}
+
+// compare every key the map knows about, plus a few it doesn't
+static bool sameAs(const FlatCounter<int64_t, uint64_t> & fc, const std::map<int64_t, uint64_t> & ref,
+		   int64_t key_range)
+{
+  if(fc.size() != ref.size()) {
+    fail((boost::format("FlatCounter has %d keys, std::map has %d") % fc.size() % ref.size()).str());
+    return false;
+  }
+  for(int64_t k = -key_range; k < key_range; k++) {
+    auto it = ref.find(k);
+    bool in_ref = (it != ref.end());
+    if(fc.contains(k) != in_ref) {
+      fail((boost::format("FlatCounter contains(%d) is %d") % k % fc.contains(k)).str());
+      return false;
+    }
+    if(fc.get(k) != (in_ref ? it->second : 0)) {
+      fail((boost::format("FlatCounter get(%d) is %d, expected %d")
+	    % k % fc.get(k) % (in_ref ? it->second : 0)).str());
+      return false;
+    }
+  }
+  std::vector<std::pair<int64_t, uint64_t> > srt;
+  fc.sorted(srt);
+  std::vector<std::pair<int64_t, uint64_t> > rsrt(ref.begin(), ref.end());
+  if(srt != rsrt) {
+    fail("FlatCounter sorted() doesn't match std::map");
+    return false;
+  }
+  return true;
+}
+
+static void testFlatCounter()
+{
+  std::mt19937 rng(12345);
+  int ops = 0;
+  // small key ranges make long collision runs, and the erases then
+  // have to shift keys back across the end of the table too
+  for(int64_t key_range: { 8, 50, 1000 }) {
+    FlatCounter<int64_t, uint64_t> fc(4);
+    std::map<int64_t, uint64_t> ref;
+    std::uniform_int_distribution<int64_t> kd(-key_range, key_range - 1);
+    std::uniform_int_distribution<int> od(0, 9);
+    for(int i = 0; i < 20000; i++, ops++) {
+      int64_t k = kd(rng);
+      int op = od(rng);
+      if(op < 5) {
+	fc.add(k, 1 + (k & 3));
+	ref[k] += 1 + (k & 3);
+      }
+      else if(op < 9) {
+	fc.erase(k);
+	ref.erase(k);
+      }
+      else if((i % 1000) == 0) {
+	fc.clear();
+	ref.clear();
+      }
+      // a full check is O(key_range), so not after every op
+      if(((i % 97) == 0) && !sameAs(fc, ref, key_range)) return;
+    }
+    // empty it, a key at a time
+    while(!ref.empty()) {
+      fc.erase(ref.begin()->first);
+      ref.erase(ref.begin());
+      if(!sameAs(fc, ref, key_range)) return;
+    }
+  }
+  std::cout << boost::format("FlatCounter: %d operations match std::map\n") % ops;
+}
+
+// zipf-ish stream of keys
+static void makeStream(std::mt19937 & rng, int n, int keys, std::vector<uint64_t> & res)
+{
+  std::vector<double> w;
+  for(int i = 1; i <= keys; i++) w.push_back(1.0 / ((double) i));
+  std::discrete_distribution<int> d(w.begin(), w.end());
+  for(int i = 0; i < n; i++) res.push_back(d(rng));
+}
+
+static void testSpaceSavingMerge()
+{
+  std::mt19937 rng(54321);
+  const size_t capacity = 50;
+  std::vector<uint64_t> a, b;
+  makeStream(rng, 100000, 2000, a);
+  makeStream(rng, 60000, 2000, b);
+  // b is shuffled against a so the two summaries keep different keys
+  for(auto & k: b) k = (k * 7919) % 2000;
+
+  SpaceSaving sa(capacity), sb(capacity), empty(capacity);
+  std::map<uint64_t, uint64_t> truth;
+  for(auto k: a) {
+    sa.add(k, std::to_string(k));
+    truth[k]++;
+  }
+  for(auto k: b) {
+    sb.add(k, std::to_string(k));
+    truth[k]++;
+  }
+
+  // merging in an empty summary changes nothing
+  std::vector<SpaceSaving::Entry> before, after;
+  sa.entries(before);
+  SpaceSaving sc = sa;
+  sc.merge(empty);
+  sc.entries(after);
+  if((after.size() != before.size()) || (sc.total() != sa.total())) {
+    fail("merging an empty SpaceSaving changed it");
+    return;
+  }
+  for(size_t i = 0; i < before.size(); i++) {
+    if((after[i].key != before[i].key) || (after[i].count != before[i].count) ||
+       (after[i].err != before[i].err)) {
+      fail("merging an empty SpaceSaving changed it");
+      return;
+    }
+  }
+
+  sa.merge(sb);
+  if(sa.total() != (a.size() + b.size())) {
+    fail((boost::format("merged total is %d, expected %d") % sa.total() % (a.size() + b.size())).str());
+    return;
+  }
+  if(sa.size() > capacity) {
+    fail("merged summary is over capacity");
+    return;
+  }
+  std::vector<SpaceSaving::Entry> ents;
+  sa.entries(ents);
+  for(auto & e: ents) {
+    uint64_t t = truth[e.key];
+    if((e.count < t) || ((e.count - e.err) > t)) {
+      fail((boost::format("key %d: count %d err %d, but it appeared %d times")
+	    % e.key % e.count % e.err % t).str());
+      return;
+    }
+    if(e.err > (sa.total() / capacity)) {
+      fail((boost::format("key %d: err %d is over total/capacity") % e.key % e.err).str());
+      return;
+    }
+  }
+  // the guarantee: anything over total/capacity has a counter
+  for(auto & kc: truth) {
+    if((kc.second > (sa.total() / capacity)) && !sa.contains(kc.first)) {
+      fail((boost::format("key %d appeared %d times but has no counter") % kc.first % kc.second).str());
+      return;
+    }
+  }
+  std::cout << boost::format("SpaceSaving: merged bounds hold for %d counters\n") % ents.size();
+}
+
+int main()
+{
+  testFlatCounter();
+  testSpaceSavingMerge();
+  if(failures) exit(-1);
+  std::cout << "OK\n";
+}
@@ -0,0 +1,238 @@
+#ifndef DENSEHISTOGRAM_HDR
+#define DENSEHISTOGRAM_HDR
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <cstdlib>
+#include <new>
+
+// A fixed size histogram with any number of axes, all decided
+// at compile time.  The counts live in one flat (row major) array,
+// last axis fastest, that starts on a cache line.  For example,
+// counts by solar hour (2 minute bins, wrapping at 24 hours) and
+// azimuth (5 degree bins):
+//
+//   typedef HistoAxis<720, 0, 1, 30, HISTO_WRAP> HourAxis;
+//   typedef HistoAxis<72, 0, 5, 1, HISTO_WRAP> AzAxis;
+//   DenseHistogram<HourAxis, AzAxis> h;
+//   h.add(hour, az);
+//   ... h.at(hr_bin, az_bin) ...
+
+// what to do with a value that falls off either end of an axis
+enum HistoEdge {
+  HISTO_CLAMP,  // count it in the first (or last) bin
+  HISTO_WRAP,   // the axis is a circle (hours, azimuth)
+  HISTO_DROP    // don't count the entry at all
+};
+
+// find the bin index as an int without calling floor() --
+// this vectorizes.
+template<typename V> inline int histoFloor(V x)
+{
+  int t = (int) x;
+  return (x < ((V) t)) ? (t - 1) : t;
+}
+
+// An axis of BINS bins, starting at LO, each WNUM/WDEN wide.  (The
+// width is a ratio because a template can't take a double.)
+template<int BINS_, int LO, int WNUM, int WDEN = 1, int EDGE = HISTO_CLAMP>
+class HistoAxis {
+public:
+  static const int BINS = BINS_;
+
+  static double low() { return (double) LO; }
+  static double width() { return ((double) WNUM) / ((double) WDEN); }
+  static double binLow(int b) { return low() + ((double) b) * width(); }
+
+  // Bin for a value, or -1 if the value is to be dropped.  The arithmetic
+  // is done in the type of the value (float, or double for integers)
+  // so binning matches "floor(v * scale)" done by hand in that type.
+  template<typename V> static int index(V v) {
+    typedef typename std::conditional<std::is_integral<V>::value, double, V>::type F;
+    F x = (((F) v) - ((F) LO));
+    if(WDEN != 1) x = x * ((F) WDEN);
+    if(WNUM != 1) x = x / ((F) WNUM);
+    int b = histoFloor(x);
+    switch (EDGE) {
+    case HISTO_CLAMP:
+      b = (b < 0) ? 0 : b;
+      b = (b >= BINS) ? (BINS - 1) : b;
+      break;
+    case HISTO_WRAP:
+      b = b % BINS;
+      b = (b < 0) ? (b + BINS) : b;
+      break;
+    default:
+      b = ((b < 0) || (b >= BINS)) ? -1 : b;
+      break;
+    }
+    return b;
+  }
+};
+
+// walks the axis list to build the flat index
+template<typename... Axes> class HistoIndexer;
+
+template<> class HistoIndexer<> {
+public:
+  static const size_t SIZE = 1;
+  static long index(long acc) { return acc; }
+  static long bin(long acc) { return acc; }
+  static void batch(long *, size_t) { }
+};
+
+template<typename A, typename... Rest> class HistoIndexer<A, Rest...> {
+public:
+  static const size_t SIZE = A::BINS * HistoIndexer<Rest...>::SIZE;
+
+  // from values
+  template<typename V, typename... VR>
+  static long index(long acc, V v, VR... rest) {
+    int b = A::index(v);
+    if(b < 0) return -1;
+    return HistoIndexer<Rest...>::index(acc * A::BINS + b, rest...);
+  }
+
+  // from bin numbers
+  template<typename... BR>
+  static long bin(long acc, int b, BR... rest) {
+    return HistoIndexer<Rest...>::bin(acc * A::BINS + b, rest...);
+  }
+
+  // one axis at a time over a whole block of values
+  template<typename V, typename... VR>
+  static void batch(long * idx, size_t n, const V * v, const VR *... rest) {
+    for(size_t i = 0; i < n; i++) {
+      long b = A::index(v[i]);
+      long k = idx[i] * A::BINS + b;
+      idx[i] = ((idx[i] < 0) || (b < 0)) ? -1 : k;
+    }
+    HistoIndexer<Rest...>::batch(idx, n, rest...);
+  }
+};
+
+// std::allocator, but every block starts on an Align byte boundary.
+// (new only promises alignof(max_align_t) before C++17, so an
+// alignas member of a heap allocated object isn't enough.)
+template<typename T, size_t Align> class AlignedAllocator {
+public:
+  typedef T value_type;
+  template<typename U> struct rebind { typedef AlignedAllocator<U, Align> other; };
+
+  AlignedAllocator() { }
+  template<typename U> AlignedAllocator(const AlignedAllocator<U, Align> &) { }
+
+  T * allocate(size_t n) {
+    void * p = nullptr;
+    if(posix_memalign(&p, Align, n * sizeof(T)) != 0) throw std::bad_alloc();
+    return static_cast<T *>(p);
+  }
+  void deallocate(T * p, size_t) { free(p); }
+};
+
+template<typename T, typename U, size_t Align>
+bool operator==(const AlignedAllocator<T, Align> &, const AlignedAllocator<U, Align> &) { return true; }
+template<typename T, typename U, size_t Align>
+bool operator!=(const AlignedAllocator<T, Align> &, const AlignedAllocator<U, Align> &) { return false; }
+
+template<typename... Axes> class DenseHistogram {
+public:
+  typedef uint32_t Count;
+  static const size_t SIZE = HistoIndexer<Axes...>::SIZE;
+  static const int DIMS = sizeof...(Axes);
+
+  DenseHistogram() : counts(SIZE) { clear(); }
+
+  void clear() {
+    for(size_t i = 0; i < SIZE; i++) counts[i] = 0;
+    total_count = 0;
+  }
+
+  // one value per axis.  Returns false if an axis dropped it.
+  template<typename... V> bool add(V... vals) {
+    static_assert(sizeof...(V) == sizeof...(Axes), "need one value per axis");
+    long idx = HistoIndexer<Axes...>::index(0, vals...);
+    if(idx < 0) return false;
+    counts[idx]++;
+    total_count++;
+    return true;
+  }
+
+  // n entries, one array of values per axis.  The bins are found
+  // an axis at a time (those loops vectorize), then counted.
+  template<typename... V> void addBatch(size_t n, const V *... vals) {
+    static_assert(sizeof...(V) == sizeof...(Axes), "need one array per axis");
+    idx_buf.assign(n, 0);
+    HistoIndexer<Axes...>::batch(idx_buf.data(), n, vals...);
+    for(size_t i = 0; i < n; i++) {
+      long k = idx_buf[i];
+      if(k >= 0) {
+	counts[k]++;
+	total_count++;
+      }
+    }
+  }
+
+  // add in the counts from another histogram of the same shape
+  void merge(const DenseHistogram & other) {
+    for(size_t i = 0; i < SIZE; i++) counts[i] += other.counts[i];
+    total_count += other.total_count;
+  }
+
+  // count in a bin, by bin number on each axis
+  template<typename... B> Count & at(B... bins) {
+    return counts[HistoIndexer<Axes...>::bin(0, bins...)];
+  }
+  template<typename... B> Count at(B... bins) const {
+    return counts[HistoIndexer<Axes...>::bin(0, bins...)];
+  }
+
+  // the flat array
+  Count operator[](size_t i) const { return counts[i]; }
+  const Count * data() const { return counts.data(); }
+
+  // entries counted (not including those dropped)
+  uint64_t total() const { return total_count; }
+
+  Count maxCount() const {
+    Count ret = 0;
+    for(size_t i = 0; i < SIZE; i++) ret = (counts[i] > ret) ? counts[i] : ret;
+    return ret;
+  }
+
+  // each bin as a fraction of the total, in flat order
+  void normalized(std::vector<double> & res) const {
+    res.resize(SIZE);
+    double scale = (total_count == 0) ? 0.0 : (1.0 / ((double) total_count));
+    for(size_t i = 0; i < SIZE; i++) res[i] = scale * ((double) counts[i]);
+  }
+
+  // cumulative fraction along the last axis -- for a 1D histogram
+  // this is the CDF, for more axes it is a CDF for each row.
+  void cdf(std::vector<double> & res) const {
+    const size_t row = lastBins();
+    res.resize(SIZE);
+    for(size_t r = 0; r < SIZE; r += row) {
+      uint64_t rtot = 0;
+      for(size_t i = 0; i < row; i++) rtot += counts[r + i];
+      double scale = (rtot == 0) ? 0.0 : (1.0 / ((double) rtot));
+      uint64_t acc = 0;
+      for(size_t i = 0; i < row; i++) {
+	acc += counts[r + i];
+	res[r + i] = scale * ((double) acc);
+      }
+    }
+  }
+
+private:
+  template<typename A> static size_t lastOf() { return A::BINS; }
+  template<typename A, typename A2, typename... R> static size_t lastOf() { return lastOf<A2, R...>(); }
+  static size_t lastBins() { return lastOf<Axes...>(); }
+
+  // 64 bytes is a cache line on anything we're likely to run on
+  std::vector<Count, AlignedAllocator<Count, 64> > counts;
+  uint64_t total_count;
+  std::vector<long> idx_buf;
+};
+#endif
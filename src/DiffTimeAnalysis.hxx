@@ -0,0 +1,118 @@
+#ifndef DIFFTIME_ANALYSIS_HDR
+#define DIFFTIME_ANALYSIS_HDR
+#include "WSPRLogAnalysis.hxx"
+#include "SolarTime.hxx"
+#include "DenseHistogram.hxx"
+#include <boost/format.hpp>
+#include <string>
+#include <iostream>
+#include <fstream>
+
+// WSPRLogDiffTime: reports by solar hour and frequency offset
+// (FREQ_DIFF), at the rx and at the tx.
+class DiffTimeAnalysis : public WSPRLogAnalysis {
+public:
+  typedef HistoAxis<24, 0, 1, 1, HISTO_WRAP> HourAxis; 
+  typedef HistoAxis<200, -100, 1, 1, HISTO_DROP> FreqDiffAxis; 
+  typedef DenseHistogram<HourAxis, FreqDiffAxis> FDHisto; 
+
+  DiffTimeAnalysis() {
+    skipped[0] = skipped[1] = 0; 
+  }
+
+  static WSPRLogAnalysis * make(const WSPRLogAnalysisArgs &) { return new DiffTimeAnalysis(); }
+
+  // reads the entry members directly
+  bool lazyDecodeOK() const { return false; }
+
+  WSPRLogAccumulator * clone() const { return new DiffTimeAnalysis(); }
+
+  void merge(const WSPRLogAccumulator & other) {
+    const DiffTimeAnalysis & o = static_cast<const DiffTimeAnalysis &>(other); 
+    rxhisto.merge(o.rxhisto); 
+    txhisto.merge(o.txhisto); 
+    skipped[0] += o.skipped[0]; 
+    skipped[1] += o.skipped[1]; 
+  }
+
+  enum SEL { RX, TX };
+
+  void add(WSPRLogEntry * ent) {
+    std::string from, to; 
+    unsigned long et; 
+    double freq_diff;
+
+    to = ent->rxgrid;
+    from = ent->txgrid; 
+    et = ent->dtime; 
+    freq_diff = ent->freq_diff; 
+
+    // calculate the "local time" for to, from, and midpath
+    float tx_hour, rx_hour; 
+    int ifreq_diff = (int) freq_diff; 
+
+    if(sol_cache.getFHour(et, to, rx_hour)) makeEntry(RX, rx_hour, ifreq_diff); 
+    else skipped[0]++; 
+    if(sol_cache.getFHour(et, from, tx_hour)) makeEntry(TX, tx_hour, ifreq_diff);
+    else skipped[1]++; 
+  }
+
+
+  void makeEntry(SEL sel, double hr, int offset) {
+    switch (sel) {
+    case RX:
+      rxhisto.add(hr, offset);
+      break;
+    case TX:
+      txhisto.add(hr, offset);
+      break;
+    }
+  }
+
+  void dumpTables(const std::string & out_base_name) {
+    std::ofstream osrx(out_base_name + "_FD_T_rx.dat");
+    std::ofstream ostx(out_base_name + "_FD_T_tx.dat");
+
+    dumpTable(rxhisto, osrx);
+    dumpTable(txhisto, ostx);
+
+    osrx.close();
+    ostx.close();
+  }
+
+  void dumpTable(const FDHisto & histo, std::ostream & os) {
+    // first find total 
+    long total = histo.total();
+    long smax = histo.maxCount(); 
+    if(smax < 1) smax = 1; 
+
+    double ftotal = ((double) total) + 1.0e-6; 
+    double fsmax = ((double) smax); 
+    for(int i = 0; i < HourAxis::BINS; i++) {
+      for(int j = 0; j < FreqDiffAxis::BINS; j++) {
+	int val = histo.at(i, j); 
+	double fval = ((double) val) / ftotal; 
+	double rmag = ((double) val) / fsmax;
+	os << boost::format("%d %d %f %f\n") % i % (j - 100) % fval % rmag; 
+      }
+      os << std::endl; 
+    }
+  }
+
+  // <out>_FD_T_rx.dat and <out>_FD_T_tx.dat
+  void report(const std::string & out) {
+    dumpTables(out); 
+    if(skipped[0] || skipped[1]) {
+      std::cerr << boost::format("Skipped %d rx and %d tx grids that were malformed\n")
+	% skipped[0] % skipped[1]; 
+    }
+  }
+
+private:
+  SolarTimeCache sol_cache; 
+  FDHisto rxhisto, txhisto;
+  // rx and tx grids that didn't decode
+  uint64_t skipped[2]; 
+};
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef FLATCOUNTER_HDR
+#define FLATCOUNTER_HDR
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <cstdint>
+#include <type_traits>
+
+// Counters for sparse integer keys (values, interned call ids,
+// packed pairs of ids) in one flat open-addressing table.  No
+// nodes to allocate and no pointers to chase, unlike std::map.
+// Iteration order is the table order -- use sorted() when the
+// output has to be in key order.
+template<typename K, typename V = unsigned int> class FlatCounter {
+public:
+  static_assert(std::is_integral<K>::value, "FlatCounter keys are integers");
+
+  FlatCounter(size_t initial_size = 64) {
+    size_t cap = 16;
+    while(cap < 2 * initial_size) cap <<= 1;
+    init(cap);
+  }
+
+  // the count for a key, created (as 0) if need be.
+  V & operator[](K key) {
+    size_t slot = findSlot(key);
+    if(!used[slot]) {
+      if(2 * (num_keys + 1) > keys.size()) {
+	grow();
+	slot = findSlot(key);
+      }
+      used[slot] = 1;
+      keys[slot] = key;
+      vals[slot] = 0;
+      num_keys++;
+    }
+    return vals[slot];
+  }
+
+  void add(K key, V count = 1) { (*this)[key] += count; }
+
+  // add in the counts from another counter
+  void merge(const FlatCounter & other) {
+    other.forEach([this](K k, V v) { add(k, v); });
+  }
+
+  bool contains(K key) const { return used[findSlot(key)] != 0; }
+
+  void erase(K key) {
+    size_t slot = findSlot(key);
+    if(!used[slot]) return;
+    used[slot] = 0;
+    num_keys--;
+    // close the gap: pull back any later key in the run that
+    // can't be found past the hole any more
+    size_t mask = keys.size() - 1;
+    size_t hole = slot;
+    for(size_t j = (slot + 1) & mask; used[j]; j = (j + 1) & mask) {
+      size_t home = homeSlot(keys[j]);
+      bool stays = (hole <= j) ? ((hole < home) && (home <= j)) : ((hole < home) || (home <= j));
+      if(stays) continue;
+      keys[hole] = keys[j];
+      vals[hole] = vals[j];
+      used[hole] = 1;
+      used[j] = 0;
+      hole = j;
+    }
+  }
+
+  // 0 if the key isn't there
+  V get(K key) const {
+    size_t slot = findSlot(key);
+    return used[slot] ? vals[slot] : 0;
+  }
+
+  size_t size() const { return num_keys; }
+  bool empty() const { return num_keys == 0; }
+
+  void clear() {
+    std::fill(used.begin(), used.end(), 0);
+    num_keys = 0;
+  }
+
+  // f(key, count) for every key, in no particular order
+  template<typename F> void forEach(F f) const {
+    for(size_t i = 0; i < keys.size(); i++) {
+      if(used[i]) f(keys[i], vals[i]);
+    }
+  }
+
+  // (key, count) pairs in key order
+  void sorted(std::vector<std::pair<K, V> > & res) const {
+    res.clear();
+    res.reserve(num_keys);
+    forEach([&res](K k, V v) { res.push_back(std::make_pair(k, v)); });
+    std::sort(res.begin(), res.end());
+  }
+
+  // two 32 bit ids (say tx and rx call) in one key
+  static uint64_t packPair(uint32_t a, uint32_t b) {
+    return (((uint64_t) a) << 32) | b;
+  }
+  static uint32_t pairFirst(uint64_t k) { return (uint32_t) (k >> 32); }
+  static uint32_t pairSecond(uint64_t k) { return (uint32_t) k; }
+
+private:
+  void init(size_t cap) {
+    keys.assign(cap, 0);
+    vals.assign(cap, 0);
+    used.assign(cap, 0);
+    num_keys = 0;
+  }
+
+  // fibonacci hashing spreads out runs of small ints
+  size_t homeSlot(K key) const {
+    return (size_t) ((((uint64_t) key) * 0x9E3779B97F4A7C15ULL) >> 32) & (keys.size() - 1);
+  }
+
+  size_t findSlot(K key) const {
+    size_t mask = keys.size() - 1;
+    size_t slot = homeSlot(key);
+    while(used[slot] && (keys[slot] != key)) {
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  void grow() {
+    std::vector<K> okeys;
+    std::vector<V> ovals;
+    std::vector<uint8_t> oused;
+    okeys.swap(keys);
+    ovals.swap(vals);
+    oused.swap(used);
+    init(2 * okeys.size());
+    for(size_t i = 0; i < okeys.size(); i++) {
+      if(oused[i]) {
+	size_t slot = findSlot(okeys[i]);
+	used[slot] = 1;
+	keys[slot] = okeys[i];
+	vals[slot] = ovals[i];
+	num_keys++;
+      }
+    }
+  }
+
+  std::vector<K> keys;
+  std::vector<V> vals;
+  std::vector<uint8_t> used;
+  size_t num_keys;
+};
+
+// A 64 bit hash of a string that is the same in every build and on
+// every machine (std::hash isn't), for sketches that are saved and
+// merged later, or for keys that we don't want to keep the strings
+// for.  FNV-1a, then the murmur3 finalizer to spread the bits.
+inline uint64_t stableHashMix(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+inline uint64_t stableHash(const std::string & s)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for(auto c: s) {
+    h ^= (uint8_t) c;
+    h *= 0x100000001b3ULL;
+  }
+  return stableHashMix(h);
+}
+
+// an ordered pair (tx call, rx call) from the hashes of each
+inline uint64_t stableHash(uint64_t first, uint64_t second)
+{
+  return stableHashMix(first * 0x9E3779B97F4A7C15ULL + second);
+}
+
+// Hands out small integer ids for strings (call signs, mostly) so they
+// can be counted with a FlatCounter or used to index a vector.
+// Ids are given out in order of first appearance.
+class StringInterner {
+public:
+  StringInterner() : slots(64, 0) { }
+
+  int intern(const std::string & s) {
+    size_t h = hasher(s);
+    size_t slot = findSlot(s, h);
+    if(slots[slot] != 0) return slots[slot] - 1;
+
+    names.push_back(s);
+    hashes.push_back(h);
+    int id = names.size() - 1;
+    slots[slot] = id + 1;
+    if(2 * names.size() > slots.size()) grow();
+    return id;
+  }
+
+  // -1 if we've never seen it
+  int find(const std::string & s) const {
+    size_t slot = findSlot(s, hasher(s));
+    return slots[slot] - 1;
+  }
+
+  const std::string & name(int id) const { return names[id]; }
+  size_t size() const { return names.size(); }
+
+  // ids in order of their strings, which is the order a
+  // std::map<std::string, ...> would have used.
+  template<typename IdT> void sortByName(std::vector<IdT> & ids) const {
+    std::sort(ids.begin(), ids.end(),
+	      [this](IdT a, IdT b) { return names[a] < names[b]; });
+  }
+
+private:
+  size_t findSlot(const std::string & s, size_t h) const {
+    size_t mask = slots.size() - 1;
+    size_t slot = h & mask;
+    while(slots[slot] != 0) {
+      int id = slots[slot] - 1;
+      if((hashes[id] == h) && (names[id] == s)) break;
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  void grow() {
+    slots.assign(2 * slots.size(), 0);
+    size_t mask = slots.size() - 1;
+    for(size_t id = 0; id < names.size(); id++) {
+      size_t slot = hashes[id] & mask;
+      while(slots[slot] != 0) slot = (slot + 1) & mask;
+      slots[slot] = id + 1;
+    }
+  }
+
+  std::hash<std::string> hasher;
+  // id + 1, so 0 means empty
+  std::vector<int> slots;
+  std::vector<std::string> names;
+  std::vector<size_t> hashes;
+};
+#endif
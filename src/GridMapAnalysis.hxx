@@ -0,0 +1,215 @@
+#ifndef GRIDMAP_ANALYSIS_HDR
+#define GRIDMAP_ANALYSIS_HDR
+#include "WSPRLogAnalysis.hxx"
+#include "FlatCounter.hxx"
+#include "Maidenhead.hxx"
+#include <boost/format.hpp>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <math.h>
+
+// WSPRLogGridMap: a heat map of rx and tx reports by grid field (AA to RR),
+// square (AA00 to RR99), or subsquare (AA00aa to RR99xx), optionally
+// with a separate map for each band and/or UTC hour.
+//
+// Each locator is turned into a cell number by index arithmetic
+// (Maidenhead::gridIndex).  Fields and squares (32400 cells) are
+// counted in dense arrays; subsquares (18.7M cells, nearly all empty)
+// in a FlatCounter.
+class GridLayer {
+public:
+  GridLayer(int chars) {
+    cells = Maidenhead::gridCells(chars); 
+    dense = (chars <= 4); 
+    if(dense) {
+      counts[0].assign(cells * cells, 0); 
+      counts[1].assign(cells * cells, 0); 
+    }
+  }
+
+  // pos 0 is rx, 1 is tx
+  void add(int pos, int lon_idx, int lat_idx) {
+    uint32_t idx = lon_idx * cells + lat_idx; 
+    if(dense) counts[pos][idx]++; 
+    else sparse[pos].add(idx); 
+  }
+
+  uint32_t get(int pos, uint32_t idx) const {
+    return dense ? counts[pos][idx] : sparse[pos].get(idx); 
+  }
+
+  void merge(const GridLayer & other) {
+    for(int pos = 0; pos < 2; pos++) {
+      if(dense) {
+	for(size_t i = 0; i < counts[pos].size(); i++) counts[pos][i] += other.counts[pos][i]; 
+      }
+      else {
+	sparse[pos].merge(other.sparse[pos]); 
+      }
+    }
+  }
+
+  // cells with any reports, in order
+  void usedCells(std::vector<uint32_t> & res) const {
+    res.clear(); 
+    if(dense) {
+      for(size_t i = 0; i < counts[0].size(); i++) {
+	if(counts[0][i] || counts[1][i]) res.push_back(i); 
+      }
+      return; 
+    }
+    for(int pos = 0; pos < 2; pos++) {
+      sparse[pos].forEach([&res](uint32_t k, uint32_t) { res.push_back(k); }); 
+    }
+    std::sort(res.begin(), res.end()); 
+    res.erase(std::unique(res.begin(), res.end()), res.end()); 
+  }
+
+  int cells; 
+  bool dense; 
+  std::vector<uint32_t> counts[2]; 
+  FlatCounter<uint32_t> sparse[2]; 
+}; 
+
+class GridMapAnalysis : public WSPRLogAnalysis {
+public:
+  GridMapAnalysis(int _chars, bool _by_band, bool _by_hour) { 
+    chars = _chars; 
+    by_band = _by_band; 
+    by_hour = _by_hour; 
+    skipped[0] = skipped[1] = 0; 
+  }
+
+  // chars=2|4|6, by_band=1, by_hour=1
+  static WSPRLogAnalysis * make(const WSPRLogAnalysisArgs & args) {
+    int chars = atoi(WSPRLogAnalyses::getArg(args, "chars", "2").c_str()); 
+    if((chars != 2) && (chars != 4) && (chars != 6)) {
+      std::cerr << "GridMap chars must be 2, 4, or 6" << std::endl; 
+      return NULL; 
+    }
+    return new GridMapAnalysis(chars, 
+			       WSPRLogAnalyses::getArg(args, "by_band", "0") != "0",
+			       WSPRLogAnalyses::getArg(args, "by_hour", "0") != "0"); 
+  }
+
+  WSPRLogAccumulator * clone() const { return new GridMapAnalysis(chars, by_band, by_hour); }
+
+  void merge(const WSPRLogAccumulator & other) {
+    const GridMapAnalysis & o = static_cast<const GridMapAnalysis &>(other); 
+    for(size_t i = 0; i < o.layers.size(); i++) {
+      layer(o.layer_keys[i]).merge(o.layers[i]); 
+    }
+    skipped[0] += o.skipped[0]; 
+    skipped[1] += o.skipped[1]; 
+  }
+
+  void add(WSPRLogEntry * ent) {
+    std::string rxgrid, txgrid; 
+    ent->getField(WSPRLogEntry::RXGRID, rxgrid);
+    ent->getField(WSPRLogEntry::TXGRID, txgrid);     
+
+    int band = 0; 
+    int hour = -1; 
+    if(by_band) ent->getField(WSPRLogEntry::BAND, band); 
+    if(by_hour) {
+      unsigned long et; 
+      ent->getField(WSPRLogEntry::DTIME, et); 
+      hour = (et / 3600) % 24; 
+    }
+    GridLayer & lay = layer(band * 100 + (hour + 1)); 
+
+    int lon_idx, lat_idx; 
+    if(Maidenhead::gridIndex(rxgrid, chars, lon_idx, lat_idx)) lay.add(0, lon_idx, lat_idx); 
+    else skipped[0]++; 
+    if(Maidenhead::gridIndex(txgrid, chars, lon_idx, lat_idx)) lay.add(1, lon_idx, lat_idx); 
+    else skipped[1]++; 
+  }
+
+  void report(const std::string & ofname) {
+    std::ofstream os(ofname); 
+
+    // layers in band, hour order
+    std::vector<int> order(layers.size()); 
+    for(size_t i = 0; i < order.size(); i++) order[i] = i; 
+    std::sort(order.begin(), order.end(), 
+	      [this](int a, int b) { return layer_keys[a] < layer_keys[b]; }); 
+
+    bool first = true; 
+    for(auto li: order) {
+      if(by_band || by_hour) {
+	// two blank lines between layers, so gnuplot can pick one with "index"
+	if(!first) os << "\n\n"; 
+	int key = layer_keys[li]; 
+	int band = (int) floor(((double) key) / 100.0); 
+	int hour = (key - band * 100) - 1; 
+	os << "#"; 
+	if(by_band) os << " band " << band; 
+	if(by_hour) os << " hour " << hour; 
+	os << "\n"; 
+      }
+      first = false; 
+      if(chars == 2) reportFields(layers[li], os); 
+      else reportCells(layers[li], os); 
+    }
+    os.close(); 
+
+    if(skipped[0] || skipped[1]) {
+      std::cerr << boost::format("Skipped %d rx and %d tx grids that were malformed or shorter than %d characters\n")
+	% skipped[0] % skipped[1] % chars; 
+    }
+  }
+
+private:
+  GridLayer & layer(int key) {
+    uint32_t & pos1 = layer_index[key]; 
+    if(pos1 == 0) {
+      layers.push_back(GridLayer(chars)); 
+      layer_keys.push_back(key); 
+      pos1 = layers.size(); 
+    }
+    return layers[pos1 - 1]; 
+  }
+
+  // the whole 18 x 18 table, as it has always been printed
+  void reportFields(const GridLayer & lay, std::ostream & os) {
+    for(char f = 'A'; f <= 'R'; f++) {
+      for(char s = 'A'; s <= 'R'; s++) {      
+	int fi = f - 'A'; 
+	int si = s - 'A'; 
+	uint32_t idx = fi * lay.cells + si; 
+	os << boost::format("%c %c %d %d %d %d\n")
+	  % f % s % fi % si % lay.get(0, idx) % lay.get(1, idx); 
+      }
+      os << std::endl; 
+    }
+  }
+
+  // squares and subsquares: only the cells with reports.
+  // locator, lon cell, lat cell, rx count, tx count
+  void reportCells(const GridLayer & lay, std::ostream & os) {
+    std::vector<uint32_t> used; 
+    lay.usedCells(used); 
+    for(auto idx: used) {
+      int lon_idx = idx / lay.cells; 
+      int lat_idx = idx % lay.cells; 
+      os << boost::format("%s %d %d %d %d\n")
+	% Maidenhead::gridName(chars, lon_idx, lat_idx) % lon_idx % lat_idx 
+	% lay.get(0, idx) % lay.get(1, idx); 
+    }
+  }
+
+  int chars; 
+  bool by_band, by_hour; 
+  // layer key is band * 100 + hour + 1 (band 0 or hour -1 when we
+  // aren't splitting that way); the index holds position + 1
+  FlatCounter<int, uint32_t> layer_index; 
+  std::vector<int> layer_keys; 
+  std::vector<GridLayer> layers; 
+  uint64_t skipped[2]; 
+};
+
+#endif
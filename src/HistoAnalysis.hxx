@@ -0,0 +1,159 @@
+#ifndef HISTO_ANALYSIS_HDR
+#define HISTO_ANALYSIS_HDR
+#include "WSPRLogAnalysis.hxx"
+#include "FlatCounter.hxx"
+#include "Histogram.hxx"
+#include "WSPRLogPartial.hxx"
+#include <boost/format.hpp>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstdlib>
+#include <math.h>
+
+// WSPRLogHisto: histograms of numeric fields -- value, count, pdf, cdf
+
+// one histogram: a field and its bin width.  Width 1 bins the integer
+// value of the field, as this tool always has; any other width bins
+// the value as a double, floor(value / width).
+class FieldHisto {
+public:
+  FieldHisto(const std::string & _spec, WSPRLogEntry::Field _sel, double _width) {
+    spec = _spec;
+    sel = _sel;
+    width = _width;
+    dropped = 0;
+  }
+
+  // spec is FIELD or FIELD:width.  false (and a message) if it's bad.
+  static bool parse(const std::string & spec, std::vector<FieldHisto> & fields) {
+    size_t colon = spec.find(':');
+    WSPRLogEntry::Field sel = WSPRLogEntry::str2Field(spec.substr(0, colon));
+    if(sel == WSPRLogEntry::UNDEFINED) {
+      std::cerr << boost::format("Bad field selected [%s].\n") % spec;
+      WSPRLogEntry::printFieldChoices(std::cerr);
+      return false;
+    }
+    double width = 1.0;
+    if(colon != std::string::npos) {
+      width = atof(spec.c_str() + colon + 1);
+      if(!(width > 0.0)) {
+	std::cerr << boost::format("Bad bin width in [%s].\n") % spec;
+	return false;
+      }
+    }
+    fields.push_back(FieldHisto(spec, sel, width));
+    return true;
+  }
+
+  // entries with no number in this field (a call sign, say) are
+  // counted in dropped, not binned
+  void add(WSPRLogEntry * ent) {
+    if(width == 1.0) {
+      int el;
+      if(!ent->getField(sel, el)) {
+	dropped++;
+	return;
+      }
+      histogram.add(el);
+    }
+    else {
+      double v;
+      if(!ent->getNumber(sel, v)) {
+	dropped++;
+	return;
+      }
+      histogram.add((int64_t) floor(v / width));
+    }
+  }
+
+  void merge(const FieldHisto & other) {
+    histogram.merge(other.histogram);
+    dropped += other.dropped;
+  }
+
+  std::string spec;
+  WSPRLogEntry::Field sel;
+  double width;
+  RangeHistogram histogram;
+  uint64_t dropped;
+};
+
+class HistoAnalysis : public WSPRLogAnalysis {
+public:
+  HistoAnalysis(const std::vector<FieldHisto> & _fields) {
+    fields = _fields;
+  }
+
+  // field=FIELD[:width], as many as you like
+  static WSPRLogAnalysis * make(const WSPRLogAnalysisArgs & args) {
+    std::vector<FieldHisto> fields;
+    auto range = args.equal_range("field");
+    for(auto it = range.first; it != range.second; ++it) {
+      if(!FieldHisto::parse(it->second, fields)) return NULL;
+    }
+    if(fields.empty()) {
+      std::cerr << "Histo needs at least one field=FIELD\n";
+      return NULL;
+    }
+    return new HistoAnalysis(fields);
+  }
+
+  WSPRLogAccumulator * clone() const { return new HistoAnalysis(protos()); }
+
+  void merge(const WSPRLogAccumulator & other) {
+    const HistoAnalysis & o = static_cast<const HistoAnalysis &>(other);
+    for(size_t i = 0; i < fields.size(); i++) {
+      fields[i].merge(o.fields[i]);
+    }
+  }
+
+  void add(WSPRLogEntry * ent) {
+    for(auto & f: fields) f.add(ent);
+  }
+
+  // the raw counts, for the report or a partial file.  Each field gets
+  // a table named by its spec.
+  void toPartial(WSPRLogPartial & part) {
+    for(auto & f: fields) {
+      FlatCounter<int64_t, uint64_t> & counts = part.sparse(f.spec);
+      f.histogram.forEach([&counts](int64_t k, uint64_t v) { counts.add(k, v); });
+    }
+  }
+
+  // an empty partial with the right kind and params
+  WSPRLogPartial newPartial() const {
+    std::string spec_list;
+    for(auto & f: fields) spec_list += (spec_list.empty() ? "" : ",") + f.spec;
+    return WSPRLogPartial("Histo", "fields=" + spec_list);
+  }
+
+  void report(const std::string & out) {
+    WSPRLogPartial part = newPartial();
+    toPartial(part);
+    std::ofstream ofs(out);
+    WSPRLogReport::histo(part, ofs);
+    reportDropped(std::cerr);
+  }
+
+  // a note for each field that had entries it couldn't bin
+  void reportDropped(std::ostream & os) const {
+    for(auto & f: fields) {
+      if(f.dropped == 0) continue;
+      os << boost::format("%s: skipped %d reports with no numeric value\n") % f.spec % f.dropped;
+    }
+  }
+
+private:
+  // the fields with empty histograms, for clone()
+  std::vector<FieldHisto> protos() const {
+    std::vector<FieldHisto> ret;
+    for(auto & f: fields) ret.push_back(FieldHisto(f.spec, f.sel, f.width));
+    return ret;
+  }
+
+  std::vector<FieldHisto> fields;
+};
+
+#endif
@@ -1,34 +1,150 @@
 #ifndef HISTOGRAM_HDR
 #define HISTOGRAM_HDR
-#include <map>
-#include <iostream> 
+#include "FlatCounter.hxx"
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
 
+// counts by key, printed in key order.  Integer keys go straight
+// into a FlatCounter.
 template <typename K> class Histogram {
 public:
   Histogram() {
   }
 
   void addEntry(const K & key) {
-    if(hist.find(key) == key.end()) {
-      hist[key] = 1; 
-    }
-    else {
-      hist[key] = hist[key] + 1; 
+    hist.add(key);
+  }
+
+  std::ostream & print(std::ostream & os) {
+    std::vector<std::pair<K, unsigned int> > ents;
+    hist.sorted(ents);
+    for(auto kvp: ents) {
+      os << kvp.first << " " << kvp.second << std::endl;
     }
+    return os;
+  }
+
+protected:
+  FlatCounter<K> hist;
+};
+
+// strings are interned first, and counted by id
+template <> class Histogram<std::string> {
+public:
+  Histogram() {
+  }
+
+  void addEntry(const std::string & key) {
+    hist.add(names.intern(key));
   }
 
   std::ostream & print(std::ostream & os) {
-    for(auto kvp: hist) {
-      os << kvp.first << " " << kvp.second << std::endl; 
+    std::vector<int> ids;
+    hist.forEach([&ids](int id, unsigned int) { ids.push_back(id); });
+    names.sortByName(ids);
+    for(auto id: ids) {
+      os << names.name(id) << " " << hist.get(id) << std::endl;
     }
-    return os; 
+    return os;
   }
 
 protected:
-  std::map<K, unsigned int> hist; 
+  StringInterner names;
+  FlatCounter<int> hist;
 };
 
+// counts by integer bin, for when we don't know the range ahead of
+// time.  The counts are kept in an array that covers the bins seen so
+// far, growing as new bins turn up.  If that would take more than
+// max_dense bins (a field with a few wild values) the counts move to
+// a FlatCounter instead.
+class RangeHistogram {
+public:
+  RangeHistogram(size_t _max_dense = 65536) {
+    max_dense = (int64_t) _max_dense;
+    lo = 0;
+    is_sparse = false;
+  }
 
+  void add(int64_t bin, uint64_t n = 1) {
+    if(!is_sparse) {
+      int64_t off = bin - lo;
+      if((off >= 0) && (off < (int64_t) dense.size())) {
+	dense[off] += n;
+	return;
+      }
+      if(grow(bin)) {
+	dense[bin - lo] += n;
+	return;
+      }
+    }
+    sparse.add(bin, n);
+  }
 
-#endif
+  void merge(const RangeHistogram & other) {
+    other.forEach([this](int64_t b, uint64_t c) { add(b, c); });
+  }
+
+  // bins with counts -- in bin order unless the histogram is sparse
+  template<typename F> void forEach(F f) const {
+    if(is_sparse) {
+      sparse.forEach(f);
+      return;
+    }
+    for(size_t i = 0; i < dense.size(); i++) {
+      if(dense[i] != 0) f(lo + ((int64_t) i), dense[i]);
+    }
+  }
+
+  void sorted(std::vector<std::pair<int64_t, uint64_t> > & res) const {
+    if(is_sparse) {
+      sparse.sorted(res);
+      return;
+    }
+    res.clear();
+    forEach([&res](int64_t b, uint64_t c) { res.push_back(std::make_pair(b, c)); });
+  }
+
+  bool isSparse() const { return is_sparse; }
 
+private:
+  // make room for bin in the array, or go sparse
+  bool grow(int64_t bin) {
+    int64_t cur = (int64_t) dense.size();
+    int64_t nlo = dense.empty() ? bin : std::min(lo, bin);
+    int64_t nhi = dense.empty() ? (bin + 1) : std::max(lo + cur, bin + 1);
+    if((nhi - nlo) > max_dense) {
+      toSparse();
+      return false;
+    }
+    // at least double, so a range that creeps out one bin at a time
+    // doesn't copy the array every time
+    int64_t size = std::min(std::max(nhi - nlo, 2 * cur), max_dense);
+    if(bin < lo) nlo = nhi - size;
+    else nhi = nlo + size;
+
+    std::vector<uint64_t> nd(size, 0);
+    // (the first bin: nothing to copy, and lo means nothing yet)
+    if(!dense.empty()) std::copy(dense.begin(), dense.end(), nd.begin() + (lo - nlo));
+    dense.swap(nd);
+    lo = nlo;
+    return true;
+  }
+
+  void toSparse() {
+    forEach([this](int64_t b, uint64_t c) { sparse.add(b, c); });
+    std::vector<uint64_t>().swap(dense);
+    is_sparse = true;
+  }
+
+  int64_t max_dense;
+  int64_t lo;
+  bool is_sparse;
+  std::vector<uint64_t> dense;
+  FlatCounter<int64_t, uint64_t> sparse;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef HYPERLOGLOG_HDR
+#define HYPERLOGLOG_HDR
+#include "BinaryIO.hxx"
+#include "FlatCounter.hxx"
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+
+// Counts distinct items (calls, paths) approximately in 2^p bytes
+// (Flajolet, Fusy, Gandouet, and Meunier, "HyperLogLog: the analysis of
+// a near-optimal cardinality estimation algorithm", 2007).  The
+// standard error is 1.04/sqrt(2^p) -- 1.6% at the default p = 12,
+// in 4KB.
+//
+// Two sketches with the same p merge (register by register max) into
+// the sketch of both sets.  A sketch starts out sparse -- a sorted list
+// of the registers that aren't zero -- and only grows to the full 2^p
+// bytes when that list would be bigger.  Most cells (one grid square
+// in one hour) never see enough calls to get there.  The estimate is
+// the same either way.  Items are hashed with stableHash, so
+// sketches saved by different runs and different builds still merge.
+class HyperLogLog {
+public:
+  HyperLogLog(int _p = 12) {
+    p = (_p < MIN_P) ? MIN_P : ((_p > MAX_P) ? MAX_P : _p);
+    m = ((size_t) 1) << p;
+  }
+
+  void add(const std::string & s) { addHash(stableHash(s)); }
+
+  // h from stableHash
+  void addHash(uint64_t h) {
+    // the top p bits pick the register, the rest give the rank
+    size_t idx = h >> (64 - p);
+    uint64_t rest = (h << p) | (((uint64_t) 1) << (p - 1));
+    setRegister(idx, 1 + leadingZeros(rest));
+  }
+
+  // false (and no change) if the sketches are different sizes
+  bool merge(const HyperLogLog & other) {
+    if(other.p != p) return false;
+    if(other.isSparse()) {
+      for(auto e: other.sparse) setRegister(e >> 8, e & 0xff);
+      return true;
+    }
+    if(isSparse()) densify();
+    for(size_t i = 0; i < m; i++) {
+      regs[i] = (other.regs[i] > regs[i]) ? other.regs[i] : regs[i];
+    }
+    return true;
+  }
+
+  double estimate() const {
+    const double dm = (double) m;
+    double sum = 0.0;
+    size_t zeros = 0;
+    if(isSparse()) {
+      zeros = m - sparse.size();
+      sum = (double) zeros;
+      for(auto e: sparse) sum += ldexp(1.0, -((int) (e & 0xff)));
+    }
+    else {
+      for(auto r: regs) {
+	sum += ldexp(1.0, -((int) r));
+	if(r == 0) zeros++;
+      }
+    }
+    double alpha = 0.7213 / (1.0 + 1.079 / dm);
+    double est = alpha * dm * dm / sum;
+    // small sets: count the empty registers instead ("linear counting")
+    if((est <= 2.5 * dm) && (zeros > 0)) {
+      est = dm * log(dm / ((double) zeros));
+    }
+    // with a 64 bit hash there is no large range correction to make
+    return est;
+  }
+
+  // one standard deviation, as a fraction of the estimate
+  double stdError() const { return 1.04 / sqrt((double) m); }
+
+  int getP() const { return p; }
+  bool isSparse() const { return regs.empty(); }
+  size_t bytes() const { return isSparse() ? (sparse.size() * sizeof(uint32_t)) : m; }
+
+  // p, then 0 and the 2^p registers, or 1, a count, and the sparse list
+  void write(std::ostream & os) const {
+    BinaryIO::put<uint32_t>(os, p);
+    BinaryIO::put<uint32_t>(os, isSparse() ? 1 : 0);
+    if(isSparse()) {
+      BinaryIO::put<uint32_t>(os, sparse.size());
+      os.write((const char *) sparse.data(), sparse.size() * sizeof(uint32_t));
+    }
+    else {
+      os.write((const char *) regs.data(), m);
+    }
+  }
+
+  bool read(std::istream & is) {
+    uint32_t np, is_sparse;
+    if(!BinaryIO::get(is, np) || (np < (uint32_t) MIN_P) || (np > (uint32_t) MAX_P) ||
+       !BinaryIO::get(is, is_sparse)) return false;
+    p = np;
+    m = ((size_t) 1) << p;
+    sparse.clear();
+    regs.clear();
+    if(is_sparse) {
+      uint32_t n;
+      if(!BinaryIO::get(is, n) || (n > m)) return false;
+      sparse.resize(n);
+      is.read((char *) sparse.data(), n * sizeof(uint32_t));
+      // a damaged list would index past the registers later; each
+      // entry must name a real register, in increasing order
+      for(size_t i = 0; i < sparse.size(); i++) {
+	if(((sparse[i] >> 8) >= m) ||
+	   ((i > 0) && ((sparse[i] >> 8) <= (sparse[i - 1] >> 8)))) {
+	  sparse.clear();
+	  return false;
+	}
+      }
+    }
+    else {
+      regs.resize(m);
+      is.read((char *) regs.data(), m);
+    }
+    return !is.fail();
+  }
+
+private:
+  enum { MIN_P = 4, MAX_P = 18 };
+
+  void setRegister(size_t idx, uint8_t rank) {
+    if(!isSparse()) {
+      if(rank > regs[idx]) regs[idx] = rank;
+      return;
+    }
+    // the list is sorted by register, with the rank in the low byte
+    uint32_t e = (((uint32_t) idx) << 8) | rank;
+    auto it = std::lower_bound(sparse.begin(), sparse.end(), ((uint32_t) idx) << 8);
+    if((it != sparse.end()) && ((*it >> 8) == idx)) {
+      if(rank > (*it & 0xff)) *it = e;
+      return;
+    }
+    sparse.insert(it, e);
+    // past a quarter of the registers, the list is as big as the array
+    if((sparse.size() * 4) > m) densify();
+  }
+
+  void densify() {
+    regs.assign(m, 0);
+    for(auto e: sparse) regs[e >> 8] = e & 0xff;
+    std::vector<uint32_t>().swap(sparse);
+  }
+
+  static int leadingZeros(uint64_t v) {
+    int n = 0;
+    while((v & (((uint64_t) 1) << 63)) == 0) {
+      v <<= 1;
+      n++;
+    }
+    return n;
+  }
+
+  int p;
+  size_t m;
+  // regs is empty while the sketch is sparse
+  std::vector<uint8_t> regs;
+  std::vector<uint32_t> sparse;
+};
+#endif
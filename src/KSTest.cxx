@@ -1,4 +1,5 @@
 #include "KolmogorovSmirnov.hxx"
+#include "CountHistogram.hxx"
 
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
@@ -6,20 +7,67 @@
 #include <iostream>
 #include <fstream>
 #include <map>
+#include <string>
+#include <iterator>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+// one value per line; blank lines and lines starting with # are
+// skipped.  Big files (10^8 samples) are read in one go and each line
+// parsed with strtod -- much faster than operator>>.  Anything else on
+// a line is an error, not something to step over.
+static bool readSamples(const std::string & fname, std::vector<double> & res)
+{
+  std::ifstream is(fname, std::ios::binary); 
+  if(!is.is_open()) {
+    std::cerr << boost::format("Could not open sample file [%s].\n") % fname; 
+    return false; 
+  }
+  std::string buf((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>()); 
+  const char * p = buf.c_str(); 
+  const char * end = p + buf.size(); 
+  int line_num = 0; 
+  while(p < end) {
+    line_num++; 
+    const char * eol = std::find(p, end, '\n'); 
+    const char * q = p; 
+    while((q < eol) && isspace(*q)) q++; 
+    if((q < eol) && (*q != '#')) {
+      char * next; 
+      double v = strtod(q, &next); 
+      const char * t = next; 
+      while((t < eol) && isspace(*t)) t++; 
+      if((next == q) || (t != eol)) {
+	std::cerr << boost::format("%s line %d: expected one number, got [%s]\n")
+	  % fname % line_num % std::string(p, eol); 
+	return false; 
+      }
+      res.push_back(v); 
+    }
+    p = eol + 1; 
+  }
+  return true; 
+}
 
 int main(int argc, char * argv[])
 {
   std::string S_fname, X_fname; 
   std::string cdf_name; 
+  std::string method_name; 
+  int num_threads; 
 
   namespace po = boost::program_options;
 
   po::options_description desc("Options:");
   desc.add_options()
     ("help", "help message")
-    ("standard", po::value<std::string>(&S_fname)->required(), "Histogram file for null hypothesis")
-    ("experiment", po::value<std::string>(&X_fname)->required(), "Histogram file for experimental result")
-    ("cdf", po::value<std::string>(&cdf_name)->default_value(""), "CDF output file") ;
+    ("standard", po::value<std::string>(&S_fname)->required(), "Histogram for null hypothesis (text or binary histogram file, or partial_file:table[:row]), or with --raw, a sample file")
+    ("experiment", po::value<std::string>(&X_fname)->required(), "Histogram for experimental result (same forms as standard)")
+    ("cdf", po::value<std::string>(&cdf_name)->default_value(""), "CDF output file")
+    ("raw", "The files hold raw samples (one value per line, any order) instead of histograms")
+    ("method", po::value<std::string>(&method_name)->default_value("auto"), "p value: exact, asymptotic, or auto (exact if n * m <= 10^7)")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of threads for sorting raw samples");
   
   po::positional_options_description pos_opts ;
   pos_opts.add("standard", 1);
@@ -54,39 +102,53 @@ int main(int argc, char * argv[])
     exit(-1);        
   }
 
-  std::ifstream Sst(S_fname); 
-  std::ifstream Xst(X_fname); 
-  
-  std::vector<int> S; 
-  std::vector<int> X; 
-  
-  for(int n; Sst >> n; ) {
-    S.push_back(n); 
+  KolmogorovSmirnov::Method method; 
+  if(method_name == "auto") method = KolmogorovSmirnov::AUTO; 
+  else if(method_name == "exact") method = KolmogorovSmirnov::EXACT; 
+  else if(method_name == "asymptotic") method = KolmogorovSmirnov::ASYMPTOTIC; 
+  else {
+    std::cerr << "ERROR: method must be one of exact, asymptotic, or auto" << std::endl; 
+    exit(-1); 
   }
-  for(int n; Xst >> n; ) {
-    X.push_back(n); 
+
+  KolmogorovSmirnov::Result res; 
+  std::vector<uint64_t> S, X; 
+  if(vm.count("raw")) {
+    std::vector<double> Sraw, Xraw; 
+    if(!readSamples(S_fname, Sraw) || !readSamples(X_fname, Xraw)) exit(-1); 
+    res = KolmogorovSmirnov::samples(Sraw, Xraw, num_threads, method); 
   }
+  else {
+    CountHistogram Sh, Xh; 
+    if(!Sh.read(S_fname) || !Xh.read(X_fname) || !Sh.conform(Xh, S_fname, X_fname)) exit(-1);
+    S.swap(Sh.counts); 
+    X.swap(Xh.counts); 
+    res = KolmogorovSmirnov::histograms(S, X, method); 
+  }
+
+  std::cout << boost::format("D = %g n = %d m = %d p = %g (%s)\n")
+    % res.D % res.n % res.m % res.p_value % (res.exact ? "exact" : "asymptotic"); 
 
-  // now calculate the KS score
-  float a = 0.5; 
+  // and the old table, all from the one D
   float sv[] = {5.0, 2.0, 1.0}; 
   for(float a = 0.1; a > 0.0001; a = 0.1 * a) {
     for(int i = 0; i < 3; i++) {
       float aa = a * sv[i] ; 
-      bool reject = KolmogorovSmirnov::test(aa, S, X); 
+      bool reject = res.D > KolmogorovSmirnov::criticalD(aa, res.n, res.m); 
       std::cout << boost::format("alpha = %f  reject = %c\n")
 	% aa % ((char) (reject ? 'T' : 'F'));
     }
   }
   
-  int Ssum = 0; 
-  int Xsum = 0; 
-  if(cdf_name.length() != 0) {
-    std::vector<float> Scdf = KolmogorovSmirnov::cdf(S, Ssum);
-    std::vector<float> Xcdf = KolmogorovSmirnov::cdf(X, Xsum);    
+  if((cdf_name.length() != 0) && !vm.count("raw")) {
+    float Sscale = 1.0 / ((float) res.n); 
+    float Xscale = 1.0 / ((float) res.m); 
+    float Scdf = 0.0, Xcdf = 0.0; 
     std::ofstream cof(cdf_name); 
-    for(int i = 0; i < Scdf.size(); i++) {
-      cof << boost::format("%d %g %g\n") % i % Scdf[i] % Xcdf[i];
+    for(size_t i = 0; i < S.size(); i++) {
+      Scdf += ((float) S[i]) * Sscale; 
+      Xcdf += ((float) X[i]) * Xscale; 
+      cof << boost::format("%d %g %g\n") % i % Scdf % Xcdf;
     }
     cof.close();
   }
@@ -2,6 +2,8 @@
 #include <boost/format.hpp>
 #include <cmath>
 #include <iostream>
+#include <algorithm>
+#include <thread>
 
 std::vector<float> KolmogorovSmirnov::cdf(const std::vector<int> & S, int & N)
 {
@@ -27,26 +29,184 @@ bool KolmogorovSmirnov::test(float alpha,
 			     const std::vector<int> & S, 
 			     const std::vector<int> & X) 
 {
-  int N, M; 
-  std::vector<float> Scdf = cdf(S, N);
-  std::vector<float> Xcdf = cdf(X, M);
-  
-  float max_sep = 0.0; 
-  for(int i = 0; i < S.size(); i++) {
-    float sep = fabs(Scdf[i] - Xcdf[i]);
-    max_sep = (max_sep > sep) ? max_sep : sep; 
+  std::vector<uint64_t> S64(S.begin(), S.end());
+  std::vector<uint64_t> X64(X.begin(), X.end());
+  Result res = histograms(S64, X64, ASYMPTOTIC);
+
+  return res.D > criticalD(alpha, res.n, res.m);
+}
+
+KolmogorovSmirnov::Result KolmogorovSmirnov::histograms(const std::vector<uint64_t> & S,
+							const std::vector<uint64_t> & X,
+							Method method)
+{
+  Result res;
+  res.n = res.m = 0;
+  for(auto v: S) res.n += v;
+  for(auto v: X) res.m += v;
+
+  // walk both cdfs together; the counts stay integers until the end
+  double rn = 1.0 / ((double) res.n);
+  double rm = 1.0 / ((double) res.m);
+  uint64_t cs = 0, cx = 0;
+  double D = 0.0;
+  size_t len = std::max(S.size(), X.size());
+  for(size_t i = 0; i < len; i++) {
+    if(i < S.size()) cs += S[i];
+    if(i < X.size()) cx += X[i];
+    double sep = fabs(((double) cs) * rn - ((double) cx) * rm);
+    D = (sep > D) ? sep : D;
+  }
+  res.D = D;
+  res.p_value = pValue(D, res.n, res.m, method, &res.exact);
+  return res;
+}
+
+KolmogorovSmirnov::Result KolmogorovSmirnov::samples(std::vector<double> & S, std::vector<double> & X,
+						     int num_threads, Method method)
+{
+  parallelSort(S, num_threads);
+  parallelSort(X, num_threads);
+
+  Result res;
+  res.n = S.size();
+  res.m = X.size();
+  double rn = 1.0 / ((double) res.n);
+  double rm = 1.0 / ((double) res.m);
+
+  // step over each value, and all its ties, in both samples at once
+  size_t i = 0, j = 0;
+  double D = 0.0;
+  while((i < S.size()) && (j < X.size())) {
+    double v = std::min(S[i], X[j]);
+    while((i < S.size()) && (S[i] == v)) i++;
+    while((j < X.size()) && (X[j] == v)) j++;
+    double sep = fabs(((double) i) * rn - ((double) j) * rm);
+    D = (sep > D) ? sep : D;
+  }
+  res.D = D;
+  res.p_value = pValue(D, res.n, res.m, method, &res.exact);
+  return res;
+}
+
+// P(D < d) by counting the lattice paths from (0,0) to (m,n) that stay
+// inside the band (Hodges, 1957), scaled as we go so nothing overflows.
+// This is the same recurrence R's ks.test uses.
+static double exactCDF(double d, uint64_t m, uint64_t n)
+{
+  if(m > n) std::swap(m, n);
+  double md = (double) m;
+  double nd = (double) n;
+  // nudge d so a gap equal to d (up to rounding) counts as outside
+  double q = (0.5 + floor(d * md * nd - 1e-7)) / (md * nd);
+
+  std::vector<double> u(n + 1);
+  for(uint64_t j = 0; j <= n; j++) {
+    u[j] = ((((double) j) / nd) > q) ? 0.0 : 1.0;
+  }
+  // for big samples the row underflows, so each row is rescaled to a
+  // max of 1 and the scale is kept as a log
+  double log_scale = 0.0;
+  for(uint64_t i = 1; i <= m; i++) {
+    double w = ((double) i) / ((double) (i + n));
+    double fi = ((double) i) / md;
+    u[0] = (fi > q) ? 0.0 : (w * u[0]);
+    double umax = u[0];
+    for(uint64_t j = 1; j <= n; j++) {
+      u[j] = (fabs(fi - ((double) j) / nd) > q) ? 0.0 : (w * u[j] + u[j - 1]);
+      umax = (u[j] > umax) ? u[j] : umax;
+    }
+    if(umax <= 0.0) return 0.0;
+    if((umax < 1e-100) || (umax > 1e100)) {
+      for(auto & uj: u) uj /= umax;
+      log_scale += log(umax);
+    }
+  }
+  return u[n] * exp(log_scale);
+}
+
+// the Kolmogorov distribution's upper tail, Q(lambda)
+static double kolmogorovQ(double lambda)
+{
+  if(lambda < 0.2) return 1.0;
+  double sum = 0.0;
+  double sign = 1.0;
+  for(int k = 1; k <= 100; k++) {
+    double term = exp(-2.0 * k * k * lambda * lambda);
+    sum += sign * term;
+    if(term < 1e-16) break;
+    sign = -sign;
+  }
+  sum = 2.0 * sum;
+  return (sum < 0.0) ? 0.0 : ((sum > 1.0) ? 1.0 : sum);
+}
+
+double KolmogorovSmirnov::pValue(double d, uint64_t n, uint64_t m, Method method, bool * was_exact)
+{
+  if((n == 0) || (m == 0)) {
+    if(was_exact) *was_exact = false;
+    return 1.0;
   }
 
-  // now is the difference significant? 
-  float n = (float) N;
-  float m = (float) M; 
+  // past 10^8 cells the path count loses too much to rounding, and
+  // the asymptotic answer is as good anyway
+  double cells = ((double) n) * ((double) m);
+  bool exact = ((method == EXACT) && (cells <= 1.0e8)) ||
+    ((method == AUTO) && (cells <= 1.0e7));
+  if(was_exact) *was_exact = exact;
 
-  float calpha = sqrt(-0.5 * log(alpha / 2.0));
-  
-  float Dmin = calpha * sqrt((n + m) / (n*m));
+  if(exact) {
+    double p = 1.0 - exactCDF(d, m, n);
+    return (p < 0.0) ? 0.0 : p;
+  }
 
-  std::cerr << boost::format("Dnm = %f n = %f m = %f calpha = %f Dmin = %f\n")
-    % max_sep % n % m % calpha % Dmin; 
+  double ne = (((double) n) * ((double) m)) / ((double) (n + m));
+  double sne = sqrt(ne);
+  return kolmogorovQ((sne + 0.12 + 0.11 / sne) * d);
+}
 
-  return max_sep  > Dmin; 
+double KolmogorovSmirnov::criticalD(double alpha, uint64_t n, uint64_t m)
+{
+  double fn = (double) n;
+  double fm = (double) m;
+  double calpha = sqrt(-0.5 * log(alpha / 2.0));
+  return calpha * sqrt((fn + fm) / (fn * fm));
+}
+
+void KolmogorovSmirnov::parallelSort(std::vector<double> & v, int num_threads)
+{
+  size_t pieces = (num_threads < 1) ? 1 : (size_t) num_threads;
+  if((pieces == 1) || (v.size() < (pieces * 1024))) {
+    std::sort(v.begin(), v.end());
+    return;
+  }
+
+  // piece k is [bounds[k], bounds[k+1])
+  std::vector<size_t> bounds;
+  for(size_t k = 0; k <= pieces; k++) bounds.push_back((v.size() * k) / pieces);
+
+  std::vector<std::thread> threads;
+  for(size_t k = 0; k < pieces; k++) {
+    threads.push_back(std::thread([&v, &bounds, k]() {
+	  std::sort(v.begin() + bounds[k], v.begin() + bounds[k + 1]);
+	}));
+  }
+  for(auto & t: threads) t.join();
+
+  // merge neighbors until there is one piece
+  while(bounds.size() > 2) {
+    std::vector<size_t> nb;
+    threads.clear();
+    for(size_t k = 0; (k + 1) < bounds.size(); k += 2) {
+      nb.push_back(bounds[k]);
+      if((k + 2) >= bounds.size()) break;  // an odd piece out waits for the next round
+      size_t lo = bounds[k], mid = bounds[k + 1], hi = bounds[k + 2];
+      threads.push_back(std::thread([&v, lo, mid, hi]() {
+	    std::inplace_merge(v.begin() + lo, v.begin() + mid, v.begin() + hi);
+	  }));
+    }
+    nb.push_back(v.size());
+    for(auto & t: threads) t.join();
+    bounds.swap(nb);
+  }
 }
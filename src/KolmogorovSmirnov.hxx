@@ -2,9 +2,45 @@
 #define KS_HDR
 
 #include <vector>
+#include <cstdint>
 
 namespace KolmogorovSmirnov {
   std::vector<float> cdf(const std::vector<int> & S, int & samples);
-  bool test(float alpha, const std::vector<int> & S, const std::vector<int> & X);  
+  bool test(float alpha, const std::vector<int> & S, const std::vector<int> & X);
+
+  enum Method { AUTO, EXACT, ASYMPTOTIC };
+
+  /// the two sample statistic and its significance
+  class Result {
+  public:
+    double D;          ///< largest gap between the two cdfs
+    uint64_t n, m;     ///< sample sizes
+    double p_value;    ///< P(D >= this D) if the samples are from the same distribution
+    bool exact;        ///< true if p_value is exact, false if asymptotic
+  };
+
+  /// D and p for two histograms with the same buckets.  Ties (many
+  /// samples in one bucket) make the p value conservative.
+  Result histograms(const std::vector<uint64_t> & S, const std::vector<uint64_t> & X,
+		    Method method = AUTO);
+
+  /// D and p for two unbinned samples.  S and X are sorted in place,
+  /// on num_threads threads.
+  Result samples(std::vector<double> & S, std::vector<double> & X,
+		 int num_threads = 1, Method method = AUTO);
+
+  /// P(D >= d) for samples of n and m.  AUTO is exact (Hodges' lattice
+  /// path count, O(n * m)) when n * m is at most 10^7, and otherwise the
+  /// Kolmogorov distribution with Stephens' small sample correction.
+  /// EXACT is asymptotic anyway past 10^8.
+  double pValue(double d, uint64_t n, uint64_t m, Method method = AUTO, bool * was_exact = 0);
+
+  /// the D a test at level alpha rejects above, by the asymptotic
+  /// formula c(alpha) sqrt((n + m) / (n m))
+  double criticalD(double alpha, uint64_t n, uint64_t m);
+
+  /// sort v on num_threads threads: the pieces are sorted, then
+  /// merged in pairs
+  void parallelSort(std::vector<double> & v, int num_threads);
 }
 #endif
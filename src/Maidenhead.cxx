@@ -0,0 +1,128 @@
+#include "Maidenhead.hxx"
+#include <ctype.h>
+
+bool Maidenhead::decode(const std::string & grid, double & lat, double & lon)
+{
+  size_t len = grid.length(); 
+  lat = lon = 0.0; 
+  if((len < 2) || (len > 8) || ((len % 2) != 0)) return false; 
+
+  // size of the current square, in degrees
+  double lon_step = 20.0; 
+  double lat_step = 10.0; 
+  double lo = -180.0; 
+  double la = -90.0; 
+
+  for(size_t i = 0; i < len; i += 2) {
+    int c0 = toupper(grid[i]); 
+    int c1 = toupper(grid[i + 1]); 
+    int d0, d1; 
+    switch (i) {
+    case 0: 
+      // field
+      if((c0 < 'A') || (c0 > 'R') || (c1 < 'A') || (c1 > 'R')) return false; 
+      d0 = c0 - 'A'; 
+      d1 = c1 - 'A'; 
+      break; 
+    case 2: 
+    case 6:
+      // square and extended square
+      if(!isdigit(c0) || !isdigit(c1)) return false; 
+      d0 = c0 - '0'; 
+      d1 = c1 - '0'; 
+      lon_step = lon_step / 10.0; 
+      lat_step = lat_step / 10.0; 
+      break;
+    case 4:
+      // subsquare
+      if((c0 < 'A') || (c0 > 'X') || (c1 < 'A') || (c1 > 'X')) return false; 
+      d0 = c0 - 'A'; 
+      d1 = c1 - 'A'; 
+      lon_step = lon_step / 24.0; 
+      lat_step = lat_step / 24.0; 
+      break;
+    }
+    lo += lon_step * ((double) d0); 
+    la += lat_step * ((double) d1); 
+  }
+
+  // the centre of the smallest square
+  lon = lo + 0.5 * lon_step; 
+  lat = la + 0.5 * lat_step; 
+  return true; 
+}
+
+std::string Maidenhead::gridName(int chars, int lon_idx, int lat_idx)
+{
+  char buf[7]; 
+  if(chars >= 6) {
+    buf[4] = 'a' + (lon_idx % 24); 
+    buf[5] = 'a' + (lat_idx % 24); 
+    lon_idx /= 24; 
+    lat_idx /= 24; 
+  }
+  if(chars >= 4) {
+    buf[2] = '0' + (lon_idx % 10); 
+    buf[3] = '0' + (lat_idx % 10); 
+    lon_idx /= 10; 
+    lat_idx /= 10; 
+  }
+  buf[0] = 'A' + lon_idx; 
+  buf[1] = 'A' + lat_idx; 
+  return std::string(buf, (chars >= 6) ? 6 : ((chars >= 4) ? 4 : 2)); 
+}
+
+int Maidenhead::GridCache::addGrid(const std::string & grid)
+{
+  LatLon ll; 
+  ll.valid = decode(grid, ll.lat, ll.lon); 
+  locs.push_back(ll); 
+  names.push_back(grid); 
+  return locs.size() - 1; 
+}
+
+int Maidenhead::GridCache::intern(const std::string & grid)
+{
+  uint64_t key; 
+  if(packGrid(grid, key)) {
+    auto it = packed_ids.find(key); 
+    if(it != packed_ids.end()) return it->second; 
+    int id = addGrid(grid); 
+    packed_ids[key] = id; 
+    return id; 
+  }
+  else {
+    auto it = long_ids.find(grid); 
+    if(it != long_ids.end()) return it->second; 
+    int id = addGrid(grid); 
+    long_ids[grid] = id; 
+    return id; 
+  }
+}
+
+void Maidenhead::GridCache::resolve(const std::vector<std::string> & grids, 
+				    std::vector<int> & ids)
+{
+  ids.resize(grids.size()); 
+  for(size_t i = 0; i < grids.size(); i++) {
+    ids[i] = intern(grids[i]); 
+  }
+}
+
+void Maidenhead::GridCache::resolve(const std::vector<std::string> & grids, 
+				    std::vector<double> & lats, std::vector<double> & lons)
+{
+  lats.resize(grids.size()); 
+  lons.resize(grids.size()); 
+  for(size_t i = 0; i < grids.size(); i++) {
+    const LatLon & ll = lookup(grids[i]); 
+    lats[i] = ll.lat; 
+    lons[i] = ll.lon; 
+  }
+}
+
+Maidenhead::GridCache & Maidenhead::threadCache()
+{
+  static thread_local GridCache cache; 
+  return cache; 
+}
@@ -0,0 +1,104 @@
+#ifndef MAIDENHEAD_HDR
+#define MAIDENHEAD_HDR
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cctype>
+
+// Maidenhead grid locators.  
+// Locators are 2, 4, 6, or 8 characters: a field (AA-RR), a square
+// (00-99), a subsquare (aa-xx) and an extended square (00-99).
+// Each grid decodes to the latitude and longitude of its centre. 
+namespace Maidenhead {
+  class LatLon {
+  public:
+    LatLon() { lat = lon = 0.0; valid = false; }
+    double lat; 
+    double lon; 
+    bool valid; 
+  };
+
+  // returns false (and 0,0) for a malformed locator
+  bool decode(const std::string & grid, double & lat, double & lon);
+
+  // number of cells along each axis for locators of this many
+  // characters: 18 fields, 180 squares, or 4320 subsquares.
+  inline int gridCells(int chars) {
+    return (chars <= 2) ? 18 : ((chars <= 4) ? 180 : 4320); 
+  }
+
+  // The longitude and latitude cell numbers of a locator, in cells
+  // of the size given by chars (2, 4, or 6) -- just index arithmetic,
+  // no floating point.  False if the locator is shorter than that or
+  // malformed. 
+  inline bool gridIndex(const std::string & grid, int chars, int & lon_idx, int & lat_idx) {
+    if((int) grid.length() < chars) return false; 
+    int d0 = toupper(grid[0]) - 'A'; 
+    int d1 = toupper(grid[1]) - 'A'; 
+    if((d0 < 0) || (d0 > 17) || (d1 < 0) || (d1 > 17)) return false; 
+    lon_idx = d0; 
+    lat_idx = d1; 
+    if(chars < 4) return true; 
+
+    d0 = grid[2] - '0'; 
+    d1 = grid[3] - '0'; 
+    if((d0 < 0) || (d0 > 9) || (d1 < 0) || (d1 > 9)) return false; 
+    lon_idx = lon_idx * 10 + d0; 
+    lat_idx = lat_idx * 10 + d1; 
+    if(chars < 6) return true; 
+
+    d0 = toupper(grid[4]) - 'A'; 
+    d1 = toupper(grid[5]) - 'A'; 
+    if((d0 < 0) || (d0 > 23) || (d1 < 0) || (d1 > 23)) return false; 
+    lon_idx = lon_idx * 24 + d0; 
+    lat_idx = lat_idx * 24 + d1; 
+    return true; 
+  }
+
+  // the locator for a cell from gridIndex
+  std::string gridName(int chars, int lon_idx, int lat_idx); 
+
+  // the same grid always gets the same key, as long as it is a
+  // legal locator length. 
+  inline bool packGrid(const std::string & grid, uint64_t & key) {
+    size_t len = grid.length(); 
+    if(len > sizeof(uint64_t)) return false; 
+    key = 0; 
+    for(size_t i = 0; i < len; i++) {
+      key = (key << 8) | ((unsigned char) grid[i]); 
+    }
+    return true; 
+  }
+
+  // Interns grid names, and decodes each one just once. 
+  // Ids are small integers handed out in order of first appearance. 
+  class GridCache {
+  public:
+    int intern(const std::string & grid); 
+
+    const LatLon & location(int id) const { return locs[id]; }
+    const std::string & name(int id) const { return names[id]; }
+    size_t size() const { return locs.size(); }
+
+    const LatLon & lookup(const std::string & grid) { return locs[intern(grid)]; }
+
+    // resolve a whole column of grids at once
+    void resolve(const std::vector<std::string> & grids, std::vector<int> & ids); 
+    void resolve(const std::vector<std::string> & grids, 
+		 std::vector<double> & lats, std::vector<double> & lons); 
+
+  private:
+    int addGrid(const std::string & grid); 
+
+    std::unordered_map<uint64_t, int> packed_ids; 
+    // for the (illegal) grids that don't pack
+    std::unordered_map<std::string, int> long_ids; 
+    std::vector<LatLon> locs; 
+    std::vector<std::string> names; 
+  }; 
+
+  // a cache for the calling thread
+  GridCache & threadCache(); 
+}
+#endif
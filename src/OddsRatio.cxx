@@ -0,0 +1,126 @@
+#include "OddsRatio.hxx"
+#include "Resample.hxx"
+#include <boost/math/distributions/normal.hpp>
+#include <boost/math/special_functions/beta.hpp>
+#include <algorithm>
+#include <cmath>
+
+WindowOR::WindowOR(size_t buckets, size_t rows,
+		   const std::vector<uint64_t> & all, const std::vector<uint64_t> & exc,
+		   double _ref_events, double _ref_nonevents)
+{
+  num_buckets = buckets;
+  num_rows = rows;
+  ref_events = _ref_events;
+  ref_nonevents = _ref_nonevents;
+
+  all_prefix.assign(rows * (buckets + 1), 0);
+  exc_prefix.assign(rows * (buckets + 1), 0);
+  for(size_t r = 0; r < rows; r++) {
+    uint64_t * ap = &all_prefix[r * (buckets + 1)];
+    uint64_t * ep = &exc_prefix[r * (buckets + 1)];
+    for(size_t i = 0; i < buckets; i++) {
+      ap[i + 1] = ap[i] + all[r * buckets + i];
+      ep[i + 1] = ep[i] + exc[r * buckets + i];
+    }
+  }
+}
+
+uint64_t WindowOR::windowSum(const std::vector<uint64_t> & prefix, size_t row,
+			     size_t start, size_t width) const
+{
+  const uint64_t * p = &prefix[row * (num_buckets + 1)];
+  start = start % num_buckets;
+  // a window of a day or more is the whole day
+  if(width >= num_buckets) return p[num_buckets];
+  size_t end = start + width;
+  if(end <= num_buckets) return p[end] - p[start];
+  return (p[num_buckets] - p[start]) + p[end - num_buckets];
+}
+
+double WindowOR::odds(double De, double He, double re, double rn)
+{
+  // no exceptional reports is an honest zero; only a zero below the
+  // line needs the correction
+  if((He == 0.0) || (re <= 0.0) || (rn <= 0.0)) {
+    De += 0.5;
+    He += 0.5;
+    re += 0.5;
+    rn += 0.5;
+  }
+  return (De * rn) / (He * re);
+}
+
+WindowOR::Estimate WindowOR::estimate(size_t row, size_t start, size_t width,
+				      Interval interval, double conf,
+				      int resamples, uint64_t seed) const
+{
+  Estimate est;
+  uint64_t all = windowSum(all_prefix, row, start, width);
+  est.De = windowSum(exc_prefix, row, start, width);
+  est.He = (all > est.De) ? (all - est.De) : 0;
+
+  double De = (double) est.De;
+  double He = (double) est.He;
+  double re = ref_events;
+  double rn = ref_nonevents;
+  est.OR = odds(De, He, re, rn);
+  est.bounded = true;
+
+  double alpha = 1.0 - conf;
+  if(interval == BOOTSTRAP) {
+    // the window is one sample, the day another: {ordinary, exceptional}
+    Resample::Counts S = { est.He, est.De };
+    Resample::Counts X = { (uint64_t) llround(std::max(rn, 0.0)), (uint64_t) llround(std::max(re, 0.0)) };
+    Resample::Result res = Resample::bootstrap(S, X,
+					       [](const Resample::Counts & s, const Resample::Counts & x) {
+						 return odds((double) s[1], (double) s[0],
+							     (double) x[1], (double) x[0]);
+					       }, resamples, conf, seed);
+    est.lo = res.lo;
+    est.hi = res.hi;
+    return est;
+  }
+
+  if(interval == WALD) {
+    // any zero cell: the interval is around the corrected ratio.  That
+    // is est.OR, except for De = 0, where the OR is 0 and so is the
+    // bottom of its interval.
+    if((est.De == 0) || (est.He == 0) || (re <= 0.0) || (rn <= 0.0)) {
+      De += 0.5;
+      He += 0.5;
+      re += 0.5;
+      rn += 0.5;
+    }
+    double center = (De * rn) / (He * re);
+    double z = boost::math::quantile(boost::math::normal(), 1.0 - 0.5 * alpha);
+    double se = sqrt(1.0 / De + 1.0 / He + 1.0 / re + 1.0 / rn);
+    est.lo = (est.De == 0) ? 0.0 : center * exp(-z * se);
+    est.hi = center * exp(z * se);
+    return est;
+  }
+
+  // Clopper-Pearson for the exceptional share of the window, turned
+  // into odds and divided by the day's odds -- corrected, as in
+  // odds(), if either reference count is zero
+  if((re <= 0.0) || (rn <= 0.0)) {
+    re += 0.5;
+    rn += 0.5;
+  }
+  double day_odds = re / rn;
+  double n = (double) (est.De + est.He);
+  double d = (double) est.De;
+  double p_lo = (est.De == 0) ? 0.0 :
+    boost::math::ibeta_inv(d, n - d + 1.0, 0.5 * alpha);
+  est.lo = (p_lo / (1.0 - p_lo)) / day_odds;
+  if(est.He == 0) {
+    // all the window's reports are exceptional: no upper limit
+    est.hi = 0.0;
+    est.bounded = false;
+  }
+  else {
+    double p_hi = boost::math::ibeta_inv(d + 1.0, n - d, 1.0 - 0.5 * alpha);
+    est.hi = (p_hi / (1.0 - p_hi)) / day_odds;
+  }
+  return est;
+}
@@ -0,0 +1,70 @@
+#ifndef ODDSRATIO_HDR
+#define ODDSRATIO_HDR
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/// Odds ratios for windows of a circular time axis (24 hours, say),
+/// from prefix sums of the fine grained counts.  Any window width and
+/// stride costs two lookups per window, so wider windows don't mean
+/// another pass over the logs.
+///
+/// For a window with De exceptional reports and He ordinary ones,
+///
+///   OR = (De / He) / (ref_events / ref_nonevents)
+///
+/// the odds of an exceptional report in the window over the odds
+/// for the whole day.  A window with no exceptional reports has an
+/// OR of 0.  Where He or a reference count is zero, 0.5 is added to
+/// all four (Haldane-Anscombe), so there is always a number to plot
+/// rather than a division by zero.
+///
+/// There are several rows (azimuth bins, say), each with its own
+/// time axis; the reference odds are the same for all of them.
+class WindowOR {
+public:
+  enum Interval { WALD, EXACT, BOOTSTRAP };
+
+  class Estimate {
+  public:
+    uint64_t De, He;   ///< exceptional and ordinary reports in the window
+    double OR;
+    double lo, hi;     ///< the confidence interval
+    bool bounded;      ///< false if there is no upper limit (hi is then meaningless)
+  };
+
+  /// all and exc are [rows][buckets], row major, exc a subset of all.
+  WindowOR(size_t buckets, size_t rows,
+	   const std::vector<uint64_t> & all, const std::vector<uint64_t> & exc,
+	   double ref_events, double ref_nonevents);
+
+  size_t buckets() const { return num_buckets; }
+  size_t rows() const { return num_rows; }
+
+  /// width buckets starting at start, wrapping past the end of the day.
+  /// WALD is the usual interval on log(OR); with any zero count the
+  /// cells are corrected as for OR, and with De = 0 (OR = 0) the
+  /// interval runs from 0 up to the corrected cells' upper limit.
+  /// EXACT is the Clopper-Pearson interval for De out of De + He, with
+  /// the day's odds taken as known; with He = 0 it has no upper limit
+  /// (bounded is false).  BOOTSTRAP
+  /// is the percentile interval from Resample::bootstrap, redrawing
+  /// the window's counts and the day's, resamples times from seed.
+  Estimate estimate(size_t row, size_t start, size_t width,
+		    Interval interval = WALD, double conf = 0.95,
+		    int resamples = 1000, uint64_t seed = 1) const;
+
+private:
+  // the odds ratio, with the zero cell correction
+  static double odds(double De, double He, double re, double rn);
+
+  // sum of [start, start + width), circularly
+  uint64_t windowSum(const std::vector<uint64_t> & prefix, size_t row,
+		     size_t start, size_t width) const;
+
+  size_t num_buckets, num_rows;
+  // [rows][buckets + 1], prefix[r][k] is the sum of buckets 0..k-1
+  std::vector<uint64_t> all_prefix, exc_prefix;
+  double ref_events, ref_nonevents;
+};
+#endif
@@ -0,0 +1,48 @@
+#include "PathGeometry.hxx"
+#include <math.h>
+
+void PathGeometry::midpoint(const Maidenhead::LatLon & a, const Maidenhead::LatLon & b, 
+			    Maidenhead::LatLon & mid)
+{
+  const double d2r = M_PI / 180.0; 
+  double alat = a.lat * d2r; 
+  double alon = a.lon * d2r; 
+  double blat = b.lat * d2r; 
+  double blon = b.lon * d2r; 
+
+  // add the two unit vectors, the sum points at the midpoint
+  double x = cos(alat) * cos(alon) + cos(blat) * cos(blon); 
+  double y = cos(alat) * sin(alon) + cos(blat) * sin(blon); 
+  double z = sin(alat) + sin(blat); 
+
+  mid.valid = a.valid && b.valid; 
+  if((x * x + y * y + z * z) < 1e-12) {
+    // antipodes
+    double lon = 0.5 * (a.lon + b.lon); 
+    if(fabs(a.lon - b.lon) > 180.0) lon += 180.0; 
+    if(lon >= 180.0) lon -= 360.0; 
+    mid.lat = 0.0; 
+    mid.lon = lon; 
+    return; 
+  }
+
+  mid.lat = atan2(z, sqrt(x * x + y * y)) / d2r; 
+  mid.lon = atan2(y, x) / d2r; 
+}
+
+const Maidenhead::LatLon & PathGeometry::midpoint(int tx_id, int rx_id)
+{
+  uint32_t lo = (uint32_t) ((tx_id < rx_id) ? tx_id : rx_id); 
+  uint32_t hi = (uint32_t) ((tx_id < rx_id) ? rx_id : tx_id); 
+  uint64_t key = (((uint64_t) hi) << 32) | lo; 
+
+  auto it = pair_ids.find(key); 
+  if(it != pair_ids.end()) return mids[it->second]; 
+
+  Maidenhead::GridCache & gc = Maidenhead::threadCache(); 
+  Maidenhead::LatLon mid; 
+  midpoint(gc.location(tx_id), gc.location(rx_id), mid); 
+  mids.push_back(mid); 
+  pair_ids[key] = mids.size() - 1; 
+  return mids.back(); 
+}
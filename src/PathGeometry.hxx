@@ -0,0 +1,38 @@
+#ifndef PATHGEOMETRY_HDR
+#define PATHGEOMETRY_HDR
+#include "Maidenhead.hxx"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Geometry of the great-circle path between two grids. 
+// The same tx/rx pairs show up in nearly every cycle, so the
+// results are remembered per pair of grid ids. 
+//
+// The ids come from Maidenhead::threadCache(), which is per thread,
+// so a PathGeometry must only be used from one thread.  (Each
+// accumulator clone has its own, which is how the tools use it.)
+class PathGeometry {
+public:
+  // midpoint of the great-circle path between a and b.  Antipodal
+  // points have no unique path; for those we take the mean longitude
+  // on the equator. 
+  static void midpoint(const Maidenhead::LatLon & a, const Maidenhead::LatLon & b, 
+		       Maidenhead::LatLon & mid); 
+
+  const Maidenhead::LatLon & midpoint(int tx_id, int rx_id); 
+  const Maidenhead::LatLon & midpoint(const std::string & txgrid, const std::string & rxgrid) {
+    Maidenhead::GridCache & gc = Maidenhead::threadCache(); 
+    return midpoint(gc.intern(txgrid), gc.intern(rxgrid)); 
+  }
+
+  size_t size() const { return mids.size(); }
+
+private:
+  // the path is the same in both directions, so the key doesn't
+  // care which grid is which.
+  std::unordered_map<uint64_t, int> pair_ids; 
+  std::vector<Maidenhead::LatLon> mids; 
+}; 
+#endif
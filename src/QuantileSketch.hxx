@@ -0,0 +1,200 @@
+#ifndef QUANTILESKETCH_HDR
+#define QUANTILESKETCH_HDR
+#include "BinaryIO.hxx"
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// A KLL quantile sketch (Karnin, Lang, and Liberty, "Optimal Quantile
+// Approximation in Streams", 2016).  Memory is a few times k values
+// no matter how many are added, and two sketches of the same k
+// merge into one that is as good as a sketch of both streams.
+//
+// Values are kept in levels.  A value at level h stands for 2^h of the
+// values added.  When a level fills up it is sorted and every other
+// value (odd or even ones, picked at random) moves up a level.
+//
+// The "random" bits come from a fixed seed, so the same input in the
+// same order always gives the same answer.
+class KLLSketch {
+public:
+  KLLSketch(int _k = 200) {
+    k = (_k < MIN_K) ? MIN_K : _k;
+    clear();
+  }
+
+  void clear() {
+    levels.assign(1, std::vector<double>());
+    num_retained = 0;
+    n = 0;
+    min_val = std::numeric_limits<double>::infinity();
+    max_val = -std::numeric_limits<double>::infinity();
+    rng = 0x9E3779B97F4A7C15ULL;
+    max_retained = capacity(0);
+  }
+
+  void add(double v) {
+    if(v < min_val) min_val = v;
+    if(v > max_val) max_val = v;
+    n++;
+    levels[0].push_back(v);
+    num_retained++;
+    if(num_retained >= max_retained) compress();
+  }
+
+  // add in the values from another sketch.  Both should have the same k.
+  void merge(const KLLSketch & other) {
+    if(other.n == 0) return;
+    while(levels.size() < other.levels.size()) addLevel();
+    for(size_t h = 0; h < other.levels.size(); h++) {
+      levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+    }
+    num_retained += other.num_retained;
+    n += other.n;
+    min_val = std::min(min_val, other.min_val);
+    max_val = std::max(max_val, other.max_val);
+    while(num_retained >= max_retained) compress();
+  }
+
+  uint64_t count() const { return n; }
+  bool empty() const { return n == 0; }
+  double min() const { return min_val; }
+  double max() const { return max_val; }
+  int getK() const { return k; }
+  size_t retained() const { return num_retained; }
+
+  // The rank of a reported quantile is within this (as a fraction of
+  // count()) of the rank asked for, with 99% confidence.  This is the
+  // fit to measured errors given by the Apache DataSketches KLL code.
+  double rankError() const { return 2.296 / pow((double) k, 0.9723); }
+
+  // the value at fraction q (0 <= q <= 1) of the way through the
+  // sorted values.  NaN if the sketch is empty.
+  double quantile(double q) const {
+    std::vector<double> res;
+    quantiles(std::vector<double>(1, q), res);
+    return res[0];
+  }
+
+  // several quantiles from one sort of the retained values
+  void quantiles(const std::vector<double> & qs, std::vector<double> & res) const {
+    res.assign(qs.size(), std::numeric_limits<double>::quiet_NaN());
+    if(n == 0) return;
+
+    std::vector<std::pair<double, uint64_t> > wv;
+    wv.reserve(num_retained);
+    for(size_t h = 0; h < levels.size(); h++) {
+      for(auto v: levels[h]) wv.push_back(std::make_pair(v, ((uint64_t) 1) << h));
+    }
+    std::sort(wv.begin(), wv.end());
+
+    for(size_t i = 0; i < qs.size(); i++) {
+      if(qs[i] <= 0.0) { res[i] = min_val; continue; }
+      if(qs[i] >= 1.0) { res[i] = max_val; continue; }
+      double target = qs[i] * ((double) n);
+      uint64_t cum = 0;
+      res[i] = max_val;
+      for(auto & e: wv) {
+	cum += e.second;
+	if(((double) cum) >= target) {
+	  res[i] = e.first;
+	  break;
+	}
+      }
+    }
+  }
+
+  void write(std::ostream & os) const {
+    BinaryIO::put<uint32_t>(os, k);
+    BinaryIO::put<uint64_t>(os, n);
+    BinaryIO::put<double>(os, min_val);
+    BinaryIO::put<double>(os, max_val);
+    BinaryIO::put<uint64_t>(os, rng);
+    BinaryIO::put<uint32_t>(os, levels.size());
+    for(auto & lev: levels) {
+      BinaryIO::put<uint32_t>(os, lev.size());
+      os.write((const char *) lev.data(), lev.size() * sizeof(double));
+    }
+  }
+
+  // false if the stream ends early or the sketch doesn't make sense
+  bool read(std::istream & is) {
+    uint32_t nk, nlev;
+    if(!BinaryIO::get(is, nk) || !BinaryIO::get(is, n) ||
+       !BinaryIO::get(is, min_val) || !BinaryIO::get(is, max_val) ||
+       !BinaryIO::get(is, rng) || !BinaryIO::get(is, nlev)) return false;
+    // a level holds 2^h values, so there can't be more than 64
+    if((nk < (uint32_t) MIN_K) || (nlev == 0) || (nlev > 64)) return false;
+    k = nk;
+    levels.assign(nlev, std::vector<double>());
+    num_retained = 0;
+    for(auto & lev: levels) {
+      uint32_t sz;
+      if(!BinaryIO::get(is, sz) || (sz > 64 * (uint32_t) k)) return false;
+      lev.resize(sz);
+      is.read((char *) lev.data(), sz * sizeof(double));
+      if(is.fail()) return false;
+      num_retained += sz;
+    }
+    max_retained = 0;
+    for(size_t h = 0; h < levels.size(); h++) max_retained += capacity(h);
+    return true;
+  }
+
+private:
+  // MIN_WIDTH: no level is ever smaller than this
+  enum { MIN_K = 8, MIN_WIDTH = 8 };
+
+  // the top level holds k values, each level below 2/3 as many
+  size_t capacity(size_t h) const {
+    double depth = (double) (levels.size() - 1 - h);
+    size_t c = (size_t) ceil(((double) k) * pow(2.0 / 3.0, depth));
+    return (c < (size_t) MIN_WIDTH) ? (size_t) MIN_WIDTH : c;
+  }
+
+  void addLevel() {
+    levels.push_back(std::vector<double>());
+    max_retained = 0;
+    for(size_t h = 0; h < levels.size(); h++) max_retained += capacity(h);
+  }
+
+  bool coinFlip() {
+    // xorshift64
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (rng & 1) != 0;
+  }
+
+  // compact the lowest level that is over its capacity
+  void compress() {
+    for(size_t h = 0; h < levels.size(); h++) {
+      if(levels[h].size() < capacity(h)) continue;
+      if((h + 1) == levels.size()) addLevel();
+
+      std::vector<double> & lev = levels[h];
+      std::sort(lev.begin(), lev.end());
+      // with an odd count, the smallest value stays where it is
+      size_t start = lev.size() & 1;
+      size_t offset = coinFlip() ? 1 : 0;
+      std::vector<double> & up = levels[h + 1];
+      for(size_t i = start + offset; i < lev.size(); i += 2) up.push_back(lev[i]);
+      size_t moved = (lev.size() - start) / 2;
+      lev.resize(start);
+      num_retained -= moved;
+      return;
+    }
+  }
+
+  int k;
+  std::vector<std::vector<double> > levels;
+  size_t num_retained;
+  size_t max_retained;
+  uint64_t n;
+  double min_val, max_val;
+  uint64_t rng;
+};
+#endif
@@ -0,0 +1,280 @@
+#include "Resample.hxx"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cmath>
+
+// log(k!) - the first terms of Stirling's series, for BTRS
+static double stirlingTail(uint64_t k)
+{
+  static const double small[] = {
+    0.08106146679532726, 0.04134069595540929, 0.02767792568499834,
+    0.02079067210376509, 0.01664469118982119, 0.01387612882307075,
+    0.01189670994589177, 0.01041126526197209, 0.009255462182712733,
+    0.008330563433362871
+  };
+  if(k <= 9) return small[k];
+  double kp1 = ((double) k) + 1.0;
+  double kp1sq = kp1 * kp1;
+  return (1.0 / 12.0 - (1.0 / 360.0 - 1.0 / 1260.0 / kp1sq) / kp1sq) / kp1;
+}
+
+uint64_t Resample::binomial(Philox & rng, uint64_t n, double p)
+{
+  if((n == 0) || (p <= 0.0)) return 0;
+  if(p >= 1.0) return n;
+  // work with p <= 1/2 and flip the answer
+  if(p > 0.5) return n - binomial(rng, n, 1.0 - p);
+
+  const double dn = (double) n;
+  const double q = 1.0 - p;
+
+  if((dn * p) < 10.0) {
+    // inversion: walk up the pmf from 0
+    double s = p / q;
+    double a = (dn + 1.0) * s;
+    double r = pow(q, dn);
+    double u = rng.uniform();
+    uint64_t x = 0;
+    while((u > r) && (x < n)) {
+      u -= r;
+      x++;
+      r *= (a / ((double) x)) - s;
+    }
+    return x;
+  }
+
+  // BTRS: transformed rejection with squeeze (Hormann, "The generation
+  // of binomial random variates", 1993)
+  const double spq = sqrt(dn * p * q);
+  const double b = 1.15 + 2.53 * spq;
+  const double a = -0.0873 + 0.0248 * b + 0.01 * p;
+  const double c = dn * p + 0.5;
+  const double v_r = 0.92 - 4.2 / b;
+  const double r = p / q;
+  const double alpha = (2.83 + 5.1 / b) * spq;
+  const double m = floor((dn + 1.0) * p);
+  const uint64_t im = (uint64_t) m;
+
+  for(;;) {
+    double u = rng.uniform() - 0.5;
+    double v = rng.uniform();
+    double us = 0.5 - fabs(u);
+    double fk = floor((2.0 * a / us + b) * u + c);
+    if((fk < 0.0) || (fk > dn)) continue;
+    if((us >= 0.07) && (v <= v_r)) return (uint64_t) fk;
+
+    uint64_t k = (uint64_t) fk;
+    v = log(v * alpha / (a / (us * us) + b));
+    double bound = (m + 0.5) * log((m + 1.0) / (r * (dn - m + 1.0)))
+      + (dn + 1.0) * log((dn - m + 1.0) / (dn - fk + 1.0))
+      + (fk + 0.5) * log(r * (dn - fk + 1.0) / (fk + 1.0))
+      + stirlingTail(im) + stirlingTail(n - im) - stirlingTail(k) - stirlingTail(n - k);
+    if(v <= bound) return k;
+  }
+}
+
+void Resample::multinomial(Philox & rng, const Counts & weights, uint64_t n, Counts & res)
+{
+  res.assign(weights.size(), 0);
+  uint64_t rem_w = 0;
+  for(auto w: weights) rem_w += w;
+
+  // one binomial per bucket: of the items left, how many land here,
+  // given they didn't land in any bucket before this one
+  uint64_t rem_n = n;
+  for(size_t i = 0; (i < weights.size()) && (rem_n > 0); i++) {
+    if(weights[i] == 0) continue;
+    if(weights[i] >= rem_w) {
+      res[i] = rem_n;
+      break;
+    }
+    uint64_t x = binomial(rng, rem_n, ((double) weights[i]) / ((double) rem_w));
+    res[i] = x;
+    rem_n -= x;
+    rem_w -= weights[i];
+  }
+}
+
+double Resample::chiSquared(const Counts & S, const Counts & X)
+{
+  uint64_t ns = 0, nx = 0;
+  for(size_t i = 0; i < S.size(); i++) {
+    ns += S[i];
+    nx += X[i];
+  }
+  if((ns == 0) || (nx == 0)) return 0.0;
+  double fs = ((double) ns) / ((double) (ns + nx));
+  double fx = 1.0 - fs;
+
+  double X2 = 0.0;
+  for(size_t i = 0; i < S.size(); i++) {
+    double t = (double) (S[i] + X[i]);
+    if(t == 0.0) continue;
+    double es = t * fs;
+    double ex = t * fx;
+    double ds = ((double) S[i]) - es;
+    double dx = ((double) X[i]) - ex;
+    X2 += (ds * ds) / es + (dx * dx) / ex;
+  }
+  return X2;
+}
+
+// Threads that outlive a call.  run(n, job) does job(w) for w in
+// [0, n), job(0) on the calling thread, and returns when all are
+// done.  The pool only grows; one run at a time.
+class WorkerPool {
+public:
+  static WorkerPool & get() {
+    static WorkerPool pool;
+    return pool;
+  }
+
+  void run(int n, const std::function<void (int)> & job) {
+    if(n <= 1) {
+      job(0);
+      return;
+    }
+    std::lock_guard<std::mutex> run_lock(run_mutex);
+    {
+      std::lock_guard<std::mutex> lk(mutex);
+      while((int) (threads.size() + 1) < n) {
+	threads.push_back(std::thread(&WorkerPool::loop, this, (int) (threads.size() + 1), generation));
+      }
+      cur_job = &job;
+      cur_n = n;
+      pending = n - 1;
+      generation++;
+    }
+    start_cv.notify_all();
+    job(0);
+    std::unique_lock<std::mutex> lk(mutex);
+    done_cv.wait(lk, [this] { return pending == 0; });
+    cur_job = nullptr;
+  }
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lk(mutex);
+      stopping = true;
+    }
+    start_cv.notify_all();
+    for(auto & t: threads) t.join();
+  }
+
+private:
+  WorkerPool() {
+    cur_job = nullptr;
+    cur_n = 0;
+    pending = 0;
+    generation = 0;
+    stopping = false;
+  }
+
+  void loop(int w, unsigned long seen) {
+    std::unique_lock<std::mutex> lk(mutex);
+    for(;;) {
+      start_cv.wait(lk, [&] { return stopping || (generation != seen); });
+      if(stopping) return;
+      seen = generation;
+      // a pool bigger than this run sits it out
+      if(w >= cur_n) continue;
+      const std::function<void (int)> * job = cur_job;
+      lk.unlock();
+      (*job)(w);
+      lk.lock();
+      if(--pending == 0) done_cv.notify_one();
+    }
+  }
+
+  std::mutex run_mutex, mutex;
+  std::condition_variable start_cv, done_cv;
+  std::vector<std::thread> threads;
+  const std::function<void (int)> * cur_job;
+  int cur_n, pending;
+  unsigned long generation;
+  bool stopping;
+};
+
+// run resamples [0, n) on num_threads threads.  draw(rng, S, X) makes
+// one resampled pair.
+static void runResamples(Resample::Statistic stat, int resamples, uint64_t seed, int num_threads,
+			 std::function<void (Philox &, Resample::Counts &, Resample::Counts &)> draw,
+			 std::vector<double> & samples)
+{
+  samples.assign(resamples, 0.0);
+  if(num_threads < 1) num_threads = 1;
+
+  auto worker = [&](int w) {
+    Resample::Counts rs, rx;
+    for(int r = w; r < resamples; r += num_threads) {
+      Philox rng(seed, (uint64_t) r);
+      draw(rng, rs, rx);
+      samples[r] = stat(rs, rx);
+    }
+  };
+
+  WorkerPool::get().run(num_threads, worker);
+}
+
+static uint64_t total(const Resample::Counts & c)
+{
+  uint64_t ret = 0;
+  for(auto v: c) ret += v;
+  return ret;
+}
+
+Resample::Result Resample::nullBootstrap(const Counts & S, const Counts & X, Statistic stat,
+					 int resamples, uint64_t seed, int num_threads)
+{
+  Result res;
+  res.observed = stat(S, X);
+
+  Counts pooled(S.size());
+  for(size_t i = 0; i < S.size(); i++) pooled[i] = S[i] + X[i];
+  uint64_t ns = total(S);
+  uint64_t nx = total(X);
+
+  runResamples(stat, resamples, seed, num_threads,
+	       [&](Philox & rng, Counts & rs, Counts & rx) {
+		 multinomial(rng, pooled, ns, rs);
+		 multinomial(rng, pooled, nx, rx);
+	       }, res.samples);
+
+  uint64_t ge = 0;
+  for(auto v: res.samples) {
+    if(v >= res.observed) ge++;
+  }
+  res.p_value = ((double) (ge + 1)) / ((double) (resamples + 1));
+  res.lo = res.hi = res.observed;
+  return res;
+}
+
+Resample::Result Resample::bootstrap(const Counts & S, const Counts & X, Statistic stat,
+				     int resamples, double conf, uint64_t seed, int num_threads)
+{
+  Result res;
+  res.observed = stat(S, X);
+  res.p_value = 1.0;
+
+  uint64_t ns = total(S);
+  uint64_t nx = total(X);
+
+  runResamples(stat, resamples, seed, num_threads,
+	       [&](Philox & rng, Counts & rs, Counts & rx) {
+		 multinomial(rng, S, ns, rs);
+		 multinomial(rng, X, nx, rx);
+	       }, res.samples);
+
+  res.lo = res.hi = res.observed;
+  if(resamples < 1) return res;
+  std::vector<double> sorted(res.samples);
+  std::sort(sorted.begin(), sorted.end());
+  double tail = 0.5 * (1.0 - conf);
+  size_t lo_idx = (size_t) floor(tail * (resamples - 1));
+  size_t hi_idx = (size_t) ceil((1.0 - tail) * (resamples - 1));
+  res.lo = sorted[lo_idx];
+  res.hi = sorted[std::min(hi_idx, sorted.size() - 1)];
+  return res;
+}
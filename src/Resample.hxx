@@ -0,0 +1,120 @@
+#ifndef RESAMPLE_HDR
+#define RESAMPLE_HDR
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+/// Philox4x32-10, a counter based random number generator (Salmon,
+/// Moraes, Dror, and Shaw, "Parallel Random Numbers: As Easy as
+/// 1, 2, 3", 2011).  Each number is a function of (key, counter), so
+/// resample r of a run with seed s always gets the same stream no
+/// matter which thread draws it or in what order.  Usable as a
+/// UniformRandomBitGenerator with the <random> distributions.
+/// Not cryptographic.
+class Philox {
+public:
+  typedef uint32_t result_type;
+
+  Philox(uint64_t seed, uint64_t stream) {
+    key[0] = (uint32_t) seed;
+    key[1] = (uint32_t) (seed >> 32);
+    ctr[0] = 0;
+    ctr[1] = 0;
+    ctr[2] = (uint32_t) stream;
+    ctr[3] = (uint32_t) (stream >> 32);
+    next = 4;
+  }
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return 0xffffffff; }
+
+  result_type operator()() {
+    if(next == 4) {
+      block();
+      next = 0;
+    }
+    return out[next++];
+  }
+
+  /// uniform on [0, 1)
+  double uniform() {
+    uint64_t a = (*this)();
+    uint64_t b = (*this)();
+    return ((double) ((a << 21) ^ b)) * (1.0 / 9007199254740992.0);
+  }
+
+private:
+  void block() {
+    uint32_t c[4] = { ctr[0], ctr[1], ctr[2], ctr[3] };
+    uint32_t k[2] = { key[0], key[1] };
+    for(int r = 0; r < 10; r++) {
+      uint64_t p0 = ((uint64_t) 0xD2511F53) * c[0];
+      uint64_t p1 = ((uint64_t) 0xCD9E8D57) * c[2];
+      uint32_t n0 = ((uint32_t) (p1 >> 32)) ^ c[1] ^ k[0];
+      uint32_t n2 = ((uint32_t) (p0 >> 32)) ^ c[3] ^ k[1];
+      c[0] = n0;
+      c[1] = (uint32_t) p1;
+      c[2] = n2;
+      c[3] = (uint32_t) p0;
+      k[0] += 0x9E3779B9;
+      k[1] += 0xBB67AE85;
+    }
+    for(int i = 0; i < 4; i++) out[i] = c[i];
+    // the low 64 bits of the counter count blocks
+    if(++ctr[0] == 0) ctr[1]++;
+  }
+
+  uint32_t key[2];
+  uint32_t ctr[4];
+  uint32_t out[4];
+  int next;
+};
+
+/// Significance and confidence intervals by resampling histograms,
+/// for when the asymptotic tests (ChiSquared::test and friends) can't
+/// be trusted -- sparse buckets, small counts.  The histograms are
+/// bucket counts; a statistic compares a standard S with an
+/// experiment X.  Resamples are dealt out to num_threads threads, and
+/// resample r always uses Philox(seed, r), so the answer depends on
+/// the seed but not on the number of threads.  The worker threads are
+/// started once and kept for later calls, so many small calls (one
+/// per window, say) don't each pay to start and join threads.
+namespace Resample {
+  typedef std::vector<uint64_t> Counts;
+  typedef std::function<double (const Counts & S, const Counts & X)> Statistic;
+
+  class Result {
+  public:
+    double observed;       ///< the statistic for S and X as given
+    double p_value;        ///< nullBootstrap: (1 + #(resampled >= observed)) / (1 + resamples)
+    double lo, hi;         ///< bootstrap: the percentile confidence interval
+    std::vector<double> samples; ///< the statistic for each resample, in resample order
+  };
+
+  /// Null distribution of stat by parametric bootstrap: S and X are
+  /// redrawn (keeping their totals) from the pooled proportions of
+  /// S + X, which is what the two would look like if they came from
+  /// the same distribution.  This is not a permutation test -- the
+  /// draws are multinomial, not a relabelling of the pooled counts --
+  /// but for all but the smallest totals the two agree.
+  Result nullBootstrap(const Counts & S, const Counts & X, Statistic stat,
+		       int resamples, uint64_t seed = 1, int num_threads = 1);
+
+  /// Percentile bootstrap: S and X are each redrawn (keeping their
+  /// totals) from their own proportions.  [lo, hi] covers conf of the
+  /// resampled statistics.
+  Result bootstrap(const Counts & S, const Counts & X, Statistic stat,
+		   int resamples, double conf = 0.95, uint64_t seed = 1, int num_threads = 1);
+
+  /// one draw from binomial(n, p)
+  uint64_t binomial(Philox & rng, uint64_t n, double p);
+
+  /// n items dealt into buckets with probability weights[i] / sum(weights)
+  void multinomial(Philox & rng, const Counts & weights, uint64_t n, Counts & res);
+
+  /// Pearson's X^2 for "S and X come from the same distribution"
+  /// (two sample homogeneity).  Buckets that are empty in both are
+  /// skipped.
+  double chiSquared(const Counts & S, const Counts & X);
+}
+#endif
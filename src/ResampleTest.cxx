@@ -0,0 +1,133 @@
+#include "Resample.hxx"
+#include <boost/format.hpp>
+#include <boost/math/distributions/binomial.hpp>
+#include <boost/math/distributions/chi_squared.hpp>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+// Checks the Resample samplers: binomial() draws against the exact
+// pmf (both the inversion and the BTRS paths, and the p > 1/2 flip),
+// multinomial() totals, and that the answer doesn't depend on the
+// number of threads (or on the thread pool left by an earlier call).
+// The seeds are fixed, so a run either always passes or always fails.
+// Prints what went wrong and exits non-zero if anything did.
+
+static int failures = 0;
+
+static void fail(const std::string & msg)
+{
+  std::cout << "FAIL: " << msg << std::endl;
+  failures++;
+}
+
+// chi-squared goodness of fit of draws from binomial(n, p) to its pmf.
+// Neighbouring values are pooled until each cell expects at least 5.
+static void testBinomial(uint64_t n, double p, uint64_t seed)
+{
+  const uint64_t draws = 200000;
+  Philox rng(seed, 0);
+  std::vector<uint64_t> obs(n + 1, 0);
+  for(uint64_t i = 0; i < draws; i++) {
+    uint64_t x = Resample::binomial(rng, n, p);
+    if(x > n) {
+      fail((boost::format("binomial(%d, %g) drew %d") % n % p % x).str());
+      return;
+    }
+    obs[x]++;
+  }
+
+  boost::math::binomial_distribution<double> bd((double) n, p);
+  std::vector<double> co, ce;
+  double o = 0.0, e = 0.0;
+  for(uint64_t k = 0; k <= n; k++) {
+    o += (double) obs[k];
+    e += ((double) draws) * boost::math::pdf(bd, (double) k);
+    if(e >= 5.0) {
+      co.push_back(o);
+      ce.push_back(e);
+      o = e = 0.0;
+    }
+  }
+  // whatever is left over at the top goes in with the last cell
+  if(!co.empty()) {
+    co.back() += o;
+    ce.back() += e;
+  }
+  int cells = (int) co.size();
+  double X2 = 0.0;
+  for(int i = 0; i < cells; i++) {
+    X2 += (co[i] - ce[i]) * (co[i] - ce[i]) / ce[i];
+  }
+  if(cells < 2) {
+    fail((boost::format("binomial(%d, %g): too few cells to test") % n % p).str());
+    return;
+  }
+  boost::math::chi_squared_distribution<double> cs((double) (cells - 1));
+  double pval = boost::math::cdf(boost::math::complement(cs, X2));
+  const char * path = ((((double) n) * std::min(p, 1.0 - p)) < 10.0) ? "inversion" : "BTRS";
+  std::cout << boost::format("binomial(%d, %g) [%s]: X2 = %g on %d df, p = %g\n")
+    % n % p % path % X2 % (cells - 1) % pval;
+  if(pval < 1e-4) {
+    fail((boost::format("binomial(%d, %g) doesn't fit its pmf") % n % p).str());
+  }
+}
+
+static void testMultinomial()
+{
+  Philox rng(7, 0);
+  Resample::Counts w = { 0, 3, 0, 10, 1, 0, 6 };
+  Resample::Counts res;
+  for(uint64_t n: { 0, 1, 17, 1000, 123456 }) {
+    for(int i = 0; i < 100; i++) {
+      Resample::multinomial(rng, w, n, res);
+      uint64_t tot = 0;
+      for(size_t j = 0; j < res.size(); j++) {
+	if((w[j] == 0) && (res[j] != 0)) {
+	  fail((boost::format("multinomial put %d in zero weight bucket %d") % res[j] % j).str());
+	  return;
+	}
+	tot += res[j];
+      }
+      if(tot != n) {
+	fail((boost::format("multinomial dealt %d of %d") % tot % n).str());
+	return;
+      }
+    }
+  }
+  std::cout << "multinomial: totals and empty buckets hold\n";
+}
+
+static void testThreads()
+{
+  Resample::Counts S = { 10, 40, 80, 40, 10, 2 };
+  Resample::Counts X = { 5, 20, 50, 30, 20, 5 };
+  Resample::Result one = Resample::nullBootstrap(S, X, Resample::chiSquared, 500, 99, 1);
+  Resample::Result four = Resample::nullBootstrap(S, X, Resample::chiSquared, 500, 99, 4);
+  // the pool is bigger than this run needs now
+  Resample::Result two = Resample::nullBootstrap(S, X, Resample::chiSquared, 500, 99, 2);
+  if((one.samples != four.samples) || (one.samples != two.samples) || (one.p_value != four.p_value)) {
+    fail("nullBootstrap gives a different answer on 2 or 4 threads than on 1");
+    return;
+  }
+  std::cout << boost::format("nullBootstrap: same %d resamples on 1, 2, and 4 threads\n") % one.samples.size();
+}
+
+int main()
+{
+  // n * p < 10 takes the inversion path, the rest BTRS
+  testBinomial(20, 0.1, 1);
+  testBinomial(50, 0.19, 2);
+  testBinomial(1, 0.3, 3);
+  testBinomial(60, 0.2, 4);
+  testBinomial(100, 0.5, 5);
+  testBinomial(1000, 0.3, 6);
+  testBinomial(1000000, 0.001, 7);
+  // p > 1/2 is drawn as n - binomial(n, 1 - p)
+  testBinomial(7, 0.7, 8);
+  testBinomial(500, 0.9, 9);
+  testMultinomial();
+  testThreads();
+  if(failures) exit(-1);
+  std::cout << "OK\n";
+}
@@ -1,3 +1,4 @@
+#include "CountHistogram.hxx"
 
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
@@ -16,8 +17,8 @@ int main(int argc, char * argv[])
   po::options_description desc("Options:");
   desc.add_options()
     ("help", "help message")
-    ("standard", po::value<std::string>(&S_fname)->required(), "Histogram file for null hypothesis")
-    ("experiment", po::value<std::string>(&X_fname)->required(), "Histogram file for experimental result")
+    ("standard", po::value<std::string>(&S_fname)->required(), "Histogram for null hypothesis (text or binary histogram file, or partial_file:table[:row])")
+    ("experiment", po::value<std::string>(&X_fname)->required(), "Histogram for experimental result (same forms as standard)")
     ("out", po::value<std::string>(&out_fname)->required(), "Output file to contain PDF, CDF, pdf(X)/pdf(S)");
 
   
@@ -55,25 +56,18 @@ int main(int argc, char * argv[])
     exit(-1);        
   }
 
-  std::ifstream Sst(S_fname); 
-  std::ifstream Xst(X_fname); 
+  CountHistogram Sh, Xh; 
+  if(!Sh.read(S_fname) || !Xh.read(X_fname) || !Sh.conform(Xh, S_fname, X_fname)) exit(-1);
   
-  std::vector<int> S; 
-  std::vector<int> X; 
-  
-  for(int n; Sst >> n; ) {
-    S.push_back(n); 
-  }
-  for(int n; Xst >> n; ) {
-    X.push_back(n); 
-  }
+  std::vector<uint64_t> & S = Sh.counts; 
+  std::vector<uint64_t> & X = Xh.counts; 
 
 
   std::ofstream out(out_fname); 
   
-  int x_sum, s_sum; 
+  uint64_t x_sum, s_sum; 
   x_sum = s_sum = 0; 
-  int i; 
+  size_t i; 
   for(i = 0; i < S.size(); i++) {
     s_sum += S[i];
     x_sum += X[i]; 
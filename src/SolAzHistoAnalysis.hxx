@@ -0,0 +1,81 @@
+#ifndef SOLAZHISTO_ANALYSIS_HDR
+#define SOLAZHISTO_ANALYSIS_HDR
+#include "WSPRLogAnalysis.hxx"
+#include "SolarTime.hxx"
+#include "TimeCorr.hxx"
+#include "DenseHistogram.hxx"
+#include <boost/format.hpp>
+#include <string>
+#include <iostream>
+#include <fstream>
+
+// WSPRLogSolAzHisto: reports by solar time at the path midpoint and
+// azimuth.  10 minute time buckets, 5 degree azimuth segments
+class SolAzHistoAnalysis : public WSPRLogAnalysis {
+public:
+  typedef HistoAxis<(24 * 10), 0, 1, 6> TimeAxis; 
+  typedef HistoAxis<(360 / 5), 0, 5> AzAxis; 
+
+  SolAzHistoAnalysis() {
+    skipped = 0; 
+  }
+
+  static WSPRLogAnalysis * make(const WSPRLogAnalysisArgs &) { return new SolAzHistoAnalysis(); }
+
+  // reads the entry members directly
+  bool lazyDecodeOK() const { return false; }
+
+  WSPRLogAccumulator * clone() const { return new SolAzHistoAnalysis(); }
+
+  void merge(const WSPRLogAccumulator & other) {
+    const SolAzHistoAnalysis & o = static_cast<const SolAzHistoAnalysis &>(other); 
+    histo.merge(o.histo); 
+    skipped += o.skipped; 
+  }
+
+  void add(WSPRLogEntry * ent) {
+    // the midpoint needs both ends
+    float tx_hour, rx_hour; 
+    if(!sol_cache.getFHour(ent->dtime, ent->txgrid, tx_hour) ||
+       !sol_cache.getFHour(ent->dtime, ent->rxgrid, rx_hour)) {
+      skipped++; 
+      return; 
+    }
+    float mid_hour = TimeCorr::circularMean(24.0, tx_hour, rx_hour);
+    bump(mid_hour, ent->az); 
+  }
+
+  void bump(float t_hour, float az) {
+    histo.add((double) t_hour, (double) az); 
+  }
+
+  void writeReport(const std::string & out_name) {
+    std::ofstream os(out_name);    
+    float rscale = 1.0 / ((float) histo.total()); 
+
+    for(int tbucket = 0; tbucket < TimeAxis::BINS; tbucket++) {
+      for(int azbucket = 0; azbucket < AzAxis::BINS; azbucket++) {
+	float val = (float) histo.at(tbucket, azbucket); 
+	val = val * rscale; 
+	os << boost::format("%d %d %f\n")
+	  % (tbucket * 10) % (azbucket * 5) % val; 
+      }
+    }
+    os.close();
+  }
+
+  void report(const std::string & out) {
+    writeReport(out); 
+    if(skipped) {
+      std::cerr << boost::format("Skipped %d spots with a malformed rx or tx grid\n") % skipped; 
+    }
+  }
+
+private:
+  SolarTimeCache sol_cache; 
+  DenseHistogram<TimeAxis, AzAxis> histo; 
+  // spots with a grid that didn't decode
+  uint64_t skipped; 
+};
+
+#endif
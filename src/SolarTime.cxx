@@ -1,9 +1,12 @@
 // Calculate solar time from UTC and longitude
 #include "SolarTime.hxx"
+#include "Maidenhead.hxx"
 
 // Solar time calculation from https://www.esrl.noaa.gov/gmd/grad/solcalc/solareqns.PDF
 #include <cmath>
-#include <ctype.h>
+#include <vector>
+
+static const long SECONDS_PER_DAY = 24 * 3600; 
 
 SolarTime::SolarTime(long epoch_time, double longitude)
 {
@@ -12,49 +15,306 @@ SolarTime::SolarTime(long epoch_time, double longitude)
 
 SolarTime::SolarTime(long epoch_time, const std::string & grid)
 {
-  double longitude; 
-  char d1 = grid[0]; 
-  char d2 = grid[2];
-  int d1_steps = (int) (toupper(d1) - 'J'); // approximately.. GMT
-  int d2_steps = (int) (d2 - '0');
-  int d3_steps = 0; 
-  if(grid.length() > 4) {
-    char d3 = grid[4];       
-    d3_steps = (int) (toupper(d3) - 'A'); 
-  }
+  double lon; 
+  gridLongitude(grid, lon); 
+  init(epoch_time, lon); 
+}
 
-  longitude = 20.0 * ((float) d1_steps) + 2.0 * ((float) d2_steps)
-    + ((float) d3_steps) / 12.0; 
+bool SolarTime::gridLongitude(const std::string & grid, double & lon)
+{
+  const Maidenhead::LatLon & ll = Maidenhead::threadCache().lookup(grid); 
+  lon = ll.lon; 
+  return ll.valid; 
+}
 
-  init(epoch_time, longitude); 
+void SolarTime::splitTime(long solar_epoch_time, int & hour, int & min)
+{
+  long secs = solar_epoch_time - floorDiv(solar_epoch_time, SECONDS_PER_DAY) * SECONDS_PER_DAY; 
+  hour = (int) (secs / 3600); 
+  min = (int) ((secs % 3600) / 60); 
 }
 
+void SolarTime::civilFromDays(long days, int & year, int & month, int & day)
+{
+  days += 719468; 
+  long era = floorDiv(days, 146097); 
+  long doe = days - era * 146097;                                 // [0, 146096]
+  long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365; // [0, 399]
+  long y = yoe + era * 400; 
+  long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);             // [0, 365]
+  long mp = (5 * doy + 2) / 153;                                  // [0, 11]
+  day = (int) (doy - (153 * mp + 2) / 5 + 1);                     // [1, 31]
+  month = (int) ((mp < 10) ? (mp + 3) : (mp - 9));                // [1, 12]
+  year = (int) ((month <= 2) ? (y + 1) : y); 
+}
 
+long SolarTime::daysFromCivil(int year, int month, int day)
+{
+  long y = (month <= 2) ? (year - 1) : year; 
+  long era = floorDiv(y, 400); 
+  long yoe = y - era * 400;                                              // [0, 399]
+  long doy = (153 * ((month > 2) ? (month - 3) : (month + 9)) + 2) / 5 + day - 1; // [0, 365]
+  long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;                      // [0, 146096]
+  return era * 146097 + doe - 719468; 
+}
 
-void SolarTime::init(long epoch_time, double longitude)
+int SolarTime::dayOfYear(long epoch_time)
 {
-  // convert epoch time to UTC
-  gmtime_r(&epoch_time, &utc); 
+  long days = floorDiv(epoch_time, SECONDS_PER_DAY); 
+  int year, month, day; 
+  civilFromDays(days, year, month, day);
+  return (int) (days - daysFromCivil(year, 1, 1)); 
+}
 
-  // calculate fractional year -- gamma
-  double f_day_of_year = (double) utc.tm_yday; 
-  double f_hour = (double) utc.tm_hour;
-  double gamma = (2.0 * M_PI / 365.0) * 
+// fractional year, in radians
+static double fractionalYear(int day_of_year, int hour)
+{
+  double f_day_of_year = (double) day_of_year; 
+  double f_hour = (double) hour;
+  return (2.0 * M_PI / 365.0) * 
     (f_day_of_year - 1.0 + ((f_hour - 12.0)/24.0));
+}
+
+double SolarTime::eqTime(int day_of_year, int hour)
+{
+  double gamma = fractionalYear(day_of_year, hour); 
 
   // estimate "equation of time" in minutes
-  double eqtime = 229.18 * (0.000075
-			  + 0.001868 * cos(gamma)
-			  - 0.032077 * sin(gamma)
-			  - 0.014514 * cos(2.0 * gamma)
-			  - 0.040849 * sin(2.0 * gamma)); 
+  return 229.18 * (0.000075
+		   + 0.001868 * cos(gamma)
+		   - 0.032077 * sin(gamma)
+		   - 0.014514 * cos(2.0 * gamma)
+		   - 0.040849 * sin(2.0 * gamma)); 
+}
 
-  double offset_mins = eqtime + 4.0 * longitude; 
+double SolarTime::declination(int day_of_year, int hour)
+{
+  double gamma = fractionalYear(day_of_year, hour); 
 
-  long offset_seconds = (long) floor(offset_mins * 60.0); 
+  return 0.006918
+    - 0.399912 * cos(gamma)
+    + 0.070257 * sin(gamma)
+    - 0.006758 * cos(2.0 * gamma)
+    + 0.000907 * sin(2.0 * gamma)
+    - 0.002697 * cos(3.0 * gamma)
+    + 0.00148 * sin(3.0 * gamma); 
+}
+
+// the equation of time only changes with the day and hour, so
+// there are just 366 * 24 values we'll ever need. 
+static std::vector<double> buildEqTimeTable()
+{
+  std::vector<double> table(366 * 24); 
+  for(int d = 0; d < 366; d++) {
+    for(int h = 0; h < 24; h++) {
+      table[d * 24 + h] = SolarTime::eqTime(d, h); 
+    }
+  }
+  return table; 
+}
+
+double SolarTime::eqTimeLookup(int day_of_year, int hour)
+{
+  static const std::vector<double> table = buildEqTimeTable(); 
+  return table[day_of_year * 24 + hour]; 
+}
+
+long SolarTime::solarOffset(long epoch_time, double longitude)
+{
+  long secs = epoch_time - floorDiv(epoch_time, SECONDS_PER_DAY) * SECONDS_PER_DAY; 
+  int hour = (int) (secs / 3600); 
+  
+  double offset_mins = eqTimeLookup(dayOfYear(epoch_time), hour) + 4.0 * longitude; 
+
+  return (long) floor(offset_mins * 60.0); 
+}
+
+float SolarTime::solarFHour(long epoch_time, double longitude)
+{
+  int hour, min; 
+  splitTime(epoch_time + solarOffset(epoch_time, longitude), hour, min); 
+  return ((float) hour) + ((float) min) / 60.0; 
+}
+
+void SolarTime::init(long _epoch_time, double longitude)
+{
+  epoch_time = _epoch_time; 
 
   // now setup the solar time... 
-  solar_epoch_time = epoch_time + offset_seconds; 
-  gmtime_r(&solar_epoch_time, &solar); 
+  solar_epoch_time = epoch_time + solarOffset(epoch_time, longitude); 
+  splitTime(solar_epoch_time, solar_hour, solar_min); 
+}
+
+// sin and cos of x for |x| <= pi/2 -- Taylor series to x^13 / x^12.
+// The truncation error is below 6e-8. 
+static inline void sinCosPoly(double x, double & s, double & c)
+{
+  double x2 = x * x; 
+  s = x * (1.0 + x2 * (-1.0 / 6.0 + x2 * (1.0 / 120.0 + x2 * (-1.0 / 5040.0 
+	  + x2 * (1.0 / 362880.0 + x2 * (-1.0 / 39916800.0 + x2 * (1.0 / 6227020800.0))))))); 
+  c = 1.0 + x2 * (-0.5 + x2 * (1.0 / 24.0 + x2 * (-1.0 / 720.0 + x2 * (1.0 / 40320.0
+	  + x2 * (-1.0 / 3628800.0 + x2 * (1.0 / 479001600.0)))))); 
+}
 
+// floor for |x| < 2^31.  Unlike floor() this vectorizes without SSE4.1
+static inline double floorSmall(double x)
+{
+  double t = (double) ((int) x); 
+  return (x < t) ? (t - 1.0) : t; 
+}
+
+void SolarTime::blockFHours(const long * epoch_times, const double * longitudes, 
+			    float * hours, size_t n)
+{
+  std::vector<double> gamma(n), day_secs(n); 
+
+  // the calendar part is integer arithmetic, but all the spots in
+  // a cycle share a timestamp, so it is mostly free. 
+  long last_time = 0; 
+  double last_gamma = 0.0, last_secs = 0.0; 
+  for(size_t i = 0; i < n; i++) {
+    if((i == 0) || (epoch_times[i] != last_time)) {
+      last_time = epoch_times[i]; 
+      long secs = last_time - floorDiv(last_time, SECONDS_PER_DAY) * SECONDS_PER_DAY; 
+      double f_day_of_year = (double) dayOfYear(last_time); 
+      double f_hour = (double) (secs / 3600); 
+      last_gamma = (2.0 * M_PI / 365.0) * 
+	(f_day_of_year - 1.0 + ((f_hour - 12.0)/24.0));
+      last_secs = (double) secs; 
+    }
+    gamma[i] = last_gamma; 
+    day_secs[i] = last_secs; 
+  }
+
+  for(size_t i = 0; i < n; i++) {
+    // gamma is in [-2pi/365, 2pi).  Take sin and cos of the half angle
+    // (about zero) then double it.
+    double h = 0.5 * (gamma[i] - M_PI); 
+    double sh, ch; 
+    sinCosPoly(h, sh, ch); 
+    double sg = -2.0 * sh * ch;          // sin(gamma)
+    double cg = 2.0 * sh * sh - 1.0;     // cos(gamma)
+    double s2g = 2.0 * sg * cg;          // sin(2 gamma)
+    double c2g = 1.0 - 2.0 * sg * sg;    // cos(2 gamma)
+
+    double eqtime = 229.18 * (0.000075
+			      + 0.001868 * cg
+			      - 0.032077 * sg
+			      - 0.014514 * c2g
+			      - 0.040849 * s2g); 
+
+    double offset_mins = eqtime + 4.0 * longitudes[i]; 
+    double secs = day_secs[i] + floorSmall(offset_mins * 60.0); 
+    // back into [0, 1 day)
+    secs = secs - ((double) SECONDS_PER_DAY) * floorSmall(secs / ((double) SECONDS_PER_DAY)); 
+    double hr = floorSmall(secs / 3600.0); 
+    double min = floorSmall((secs - 3600.0 * hr) / 60.0); 
+    hours[i] = (float) (hr + min / 60.0); 
+  }
+}
+
+SolarTimeBlock::SolarTimeBlock(size_t _block_size)
+{
+  block_size = _block_size; 
+  epoch_times.reserve(block_size); 
+  tx_lon.reserve(block_size); 
+  rx_lon.reserve(block_size); 
+  mid_lon.reserve(block_size); 
+}
+
+bool SolarTimeBlock::add(long epoch_time, const std::string & txgrid, const std::string & rxgrid)
+{
+  Maidenhead::GridCache & gc = Maidenhead::threadCache(); 
+  int tx_id = gc.intern(txgrid); 
+  int rx_id = gc.intern(rxgrid); 
+  if(!gc.location(tx_id).valid || !gc.location(rx_id).valid) return false; 
+  epoch_times.push_back(epoch_time); 
+  tx_lon.push_back(gc.location(tx_id).lon); 
+  rx_lon.push_back(gc.location(rx_id).lon);
+  mid_lon.push_back(paths.midpoint(tx_id, rx_id).lon); 
+  return true; 
+}
+
+void SolarTimeBlock::compute()
+{
+  size_t n = epoch_times.size(); 
+  tx_hour.resize(n);
+  rx_hour.resize(n);
+  mid_hour.resize(n); 
+  SolarTime::blockFHours(epoch_times.data(), tx_lon.data(), tx_hour.data(), n); 
+  SolarTime::blockFHours(epoch_times.data(), rx_lon.data(), rx_hour.data(), n); 
+  SolarTime::blockFHours(epoch_times.data(), mid_lon.data(), mid_hour.data(), n); 
+}
+
+void SolarTimeBlock::clear()
+{
+  epoch_times.clear(); 
+  tx_lon.clear(); 
+  rx_lon.clear(); 
+  mid_lon.clear(); 
+}
+
+SolarTimeCache::SolarTimeCache() : table(TABLE_SIZE)
+{
+  for(auto & ent : table) ent.gen = 0; 
+  cur_gen = 0; 
+  num_entries = 0; 
+  // force a new cycle on the first lookup
+  cycle_time = 0; 
+  startCycle(0); 
+}
+
+void SolarTimeCache::startCycle(long epoch_time)
+{
+  cycle_time = epoch_time; 
+  long secs = epoch_time - SolarTime::floorDiv(epoch_time, SECONDS_PER_DAY) * SECONDS_PER_DAY; 
+  cycle_eqtime = SolarTime::eqTimeLookup(SolarTime::dayOfYear(epoch_time), (int) (secs / 3600)); 
+
+  // forget everything from the last cycle
+  cur_gen++; 
+  num_entries = 0; 
+}
+
+float SolarTimeCache::calcFHour(double longitude)
+{
+  // exactly what SolarTime::init does, with the per-cycle part done already
+  double offset_mins = cycle_eqtime + 4.0 * longitude; 
+  long offset_seconds = (long) floor(offset_mins * 60.0); 
+  int hour, min; 
+  SolarTime::splitTime(cycle_time + offset_seconds, hour, min);
+  return ((float) hour) + ((float) min) / 60.0; 
+}
+
+bool SolarTimeCache::getFHour(long epoch_time, const std::string & grid, float & hour)
+{
+  if(epoch_time != cycle_time) startCycle(epoch_time); 
+
+  // grids are (at most) 8 characters -- pack them into the key.
+  // Anything longer isn't a legal locator.
+  uint64_t key; 
+  if(!Maidenhead::packGrid(grid, key)) return false; 
+
+  unsigned int idx = (unsigned int) ((key * 0x9E3779B97F4A7C15ULL) >> 52) & (TABLE_SIZE - 1);
+  while(1) {
+    Entry & ent = table[idx]; 
+    if(ent.gen != cur_gen) {
+      // not here.  remember it, if there is room.
+      double lon; 
+      bool valid = SolarTime::gridLongitude(grid, lon); 
+      hour = valid ? calcFHour(lon) : 0.0; 
+      if(num_entries < MAX_ENTRIES) {
+	ent.key = key; 
+	ent.gen = cur_gen; 
+	ent.hour = hour; 
+	ent.valid = valid; 
+	num_entries++; 
+      }
+      return valid; 
+    }
+    if(ent.key == key) {
+      hour = ent.hour; 
+      return ent.valid; 
+    }
+    idx = (idx + 1) & (TABLE_SIZE - 1); 
+  }
 }
@@ -2,21 +2,149 @@
 #define SOLARTIME_HDR
 #include <time.h>
 #include <string>
+#include <vector>
+#include <cstdint>
+#include "PathGeometry.hxx"
 
 
 class SolarTime { 
 public:
   SolarTime(long epoch_time, double longitude);
+  // a grid that doesn't decode is taken as longitude 0 -- check it
+  // with gridLongitude first
   SolarTime(long epoch_time, const std::string & grid);
 
   void init(long epoch_time, double longitude);    
 
-  int getIHour() { return solar.tm_hour + ((solar.tm_min > 30) ? 1 : 0); }  
-  float getFHour() { return ((float) solar.tm_hour) + ((float) solar.tm_min) / 60.0; }
+  int getIHour() { return solar_hour + ((solar_min > 30) ? 1 : 0); }  
+  float getFHour() { return ((float) solar_hour) + ((float) solar_min) / 60.0; }
 
-  struct tm utc; 
-  struct tm solar;
+  // broken down UTC and solar time, only built when someone asks. 
+  void getUTC(struct tm & utc) { gmtime_r(&epoch_time, &utc); }
+  void getSolar(struct tm & solar) { gmtime_r(&solar_epoch_time, &solar); }
+
+  // the longitude of the centre of a maidenhead grid.  false (and 0)
+  // if the grid doesn't decode.
+  static bool gridLongitude(const std::string & grid, double & lon); 
+
+  // a / b rounded toward minus infinity (b > 0), so times before
+  // the epoch land in the right day
+  static long floorDiv(long a, long b) {
+    long q = a / b; 
+    return ((a % b) < 0) ? (q - 1) : q; 
+  }
+
+  // hour and minute from a solar epoch time
+  static void splitTime(long solar_epoch_time, int & hour, int & min); 
+
+  // solar hour (to the minute, like getFHour) without building a SolarTime
+  static float solarFHour(long epoch_time, double longitude); 
+
+  // offset of solar time from UTC, in seconds
+  static long solarOffset(long epoch_time, double longitude); 
+
+  // equation of time (minutes) for a (0 based) day of the year and UTC hour
+  static double eqTime(int day_of_year, int hour); 
+  // the same thing, from a table built on first use
+  static double eqTimeLookup(int day_of_year, int hour); 
+  // solar declination (radians), from the same NOAA fit
+  static double declination(int day_of_year, int hour); 
+
+  // these replace gmtime_r for the fields we need.
+  // (civil from days from http://howardhinnant.github.io/date_algorithms.html)
+  static void civilFromDays(long days, int & year, int & month, int & day);
+  static long daysFromCivil(int year, int month, int day); 
+  // 0 based, like tm_yday
+  static int dayOfYear(long epoch_time); 
+
+  // Solar hours (to the minute, like getFHour) for a block of spots.
+  // The sin/cos terms of the equation of time come from polynomials,
+  // and the inner loop has no branches or calls, so it vectorizes.
+  // The polynomial equation of time is within 1e-5 minutes of eqTime,
+  // so a block hour can differ from getFHour only when the offset
+  // lands within a fraction of a millisecond of a whole second.  
+  // Then it is one minute off.  (SolarTimeBench counts these -- 
+  // about 1 in a million spots.) 
+  static void blockFHours(const long * epoch_times, const double * longitudes, 
+			  float * hours, size_t n); 
+
+  long epoch_time; 
   long solar_epoch_time; 
+  int solar_hour;
+  int solar_min; 
+}; 
+
+// Collects the timestamp and both ends of the path for a block of
+// spots, then finds the rx, tx, and midpoint solar hours for all
+// of them at once.  The midpoint is the middle of the great-circle
+// path, not the average of the two end times. 
+//
+// The midpoints are remembered by PathGeometry, keyed by this
+// thread's grid ids, so a SolarTimeBlock must stay on one thread. 
+class SolarTimeBlock {
+public:
+  SolarTimeBlock(size_t _block_size = 1024); 
+
+  // returns false, and leaves the block alone, if either grid
+  // doesn't decode
+  bool add(long epoch_time, const std::string & txgrid, const std::string & rxgrid); 
+
+  bool full() const { return epoch_times.size() >= block_size; }
+  size_t size() const { return epoch_times.size(); }
+  bool empty() const { return epoch_times.empty(); }
+
+  // fill in tx_hour, rx_hour, and mid_hour
+  void compute(); 
+
+  void clear(); 
+
+  std::vector<long> epoch_times; 
+  std::vector<double> tx_lon, rx_lon, mid_lon; 
+  std::vector<float> tx_hour, rx_hour, mid_hour; 
+
+private:
+  size_t block_size; 
+  PathGeometry paths; 
+}; 
+
+// All the spots in a WSPR cycle share a timestamp, and many of
+// them share grids.  This does the day-of-year and equation of
+// time work once per cycle, and remembers the solar hour for each
+// grid seen in the current cycle.  The table is emptied (by bumping
+// its generation number) when the timestamp changes. 
+class SolarTimeCache {
+public:
+  SolarTimeCache(); 
+
+  // false if the grid doesn't decode
+  bool getFHour(long epoch_time, const std::string & grid, float & hour); 
+  // for places that aren't grid squares (path midpoints, for instance)
+  float getFHour(long epoch_time, double longitude) {
+    if(epoch_time != cycle_time) startCycle(epoch_time); 
+    return calcFHour(longitude); 
+  }
+
+private:
+  void startCycle(long epoch_time); 
+  float calcFHour(double longitude); 
+
+  static const int TABLE_SIZE = 4096;  // must be a power of 2
+  static const int MAX_ENTRIES = TABLE_SIZE / 2; 
+
+  class Entry {
+  public:
+    uint64_t key;
+    unsigned int gen; 
+    float hour; 
+    bool valid; 
+  }; 
+
+  std::vector<Entry> table; 
+  unsigned int cur_gen; 
+  int num_entries; 
+
+  long cycle_time; 
+  double cycle_eqtime; 
 }; 
 
 #endif
@@ -0,0 +1,152 @@
+#include "SolarTime.hxx"
+#include <boost/format.hpp>
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cmath>
+
+// Check the arithmetic SolarTime against the original gmtime_r
+// version, and report how many spots per second each can handle.
+// (Every spot needs two solar times -- one for each end of the path.)
+
+// the original SolarTime::init
+float refFHour(long epoch_time, double longitude)
+{
+  struct tm utc, solar; 
+  gmtime_r(&epoch_time, &utc); 
+
+  double f_day_of_year = (double) utc.tm_yday; 
+  double f_hour = (double) utc.tm_hour;
+  double gamma = (2.0 * M_PI / 365.0) * 
+    (f_day_of_year - 1.0 + ((f_hour - 12.0)/24.0));
+
+  double eqtime = 229.18 * (0.000075
+			    + 0.001868 * cos(gamma)
+			    - 0.032077 * sin(gamma)
+			    - 0.014514 * cos(2.0 * gamma)
+			    - 0.040849 * sin(2.0 * gamma)); 
+
+  double offset_mins = eqtime + 4.0 * longitude; 
+  long offset_seconds = (long) floor(offset_mins * 60.0); 
+  long solar_epoch_time = epoch_time + offset_seconds; 
+  gmtime_r(&solar_epoch_time, &solar); 
+  return ((float) solar.tm_hour) + ((float) solar.tm_min) / 60.0;
+}
+
+int main(int argc, char * argv[]) {
+  long num_spots = 2000000; 
+  if(argc > 1) num_spots = atol(argv[1]); 
+
+  std::mt19937 gen(1234); 
+  // 2008 through 2030, and a few before the epoch for good measure
+  std::uniform_int_distribution<long> tdist(-86400L * 400, 1900000000L); 
+  std::uniform_real_distribution<double> ldist(-180.0, 180.0); 
+
+  std::vector<long> et(num_spots); 
+  std::vector<double> txlon(num_spots), rxlon(num_spots); 
+  for(long i = 0; i < num_spots; i++) {
+    et[i] = tdist(gen);
+    txlon[i] = ldist(gen);
+    rxlon[i] = ldist(gen); 
+  }
+
+  // first, do they agree? 
+  long mismatches = 0; 
+  for(long i = 0; i < num_spots; i++) {
+    struct tm utc; 
+    time_t t = et[i]; 
+    gmtime_r(&t, &utc); 
+    SolarTime st(et[i], txlon[i]); 
+    if((st.getFHour() != refFHour(et[i], txlon[i])) ||
+       (SolarTime::dayOfYear(et[i]) != utc.tm_yday)) {
+      if(mismatches < 10) {
+	std::cout << boost::format("Mismatch: epoch %ld lon %f new %f ref %f yday %d tm_yday %d\n")
+	  % et[i] % txlon[i] % st.getFHour() % refFHour(et[i], txlon[i])
+	  % SolarTime::dayOfYear(et[i]) % utc.tm_yday; 
+      }
+      mismatches++; 
+    }
+  }
+  std::cout << boost::format("%d spots, %d mismatches\n") % num_spots % mismatches; 
+
+  // now how fast are they? 
+  double sum = 0.0; 
+  auto start = std::chrono::steady_clock::now();
+  for(long i = 0; i < num_spots; i++) {
+    sum += refFHour(et[i], txlon[i]) + refFHour(et[i], rxlon[i]); 
+  }
+  auto mid = std::chrono::steady_clock::now();
+  for(long i = 0; i < num_spots; i++) {
+    SolarTime tx_time(et[i], txlon[i]); 
+    SolarTime rx_time(et[i], rxlon[i]); 
+    sum -= tx_time.getFHour() + rx_time.getFHour(); 
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double ref_secs = std::chrono::duration<double>(mid - start).count(); 
+  double new_secs = std::chrono::duration<double>(end - mid).count(); 
+
+  // the block version
+  std::vector<float> txhr(num_spots), rxhr(num_spots); 
+  auto bstart = std::chrono::steady_clock::now();
+  const long BLOCK = 1024; 
+  for(long i = 0; i < num_spots; i += BLOCK) {
+    long n = ((num_spots - i) < BLOCK) ? (num_spots - i) : BLOCK; 
+    SolarTime::blockFHours(&et[i], &txlon[i], &txhr[i], n); 
+    SolarTime::blockFHours(&et[i], &rxlon[i], &rxhr[i], n); 
+  }
+  auto bend = std::chrono::steady_clock::now();
+  double block_secs = std::chrono::duration<double>(bend - bstart).count(); 
+  long block_mismatches = 0; 
+  float max_diff = 0.0; 
+  for(long i = 0; i < num_spots; i++) {
+    float d = fabs(txhr[i] - SolarTime(et[i], txlon[i]).getFHour()); 
+    // a minute either side of midnight is a minute, not a day
+    if(d > 12.0) d = 24.0 - d; 
+    if(d != 0.0) block_mismatches++; 
+    max_diff = (d > max_diff) ? d : max_diff; 
+  }
+  std::cout << boost::format("block: %d mismatches, max difference %g minutes\n") 
+    % block_mismatches % (max_diff * 60.0); 
+
+  // a more realistic load: a few hundred spots per two minute cycle,
+  // from a few hundred grids. 
+  std::vector<std::string> grids; 
+  for(int i = 0; i < 400; i++) {
+    grids.push_back((boost::format("%c%c%d%d") 
+		     % ((char) ('A' + (i % 18))) % ((char) ('A' + ((i * 7) % 18)))
+		     % (i % 10) % ((i / 10) % 10)).str()); 
+  }
+  std::uniform_int_distribution<int> gdist(0, grids.size() - 1); 
+  std::vector<int> txg(num_spots), rxg(num_spots); 
+  for(long i = 0; i < num_spots; i++) {
+    txg[i] = gdist(gen);
+    rxg[i] = gdist(gen); 
+  }
+  long cycle_start = 1520000040L;
+  auto cstart = std::chrono::steady_clock::now();
+  for(long i = 0; i < num_spots; i++) {
+    long t = cycle_start + 120 * (i / 300); 
+    SolarTime tx_time(t, grids[txg[i]]); 
+    SolarTime rx_time(t, grids[rxg[i]]); 
+    sum += tx_time.getFHour() + rx_time.getFHour(); 
+  }
+  auto cmid = std::chrono::steady_clock::now();
+  SolarTimeCache cache; 
+  for(long i = 0; i < num_spots; i++) {
+    long t = cycle_start + 120 * (i / 300); 
+    float tx_hour, rx_hour; 
+    cache.getFHour(t, grids[txg[i]], tx_hour); 
+    cache.getFHour(t, grids[rxg[i]], rx_hour); 
+    sum -= tx_hour + rx_hour; 
+  }
+  auto cend = std::chrono::steady_clock::now();
+  double grid_secs = std::chrono::duration<double>(cmid - cstart).count(); 
+  double cache_secs = std::chrono::duration<double>(cend - cmid).count(); 
+
+  std::cout << boost::format("gmtime_r:   %g spots/sec\narithmetic: %g spots/sec\nblock:      %g spots/sec\n"
+			     "by grid:    %g spots/sec\ncached:     %g spots/sec\n(checksum %g)\n")
+    % (num_spots / ref_secs) % (num_spots / new_secs) % (num_spots / block_secs)
+    % (num_spots / grid_secs) % (num_spots / cache_secs) % sum; 
+}
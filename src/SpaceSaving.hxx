@@ -0,0 +1,176 @@
+#ifndef SPACESAVING_HDR
+#define SPACESAVING_HDR
+#include "FlatCounter.hxx"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+
+// Heavy hitters in a fixed number of counters: the Space-Saving
+// algorithm (Metwally, Agrawal, and El Abbadi, "Efficient Computation
+// of Frequent and Top-k Elements in Data Streams", 2005).
+//
+// With capacity k, a key that isn't being counted takes over the
+// counter with the smallest count c, starting at c + 1 with error c.
+// So a count is never low, and is high by at most its error, which
+// is at most total()/k.  Any key that really appears more than
+// total()/k times is sure to have a counter.
+//
+// Keys are 64 bit hashes (stableHash) so nothing grows with the number
+// of distinct keys; the name is kept only for the keys being counted.
+class SpaceSaving {
+public:
+  class Entry {
+  public:
+    uint64_t key;
+    std::string name;
+    uint64_t count; // an upper bound
+    uint64_t err;   // count - err is a lower bound
+  };
+
+  SpaceSaving(size_t _capacity = 1000) {
+    capacity = (_capacity < 1) ? 1 : _capacity;
+    total_count = 0;
+  }
+
+  void add(uint64_t key, const std::string & name, uint64_t n = 1) {
+    total_count += n;
+    uint32_t pos1 = index.get(key);
+    if(pos1 != 0) {
+      heap[pos1 - 1].count += n;
+      siftDown(pos1 - 1);
+      return;
+    }
+    if(heap.size() < capacity) {
+      Entry e;
+      e.key = key;
+      e.name = name;
+      e.count = n;
+      e.err = 0;
+      heap.push_back(e);
+      index[key] = heap.size();
+      siftUp(heap.size() - 1);
+      return;
+    }
+    // take over the smallest counter
+    Entry & e = heap[0];
+    index.erase(e.key);
+    e.err = e.count;
+    e.count += n;
+    e.key = key;
+    e.name = name;
+    index[key] = 1;
+    siftDown(0);
+  }
+
+  bool contains(uint64_t key) const { return index.contains(key); }
+
+  // number of items added (not the number of counters)
+  uint64_t total() const { return total_count; }
+  size_t size() const { return heap.size(); }
+  size_t getCapacity() const { return capacity; }
+
+  // no key without a counter can have appeared more often than this
+  uint64_t minCount() const {
+    return (heap.size() < capacity) ? 0 : heap[0].count;
+  }
+
+  // Add in another summary of the same capacity.  A key missing from one
+  // of the summaries might have appeared up to minCount() times there,
+  // so that goes into both its count and its error.  Then the biggest
+  // counts are kept.  The error bound is still total()/capacity.
+  void merge(const SpaceSaving & other) {
+    uint64_t my_min = minCount();
+    uint64_t other_min = other.minCount();
+    std::vector<Entry> all;
+    all.reserve(heap.size() + other.heap.size());
+    for(auto & e: heap) {
+      Entry m = e;
+      uint32_t opos1 = other.index.get(e.key);
+      const uint64_t ocount = (opos1 != 0) ? other.heap[opos1 - 1].count : other_min;
+      const uint64_t oerr = (opos1 != 0) ? other.heap[opos1 - 1].err : other_min;
+      m.count += ocount;
+      m.err += oerr;
+      all.push_back(m);
+    }
+    for(auto & e: other.heap) {
+      if(index.contains(e.key)) continue;
+      Entry m = e;
+      m.count += my_min;
+      m.err += my_min;
+      all.push_back(m);
+    }
+    sortEntries(all);
+    if(all.size() > capacity) all.resize(capacity);
+
+    uint64_t tot = total_count + other.total_count;
+    rebuild(all);
+    total_count = tot;
+  }
+
+  // the counted keys, biggest count first
+  void entries(std::vector<Entry> & res) const {
+    res = heap;
+    sortEntries(res);
+  }
+
+  void clear() {
+    heap.clear();
+    index.clear();
+    total_count = 0;
+  }
+
+private:
+  // biggest first, ties by key so the order doesn't depend on the heap
+  static void sortEntries(std::vector<Entry> & v) {
+    std::sort(v.begin(), v.end(), [](const Entry & a, const Entry & b) {
+	return (a.count != b.count) ? (a.count > b.count) : (a.key < b.key);
+      });
+  }
+
+  void rebuild(const std::vector<Entry> & ents) {
+    clear();
+    // smallest first, so each new entry is already in heap order
+    for(auto it = ents.rbegin(); it != ents.rend(); ++it) {
+      heap.push_back(*it);
+      index[it->key] = heap.size();
+      siftUp(heap.size() - 1);
+    }
+  }
+
+  // the heap is a min heap on count, index maps key to position + 1
+  void swapEntries(size_t a, size_t b) {
+    std::swap(heap[a], heap[b]);
+    index[heap[a].key] = a + 1;
+    index[heap[b].key] = b + 1;
+  }
+
+  void siftUp(size_t i) {
+    while(i > 0) {
+      size_t parent = (i - 1) / 2;
+      if(heap[parent].count <= heap[i].count) break;
+      swapEntries(i, parent);
+      i = parent;
+    }
+  }
+
+  void siftDown(size_t i) {
+    size_t n = heap.size();
+    for(;;) {
+      size_t l = 2 * i + 1;
+      size_t r = l + 1;
+      size_t smallest = i;
+      if((l < n) && (heap[l].count < heap[smallest].count)) smallest = l;
+      if((r < n) && (heap[r].count < heap[smallest].count)) smallest = r;
+      if(smallest == i) break;
+      swapEntries(i, smallest);
+      i = smallest;
+    }
+  }
+
+  size_t capacity;
+  uint64_t total_count;
+  std::vector<Entry> heap;
+  FlatCounter<uint64_t, uint32_t> index;
+};
+#endif
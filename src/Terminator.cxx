@@ -0,0 +1,220 @@
+#include "Terminator.hxx"
+#include "SolarTime.hxx"
+#include "PathGeometry.hxx"
+#include <math.h>
+
+static const long SECONDS_PER_DAY = 24 * 3600; 
+static const double D2R = M_PI / 180.0; 
+// sin(-0.833 degrees)
+static const double HORIZON = -0.014538; 
+
+static inline void unitVector(double lat, double lon, double & x, double & y, double & z)
+{
+  x = cos(lat * D2R) * cos(lon * D2R); 
+  y = cos(lat * D2R) * sin(lon * D2R); 
+  z = sin(lat * D2R); 
+}
+
+Terminator::Terminator()
+{
+  cur_day = 0; 
+  cycle_time = 0; 
+  sun_x = sun_y = sun_z = 0.0; 
+  no_place.state = SunDay::NO_PLACE; 
+  no_place.rise = no_place.set = 0; 
+}
+
+uint64_t Terminator::pairKey(int a, int b)
+{
+  // the same in either direction
+  uint32_t lo = (uint32_t) ((a < b) ? a : b); 
+  uint32_t hi = (uint32_t) ((a < b) ? b : a); 
+  return (((uint64_t) hi) << 32) | lo; 
+}
+
+void Terminator::sunDay(long epoch_time, double lat, double lon, SunDay & sd)
+{
+  long day_start = SolarTime::floorDiv(epoch_time, SECONDS_PER_DAY) * SECONDS_PER_DAY; 
+  int yday = SolarTime::dayOfYear(epoch_time); 
+
+  // take the declination and equation of time at (about) local noon
+  int noon_hour = (int) floor((720.0 - 4.0 * lon) / 60.0); 
+  if(noon_hour < 0) noon_hour = 0; 
+  if(noon_hour > 23) noon_hour = 23; 
+  double eqtime = SolarTime::eqTimeLookup(yday, noon_hour); 
+  double decl = SolarTime::declination(yday, noon_hour); 
+
+  double cos_ha = (HORIZON - sin(lat * D2R) * sin(decl)) / 
+    (cos(lat * D2R) * cos(decl)); 
+
+  if(cos_ha > 1.0) {
+    sd.state = SunDay::ALWAYS_DOWN; 
+    sd.rise = sd.set = day_start; 
+    return; 
+  }
+  if(cos_ha < -1.0) {
+    sd.state = SunDay::ALWAYS_UP; 
+    sd.rise = sd.set = day_start; 
+    return; 
+  }
+
+  double ha = acos(cos_ha) / D2R; 
+  double rise_min = 720.0 - 4.0 * (lon + ha) - eqtime; 
+  double set_min = 720.0 - 4.0 * (lon - ha) - eqtime; 
+  sd.state = SunDay::NORMAL; 
+  sd.rise = day_start + (long) floor(rise_min * 60.0); 
+  sd.set = day_start + (long) floor(set_min * 60.0); 
+}
+
+static float hoursSince(long epoch_time, long event)
+{
+  // rise and set times move a few minutes a day at most, so
+  // today's event stands in for yesterday's
+  long d = epoch_time - event; 
+  d = d - SolarTime::floorDiv(d, SECONDS_PER_DAY) * SECONDS_PER_DAY; 
+  return ((float) d) / 3600.0; 
+}
+
+float Terminator::hoursSinceRise(long epoch_time, const SunDay & sd)
+{
+  if(sd.state != SunDay::NORMAL) return -1.0; 
+  return hoursSince(epoch_time, sd.rise); 
+}
+
+float Terminator::hoursSinceSet(long epoch_time, const SunDay & sd)
+{
+  if(sd.state != SunDay::NORMAL) return -1.0; 
+  return hoursSince(epoch_time, sd.set); 
+}
+
+void Terminator::checkDay(long epoch_time)
+{
+  long day = SolarTime::floorDiv(epoch_time, SECONDS_PER_DAY); 
+  if(day != cur_day) {
+    day_cache.clear(); 
+    cur_day = day; 
+  }
+}
+
+const Terminator::SunDay & Terminator::placeDay(long epoch_time, uint64_t key, 
+						double lat, double lon)
+{
+  auto it = day_cache.find(key); 
+  if(it != day_cache.end()) return it->second; 
+
+  SunDay & sd = day_cache[key]; 
+  sunDay(epoch_time, lat, lon, sd); 
+  return sd; 
+}
+
+const Terminator::SunDay & Terminator::gridDay(long epoch_time, const std::string & grid)
+{
+  checkDay(epoch_time); 
+  Maidenhead::GridCache & gc = Maidenhead::threadCache(); 
+  int id = gc.intern(grid); 
+  const Maidenhead::LatLon & ll = gc.location(id); 
+  if(!ll.valid) return no_place; 
+  return placeDay(epoch_time, (uint64_t) id, ll.lat, ll.lon); 
+}
+
+const Terminator::SunDay & Terminator::midpointDay(long epoch_time, 
+						   const std::string & txgrid, 
+						   const std::string & rxgrid)
+{
+  checkDay(epoch_time); 
+  Maidenhead::GridCache & gc = Maidenhead::threadCache(); 
+  int tx_id = gc.intern(txgrid); 
+  int rx_id = gc.intern(rxgrid); 
+  if(!gc.location(tx_id).valid || !gc.location(rx_id).valid) return no_place; 
+  uint64_t key = pairKey(tx_id, rx_id); 
+
+  auto it = midpoints.find(key); 
+  if(it == midpoints.end()) {
+    Maidenhead::LatLon mid; 
+    PathGeometry::midpoint(gc.location(tx_id), gc.location(rx_id), mid); 
+    it = midpoints.insert(std::make_pair(key, mid)).first; 
+  }
+
+  // grid ids are small, so the top bit keeps midpoints apart from grids
+  return placeDay(epoch_time, key | (1ULL << 63), it->second.lat, it->second.lon); 
+}
+
+int Terminator::pathSamples(int tx_id, int rx_id, uint64_t key)
+{
+  auto it = path_ids.find(key); 
+  if(it != path_ids.end()) return it->second; 
+
+  Maidenhead::GridCache & gc = Maidenhead::threadCache(); 
+  const Maidenhead::LatLon & a = gc.location(tx_id); 
+  const Maidenhead::LatLon & b = gc.location(rx_id); 
+  double ax, ay, az, bx, by, bz; 
+  unitVector(a.lat, a.lon, ax, ay, az); 
+  unitVector(b.lat, b.lon, bx, by, bz); 
+
+  double cos_w = ax * bx + ay * by + az * bz; 
+  if(cos_w > 1.0) cos_w = 1.0; 
+  if(cos_w < -1.0) cos_w = -1.0; 
+  double w = acos(cos_w); 
+  double sin_w = sin(w); 
+
+  int idx = path_points.size(); 
+  for(int i = 0; i < PATH_SAMPLES; i++) {
+    double t = ((double) i) / ((double) (PATH_SAMPLES - 1)); 
+    double fa, fb; 
+    if(sin_w < 1e-9) {
+      // the same place, or antipodes (where any path will do, so
+      // just use the two ends)
+      fa = (t < 0.5) ? 1.0 : 0.0; 
+      fb = 1.0 - fa; 
+    }
+    else {
+      // spherical interpolation
+      fa = sin((1.0 - t) * w) / sin_w; 
+      fb = sin(t * w) / sin_w; 
+    }
+    path_points.push_back(fa * ax + fb * bx); 
+    path_points.push_back(fa * ay + fb * by); 
+    path_points.push_back(fa * az + fb * bz); 
+  }
+
+  path_ids[key] = idx; 
+  return idx; 
+}
+
+float Terminator::darkFraction(long epoch_time, 
+			       const std::string & txgrid, const std::string & rxgrid)
+{
+  if(epoch_time != cycle_time) {
+    // where is the sun overhead?
+    cycle_time = epoch_time; 
+    dark_cache.clear(); 
+
+    long secs = epoch_time - SolarTime::floorDiv(epoch_time, SECONDS_PER_DAY) * SECONDS_PER_DAY; 
+    int hour = (int) (secs / 3600); 
+    int yday = SolarTime::dayOfYear(epoch_time); 
+    double decl = SolarTime::declination(yday, hour); 
+    double eqtime = SolarTime::eqTimeLookup(yday, hour); 
+    double sub_lon = -15.0 * ((((double) secs) / 3600.0) - 12.0 + eqtime / 60.0); 
+    unitVector(decl / D2R, sub_lon, sun_x, sun_y, sun_z); 
+  }
+
+  Maidenhead::GridCache & gc = Maidenhead::threadCache(); 
+  int tx_id = gc.intern(txgrid); 
+  int rx_id = gc.intern(rxgrid); 
+  if(!gc.location(tx_id).valid || !gc.location(rx_id).valid) return -1.0; 
+  uint64_t key = pairKey(tx_id, rx_id); 
+
+  auto it = dark_cache.find(key); 
+  if(it != dark_cache.end()) return it->second; 
+
+  const float * p = &path_points[pathSamples(tx_id, rx_id, key)]; 
+  int dark = 0; 
+  for(int i = 0; i < PATH_SAMPLES; i++, p += 3) {
+    double elev = p[0] * sun_x + p[1] * sun_y + p[2] * sun_z; 
+    if(elev < HORIZON) dark++; 
+  }
+
+  float frac = ((float) dark) / ((float) PATH_SAMPLES); 
+  dark_cache[key] = frac; 
+  return frac; 
+}
@@ -0,0 +1,72 @@
+#ifndef TERMINATOR_HDR
+#define TERMINATOR_HDR
+#include "Maidenhead.hxx"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Sunrise, sunset, and the day/night terminator. 
+// Sunrise and sunset are when the top of the sun crosses the horizon
+// (an elevation of -0.833 degrees, allowing for refraction).
+// 
+// Rise and set times are remembered per place for the current UTC day,
+// and the dark fraction of a path is remembered for the current
+// cycle, so a month of spots costs little more than its distinct
+// grids and paths.  Spots should come in time order (as they do in
+// the wsprnet logs) or the caches won't help much. 
+class Terminator {
+public:
+  Terminator(); 
+
+  class SunDay {
+  public:
+    // NO_PLACE: the grid didn't decode
+    enum State { NORMAL, ALWAYS_UP, ALWAYS_DOWN, NO_PLACE }; 
+    State state; 
+    // epoch times -- these may fall outside the UTC day
+    long rise, set; 
+  }; 
+
+  // rise and set on the UTC day holding epoch_time
+  static void sunDay(long epoch_time, double lat, double lon, SunDay & sd); 
+
+  // hours (0 to 24) since the most recent sunrise or sunset.  Negative
+  // if the sun neither rises nor sets that day, or there is no place. 
+  static float hoursSinceRise(long epoch_time, const SunDay & sd); 
+  static float hoursSinceSet(long epoch_time, const SunDay & sd); 
+
+  const SunDay & gridDay(long epoch_time, const std::string & grid); 
+  // at the great-circle midpoint of the path
+  const SunDay & midpointDay(long epoch_time, 
+			     const std::string & txgrid, const std::string & rxgrid); 
+
+  // fraction (0 to 1) of the great-circle path that is in darkness.
+  // Negative if either grid doesn't decode.
+  float darkFraction(long epoch_time, 
+		     const std::string & txgrid, const std::string & rxgrid); 
+
+  // points along each path
+  static const int PATH_SAMPLES = 17; 
+
+private:
+  void checkDay(long epoch_time); 
+  const SunDay & placeDay(long epoch_time, uint64_t key, double lat, double lon); 
+  int pathSamples(int tx_id, int rx_id, uint64_t key); 
+
+  static uint64_t pairKey(int a, int b); 
+
+  long cur_day; 
+  std::unordered_map<uint64_t, SunDay> day_cache; 
+  SunDay no_place; 
+
+  long cycle_time; 
+  double sun_x, sun_y, sun_z; 
+  std::unordered_map<uint64_t, float> dark_cache; 
+
+  // PATH_SAMPLES unit vectors (x, y, z) per path
+  std::unordered_map<uint64_t, int> path_ids; 
+  std::vector<float> path_points; 
+  std::unordered_map<uint64_t, Maidenhead::LatLon> midpoints; 
+}; 
+#endif
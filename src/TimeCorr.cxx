@@ -1,4 +1,5 @@
 #include "TimeCorr.hxx"
+#include "Maidenhead.hxx"
 #include <string>
 #include <iostream>
 #include <boost/format.hpp>
@@ -8,19 +9,8 @@
 
 // offset from UTC for the specified grid
 float TimeCorr::localTimeOffset(const std::string & grid) {
-  char d1 = grid[0]; 
-  char d2 = grid[2]; 
-
-  float hrs_per_20deg = 20.0 * 12.0 / 180.0; 
-  float fhrs = 0.0; 
-  int d1_steps = (int) (toupper(d1) - 'J'); // approximately.. GMT
-  float mult = (d1_steps < 0) ? -1.0 : 1.0; 
-  int d2_steps = (int) (d2 - '0');
-
-  float fhrs1 = hrs_per_20deg * ((float) d1_steps);   
-  float fhrs2 = 0.1 * hrs_per_20deg * ((float) d2_steps); 
-
-  return fhrs1 + fhrs2; 
+  // 15 degrees per hour
+  return Maidenhead::threadCache().lookup(grid).lon / 15.0; 
 }
 
 float TimeCorr::circularMean(float maxpos, float a, float b)
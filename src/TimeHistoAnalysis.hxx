@@ -0,0 +1,82 @@
+#ifndef TIMEHISTO_ANALYSIS_HDR
+#define TIMEHISTO_ANALYSIS_HDR
+#include "WSPRLogAnalysis.hxx"
+#include "SolarTime.hxx"
+#include "DenseHistogram.hxx"
+#include "WSPRLogPartial.hxx"
+#include <boost/format.hpp>
+#include <string>
+#include <vector>
+#include <iostream>
+
+// WSPRLogTimeHisto: number of reports per solar hour at the rx and at
+// the tx.
+class TimeHistoAnalysis : public WSPRLogAnalysis {
+public:
+  typedef DenseHistogram<HistoAxis<24, 0, 1, 1, HISTO_WRAP> > HourHisto; 
+
+  TimeHistoAnalysis() {
+    skipped[0] = skipped[1] = 0; 
+  }
+
+  static WSPRLogAnalysis * make(const WSPRLogAnalysisArgs &) { return new TimeHistoAnalysis(); }
+
+  WSPRLogAccumulator * clone() const { return new TimeHistoAnalysis(); }
+
+  void merge(const WSPRLogAccumulator & other) {
+    const TimeHistoAnalysis & o = static_cast<const TimeHistoAnalysis &>(other); 
+    rxhisto.merge(o.rxhisto); 
+    txhisto.merge(o.txhisto); 
+    skipped[0] += o.skipped[0]; 
+    skipped[1] += o.skipped[1]; 
+  }
+
+  void add(WSPRLogEntry * ent) {
+    std::string from, to; 
+    unsigned long et; 
+
+    ent->getField(WSPRLogEntry::RXGRID, to);
+    ent->getField(WSPRLogEntry::TXGRID, from);
+    ent->getField(WSPRLogEntry::DTIME, et);
+
+    // calculate the "local time" for to, from, and midpath
+    float tx_hour, rx_hour; 
+    if(sol_cache.getFHour(et, to, rx_hour)) rxhisto.add(rx_hour);
+    else skipped[0]++; 
+    if(sol_cache.getFHour(et, from, tx_hour)) txhisto.add(tx_hour);
+    else skipped[1]++; 
+  }
+
+  // the raw counts, for the report or a partial file
+  void toPartial(WSPRLogPartial & part) {
+    std::vector<uint64_t> & rx = part.dense("rx", { HourHisto::SIZE });
+    std::vector<uint64_t> & tx = part.dense("tx", { HourHisto::SIZE });
+    for(size_t i = 0; i < HourHisto::SIZE; i++) {
+      rx[i] = rxhisto[i];
+      tx[i] = txhisto[i];
+    }
+  }
+
+  // <out>_TH_rx.dat and <out>_TH_tx.dat
+  void report(const std::string & out) {
+    WSPRLogPartial part("TimeHisto"); 
+    toPartial(part); 
+    WSPRLogReport::timeHisto(part, out);
+    reportSkipped(); 
+  }
+
+  void reportSkipped() const {
+    if(skipped[0] || skipped[1]) {
+      std::cerr << boost::format("Skipped %d rx and %d tx grids that were malformed\n")
+	% skipped[0] % skipped[1]; 
+    }
+  }
+
+private:
+  SolarTimeCache sol_cache; 
+  HourHisto rxhisto, txhisto;
+  // rx and tx grids that didn't decode
+  uint64_t skipped[2]; 
+};
+
+#endif
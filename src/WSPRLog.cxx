@@ -11,6 +11,14 @@
 #include <fstream>
 #include <iomanip>
 #include <string>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+#include <ctype.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 
 std::map<std::string, WSPRLogEntry::Field> WSPRLogEntry::field_map;
 boost::format * WSPRLogEntry::fmt = NULL; 
@@ -37,61 +45,204 @@ void WSPRLogEntry::initMaps() {
   field_map["FREQ_DIFF"] = WSPRLogEntry::FREQ_DIFF;
 }
 
-WSPRLogEntry::WSPRLogEntry(const std::string & line)
+// these convert a (trimmed) raw column the way std::stoul and friends
+// would, including the complaint when there is nothing to convert.
+static unsigned long colToUL(const char * st)
 {
-  std::vector<std::string> logent;
-  std::vector<std::string> snrvec;
+  char * ep; 
+  unsigned long ret = strtoul(st, &ep, 10);
+  if(ep == st) throw std::invalid_argument("stoul");
+  return ret; 
+}
+
+static long colToL(const char * st)
+{
+  char * ep; 
+  long ret = strtol(st, &ep, 10);
+  if(ep == st) throw std::invalid_argument("stoi");
+  return ret; 
+}
 
+static float colToF(const char * st)
+{
+  char * ep; 
+  float ret = strtof(st, &ep);
+  if(ep == st) throw std::invalid_argument("stof");
+  return ret; 
+}
+
+static double colToD(const char * st)
+{
+  char * ep; 
+  double ret = strtod(st, &ep);
+  if(ep == st) throw std::invalid_argument("stod");
+  return ret; 
+}
+
+bool WSPRLogEntry::initStatics()
+{
   if(fmt == NULL) {
     fmt = new boost::format("%d,%ld,%s,%s,%4.1f,%4.1f,%12.6f,%s,%s,%3.0f,%3.1f,%6f,%3f,%d,%s,%d,%d\n");  
   }
 
-  // boost tokenizer takes almost twice as long... 
-  size_t end = 0; 
-  size_t start = 0;
-  while(end != std::string::npos) {
-    end = line.find(",", start); 
-    logent.push_back(line.substr(start, (end == std::string::npos) ? std::string::npos : end - start));
-    start = end + 1;
+  initMaps(); 
+  return true; 
+}
+
+WSPRLogEntry::WSPRLogEntry(const std::string & line, bool lazy)
+{
+  // a function static is only initialized once, even across threads
+  static bool statics_ready = initStatics(); 
+  (void) statics_ready; 
+
+  // boost tokenizer takes almost twice as long... and so did
+  // a vector of substrings. 
+  WSPRLogLine ll(line); 
+  num_cols = ll.size();
+  for(int i = 0; i < num_cols; i++) {
+    col_offset[i] = ll.colOffset(i); 
+    col_len[i] = ll.colLength(i); 
   }
 
-  
-  // just in case.  
-  initMaps(); 
+  decoded = 0; 
+  if(lazy) {
+    raw = line; 
+  }
+  else {
+    for(int f = SPOT; f <= MAINSNR; f++) {
+      if((decoded & (1 << f)) == 0) decodeField((Field) f, line.data()); 
+    }
+  }
+}
+
+void WSPRLogEntry::decodeAll()
+{
+  for(int f = SPOT; f <= MAINSNR; f++) {
+    decode((Field) f); 
+  }
+}
 
+void WSPRLogEntry::decodeField(Field sel, const char * base)
+{
   // now use the hints from http://wsprnet.org/drupal/downloads
-  spot_id = std::stoul(logent[0]);
-  dtime = std::stoul(logent[1]);
-  rxcall = boost::algorithm::trim_copy(logent[2]);
-  rxgrid = boost::algorithm::trim_copy(logent[3]);
-  // boost::algorithm::split(snrvec, logent[4], boost::is_any_of("|"));
-  // if(snrvec.size() > 1) {
-  //   snr = std::stof(snrvec[0]);
-  //   main_snr = std::stof(snrvec[1]);            
-  // }
-  // else {
-  snr = std::stof(logent[4]);
-  main_snr = snr; 
-
-  freq = std::stod(logent[5]);
-  txcall = boost::algorithm::trim_copy(logent[6]); 
-  txgrid = boost::algorithm::trim_copy(logent[7]);
+  int col = field2Column(sel); 
+  decoded |= (1 << sel); 
+
+  if(col >= num_cols) {
+    // the code and freq_diff columns are optional
+    if(sel == CODE) code = 0;
+    else if(sel == FREQ_DIFF) freq_diff = 0; 
+    else throw std::out_of_range("WSPRLogEntry: short log line"); 
+    return; 
+  }
+
+  const char * st = base + col_offset[col]; 
+  switch (sel) {
+  case SPOT: spot_id = colToUL(st); break; 
+  case DTIME: dtime = colToUL(st); break; 
+  case RXCALL: rxcall.assign(st, col_len[col]); break; 
+  case RXGRID: rxgrid.assign(st, col_len[col]); break;
+  case SNR:
+  case MAINSNR:
+    snr = colToF(st); 
+    main_snr = snr; 
+    decoded |= (1 << SNR) | (1 << MAINSNR); 
+    break; 
+  case FREQ: freq = colToD(st); break; 
+  case TXCALL: txcall.assign(st, col_len[col]); break; 
+  case TXGRID: txgrid.assign(st, col_len[col]); break; 
+  case POWER: power = colToF(st); break; 
+  case DRIFT: drift = colToF(st); break; 
+  case DIST: dist = colToF(st); break; 
+  case AZ: az = colToF(st); break; 
+  case BAND: band = (int) colToL(st); break; 
+  case VERSION: version.assign(st, col_len[col]); break; 
+  case CODE: code = (int) colToL(st); break; 
+  case FREQ_DIFF: freq_diff = (int) colToL(st); break; 
+  default:
+    break; 
+  }
+}
+
+WSPRLogLine::WSPRLogLine(const std::string & line, int max_cols)
+{
+  base = line.data();
+  size_t len = line.length();
+  size_t pos = 0; 
   
-  power = std::stof(logent[8]);    
+  if(max_cols > MAX_COLUMNS) max_cols = MAX_COLUMNS; 
+
+  num_cols = 0; 
+  while(num_cols < max_cols) {
+    const char * cp = (const char *) memchr(base + pos, ',', len - pos);
+    size_t end = (cp == NULL) ? len : (cp - base); 
+
+    // trim the column, just like the parser does. 
+    size_t s = pos; 
+    size_t e = end; 
+    while((s < e) && isspace(base[s])) s++;
+    while((e > s) && isspace(base[e - 1])) e--; 
+    col_start[num_cols] = s; 
+    col_len[num_cols] = e - s; 
+    num_cols++;
+
+    if(cp == NULL) break; 
+    pos = end + 1; 
+  }
+}
 
-  drift = std::stof(logent[9]);
-  dist = std::stof(logent[10]);
-  az = std::stof(logent[11]);
-  band = std::stoi(logent[12]);
-  version = boost::algorithm::trim_copy(logent[13]); 
-  if(logent.size() > 14) {
-    code = std::stoi(logent[14]);
+bool WSPRLogCallFilter::load(const std::string & fname)
+{
+  std::ifstream inf(fname);
+  if(!inf.good()) {
+    std::cerr << boost::format("Could not open call list [%s] for reading.\n") % fname; 
+    return false; 
   }
-  else code = 0; 
-  if (logent.size() > 15) {
-    freq_diff = std::stoi(logent[15]);
+
+  std::string call; 
+  while(inf >> call) {
+    add(call); 
   }
-  else freq_diff = 0; 
+  inf.close();
+  return true; 
+}
+
+void WSPRLogCallFilter::add(const std::string & call)
+{
+  std::string tc = boost::algorithm::trim_copy(call);
+  if(tc != "") calls.insert(tc);
+}
+
+bool WSPRLogCallFilter::str2Selection(const std::string & str, Selection & _sel)
+{
+  std::string us = boost::algorithm::to_upper_copy(str);
+  if(us == "RX") _sel = RX;
+  else if(us == "TX") _sel = TX;
+  else if(us == "BOTH") _sel = BOTH;
+  else return false;
+  return true; 
+}
+
+bool WSPRLogCallFilter::isExcluded(const std::string & line) const
+{
+  // we don't need to look past the txcall column. 
+  WSPRLogLine ll(line, lastColumn() + 1); 
+  return isExcluded(ll); 
+}
+
+bool WSPRLogCallFilter::isExcluded(const WSPRLogLine & ll) const
+{
+  // calls are short enough that this never touches the heap.
+  std::string call;
+  if((sel & RX) && (ll.size() > WSPRLogLine::RXCALL)) {
+    ll.getColumn(WSPRLogLine::RXCALL, call);
+    if(calls.find(call) != calls.end()) return true; 
+  }
+  if((sel & TX) && (ll.size() > WSPRLogLine::TXCALL)) {
+    ll.getColumn(WSPRLogLine::TXCALL, call);
+    if(calls.find(call) != calls.end()) return true; 
+  }
+  return false; 
 }
 
 WSPRLog::WSPRLog()
@@ -99,13 +250,115 @@ WSPRLog::WSPRLog()
   update_count_interval = 250000;
 
   line_count = 0; 
+  lazy_decode = false; 
+}
+
+bool WSPRLog::addPreFilter(WSPRLogEntry::Field sel, double lo, double hi)
+{
+  int col = WSPRLogEntry::field2Column(sel);
+  switch (sel) {
+  case WSPRLogEntry::VERSION:
+  case WSPRLogEntry::TXCALL:
+  case WSPRLogEntry::RXCALL:
+  case WSPRLogEntry::TXGRID:
+  case WSPRLogEntry::RXGRID:
+  case WSPRLogEntry::UNDEFINED:
+    return false;
+  default:
+    break; 
+  }
+
+  for(auto & pf : pre_filters) {
+    if(pf.column == col) {
+      pf.ranges.push_back(std::pair<double, double>(lo, hi));
+      return true; 
+    }
+  }
+  
+  PreFilter pf;
+  pf.sel = sel; 
+  pf.column = col; 
+  pf.ranges.push_back(std::pair<double, double>(lo, hi));
+  pre_filters.push_back(pf); 
+  return true; 
+}
+
+// convert the raw column the same way the WSPRLogEntry constructor would.
+static double rawValue(const WSPRLogLine & ll, int col, WSPRLogEntry::Field sel)
+{
+  // missing trailing columns are zero.
+  if((col >= ll.size()) || (ll.colLength(col) == 0)) return 0.0; 
+
+  const char * st = ll.colStart(col);
+  switch (sel) {
+  case WSPRLogEntry::FREQ:
+    return strtod(st, NULL);
+  case WSPRLogEntry::SPOT:
+  case WSPRLogEntry::DTIME:
+    return (double) strtoul(st, NULL, 10);
+  case WSPRLogEntry::BAND:
+  case WSPRLogEntry::CODE:
+  case WSPRLogEntry::FREQ_DIFF:
+    return (double) strtol(st, NULL, 10);
+  default:
+    return (double) strtof(st, NULL);
+  }
+}
+
+bool WSPRLog::PreFilter::accepts(const WSPRLogLine & ll) const
+{
+  double v = rawValue(ll, column, sel);
+  for(auto & r : ranges) {
+    if((v >= r.first) && (v <= r.second)) return true; 
+  }
+  return false; 
+}
+
+int WSPRLog::lastFilterColumn() const
+{
+  int ret = call_filter.empty() ? -1 : call_filter.lastColumn(); 
+  for(auto & pf : pre_filters) {
+    ret = (pf.column > ret) ? pf.column : ret; 
+  }
+  return ret; 
+}
+
+bool WSPRLog::acceptLine(const std::string & line) const
+{
+  if(pre_filters.empty() && call_filter.empty()) return true; 
+
+  // split only as far as the filters need to look. 
+  WSPRLogLine ll(line, lastFilterColumn() + 1); 
+
+  for(auto & pf : pre_filters) {
+    if(!pf.accepts(ll)) return false; 
+  }
+
+  return call_filter.empty() || !call_filter.isExcluded(ll);
+}
+
+bool WSPRLog::excludeCalls(const std::string & fname, 
+			   WSPRLogCallFilter::Selection sel)
+{
+  call_filter.setSelection(sel);
+  return call_filter.load(fname); 
 }
 
 void WSPRLog::readLog(std::istream & inf) 
 {
+  std::string linebuf; 
   while(1) {
-    WSPRLogEntry *le = WSPRLogEntry::get(inf);
-    if(le == NULL) break;
+    getline(inf, linebuf); 
+    if(!inf.good()) break; 
+    if(linebuf == "") continue;
+
+    // rejected lines never get parsed.
+    if(!acceptLine(linebuf)) {
+      updateCheck(); 
+      continue; 
+    }
+    
+    WSPRLogEntry *le = new WSPRLogEntry(linebuf, lazy_decode);
     if(isKeeper(le)) {
       if(!processEntry(le)) delete le; 
     }
@@ -120,6 +373,8 @@ void WSPRLog::readLog(std::istream & inf)
 
 std::ostream &  WSPRLogEntry::print(std::ostream & os)
 {
+  decodeAll(); 
+
   std::string ver = version; 
   if(version == "") ver = "UNKNOWN";
 
@@ -167,8 +422,36 @@ WSPRLogEntry::Field WSPRLogEntry::str2Field(const std::string & str)
   else return field_map[str]; 
 }
 
+int WSPRLogEntry::field2Column(WSPRLogEntry::Field sel)
+{
+  switch (sel) {
+  case WSPRLogEntry::SPOT: return WSPRLogLine::SPOT; 
+  case WSPRLogEntry::DTIME: return WSPRLogLine::DTIME; 
+  case WSPRLogEntry::RXCALL: return WSPRLogLine::RXCALL; 
+  case WSPRLogEntry::RXGRID: return WSPRLogLine::RXGRID; 
+  case WSPRLogEntry::SNR: return WSPRLogLine::SNR; 
+  // main_snr is the snr until calcDiff gets called. 
+  case WSPRLogEntry::MAINSNR: return WSPRLogLine::SNR; 
+  case WSPRLogEntry::FREQ: return WSPRLogLine::FREQ; 
+  case WSPRLogEntry::TXCALL: return WSPRLogLine::TXCALL; 
+  case WSPRLogEntry::TXGRID: return WSPRLogLine::TXGRID; 
+  case WSPRLogEntry::POWER: return WSPRLogLine::POWER; 
+  case WSPRLogEntry::DRIFT: return WSPRLogLine::DRIFT; 
+  case WSPRLogEntry::DIST: return WSPRLogLine::DIST; 
+  case WSPRLogEntry::AZ: return WSPRLogLine::AZ; 
+  case WSPRLogEntry::BAND: return WSPRLogLine::BAND; 
+  case WSPRLogEntry::VERSION: return WSPRLogLine::VERSION; 
+  case WSPRLogEntry::CODE: return WSPRLogLine::CODE; 
+  case WSPRLogEntry::FREQ_DIFF: return WSPRLogLine::FREQ_DIFF; 
+  default:
+    return -1; 
+  }
+}
+
 bool WSPRLogEntry::getField(WSPRLogEntry::Field sel, unsigned long & val)
 {
+  if((sel < SPOT) || (sel >= UNDEFINED)) return false; 
+  decode(sel); 
 
   switch (sel) {
   case WSPRLogEntry::SPOT:
@@ -207,6 +490,8 @@ bool WSPRLogEntry::getField(WSPRLogEntry::Field sel, unsigned long & val)
 
 bool WSPRLogEntry::getField(WSPRLogEntry::Field sel, std::string & val)
 {
+  if((sel < SPOT) || (sel >= UNDEFINED)) return false; 
+  decode(sel); 
 
   switch (sel) {
   case WSPRLogEntry::SPOT:
@@ -249,6 +534,8 @@ bool WSPRLogEntry::getField(WSPRLogEntry::Field sel, std::string & val)
 
 bool WSPRLogEntry::getField(WSPRLogEntry::Field sel, double & val)
 {
+  if((sel < SPOT) || (sel >= UNDEFINED)) return false; 
+  decode(sel); 
 
   switch (sel) {
   case WSPRLogEntry::SPOT:
@@ -294,15 +581,41 @@ bool WSPRLogEntry::getField(WSPRLogEntry::Field sel, double & val)
 }
 
 
+bool WSPRLogEntry::getNumber(WSPRLogEntry::Field sel, double & val)
+{
+  if(getField(sel, val)) return true; 
+  // unsigned long first, so big spot ids and times aren't cut to int
+  unsigned long ul; 
+  if(getField(sel, ul)) {
+    val = (double) ul; 
+    return true; 
+  }
+  int iv; 
+  if(getField(sel, iv)) {
+    val = (double) iv; 
+    return true; 
+  }
+  return false; 
+}
+
 bool WSPRLogEntry::getField(WSPRLogEntry::Field sel, int & val)
 {
+  if((sel < SPOT) || (sel >= UNDEFINED)) return false; 
+  decode(sel); 
 
   switch (sel) {
   case WSPRLogEntry::SPOT:
+    val = (int) spot_id; 
+    break; 
   case WSPRLogEntry::BAND:
+    val = band; 
+    break; 
   case WSPRLogEntry::CODE:
+    val = code; 
+    break; 
   case WSPRLogEntry::DTIME:
     val = (int) dtime;
+    break; 
 
   case WSPRLogEntry::VERSION:
   case WSPRLogEntry::TXCALL:
@@ -343,7 +656,8 @@ bool WSPRLogEntry::getField(WSPRLogEntry::Field sel, int & val)
   return true; 
 }
 
-void WSPRLog::readLog(std::string infname, bool is_gzipped)
+template<typename F> 
+void WSPRLog::openLog(const std::string & infname, bool is_gzipped, F reader)
 {
   if(is_gzipped) {
     std::ifstream gzfile(infname, std::ios_base::in | std::ios_base::binary);
@@ -355,7 +669,7 @@ void WSPRLog::readLog(std::string infname, bool is_gzipped)
     inbuf.push(boost::iostreams::gzip_decompressor());
     inbuf.push(gzfile);
     std::istream inf(&inbuf);
-    readLog(inf);
+    reader(inf);
     gzfile.close();
   }
   else {
@@ -363,8 +677,136 @@ void WSPRLog::readLog(std::string infname, bool is_gzipped)
     if(!inf.good()) {
       std::cerr << boost::format("Could not open input file [%s] for reading.\n") % infname; 
     }
-    readLog(inf);
+    reader(inf);
     inf.close();
   }
 }
+
+void WSPRLog::readLog(std::string infname, bool is_gzipped)
+{
+  openLog(infname, is_gzipped, [this](std::istream & inf) { readLog(inf); });
+}
+
+void WSPRLog::readLog(std::string infname, bool is_gzipped, 
+		      WSPRLogAccumulator & acc, int num_threads)
+{
+  openLog(infname, is_gzipped, 
+	  [this, &acc, num_threads](std::istream & inf) { readLog(inf, acc, num_threads); });
+}
+
+void WSPRLog::addLines(const std::vector<std::string> & lines, WSPRLogAccumulator & acc)
+{
+  for(auto & line : lines) {
+    if(!acceptLine(line)) continue; 
+    WSPRLogEntry le(line, lazy_decode); 
+    if(isKeeper(&le)) acc.add(&le); 
+  }
+}
+
+// Blocks of lines waiting for one worker.  The reader stops when
+// a worker falls too far behind.
+class WSPRLogChunkQueue {
+public:
+  WSPRLogChunkQueue() { closed = false; }
+
+  void push(std::vector<std::string> & chunk) {
+    std::unique_lock<std::mutex> lock(mtx); 
+    not_full.wait(lock, [this] { return chunks.size() < MAX_CHUNKS; }); 
+    chunks.push_back(std::vector<std::string>()); 
+    chunks.back().swap(chunk); 
+    not_empty.notify_one(); 
+  }
+
+  // false when the queue is closed and empty
+  bool pop(std::vector<std::string> & chunk) {
+    std::unique_lock<std::mutex> lock(mtx); 
+    not_empty.wait(lock, [this] { return closed || !chunks.empty(); }); 
+    if(chunks.empty()) return false; 
+    chunk.swap(chunks.front()); 
+    chunks.pop_front(); 
+    not_full.notify_one(); 
+    return true; 
+  }
+
+  void close() {
+    std::unique_lock<std::mutex> lock(mtx); 
+    closed = true; 
+    not_empty.notify_one(); 
+  }
+
+private:
+  static const size_t MAX_CHUNKS = 4; 
+  std::mutex mtx; 
+  std::condition_variable not_empty, not_full; 
+  std::deque<std::vector<std::string> > chunks; 
+  bool closed; 
+}; 
+
+void WSPRLog::readLog(std::istream & inf, WSPRLogAccumulator & acc, int num_threads)
+{
+  std::string linebuf; 
+
+  if(num_threads <= 1) {
+    while(1) {
+      getline(inf, linebuf); 
+      if(!inf.good()) break; 
+      if(linebuf == "") continue;
+
+      if(acceptLine(linebuf)) {
+	WSPRLogEntry le(linebuf, lazy_decode);
+	if(isKeeper(&le)) acc.add(&le); 
+      }
+      updateCheck(); 
+    }
+    acc.flush(); 
+    return; 
+  }
+
+  const size_t CHUNK_LINES = 8192; 
+
+  std::vector<WSPRLogAccumulator *> accs(num_threads); 
+  std::vector<WSPRLogChunkQueue> queues(num_threads); 
+  std::vector<std::thread> workers; 
+  for(int i = 0; i < num_threads; i++) {
+    accs[i] = acc.clone(); 
+    workers.push_back(std::thread([this, i, &accs, &queues] {
+	  std::vector<std::string> chunk; 
+	  while(queues[i].pop(chunk)) {
+	    addLines(chunk, *accs[i]); 
+	  }
+	  accs[i]->flush(); 
+	}));
+  }
+
+  // deal the chunks out in turn
+  std::vector<std::string> chunk; 
+  chunk.reserve(CHUNK_LINES); 
+  int next = 0; 
+  while(1) {
+    getline(inf, linebuf); 
+    if(!inf.good()) break; 
+    if(linebuf == "") continue;
+
+    chunk.push_back(linebuf); 
+    updateCheck(); 
+    if(chunk.size() == CHUNK_LINES) {
+      queues[next].push(chunk); 
+      next = (next + 1) % num_threads; 
+      chunk.clear(); 
+      chunk.reserve(CHUNK_LINES); 
+    }
+  }
+  if(!chunk.empty()) queues[next].push(chunk); 
+
+  for(int i = 0; i < num_threads; i++) {
+    queues[i].close(); 
+  }
+
+  for(int i = 0; i < num_threads; i++) {
+    workers[i].join(); 
+    acc.merge(*accs[i]); 
+    delete accs[i]; 
+  }
+  acc.flush(); 
+}
  
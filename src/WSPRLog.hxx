@@ -5,14 +5,83 @@
 #include <string>
 #include <list>
 #include <vector>
+#include <unordered_set>
 #include <iostream>
 #include <boost/format.hpp>
 #include <fstream>
 #include <cmath>
 
+// A raw log line split into (trimmed) columns, without any
+// conversion.  This is cheap enough to use for rejecting lines
+// before they are parsed into a WSPRLogEntry.
+class WSPRLogLine {
+public:
+  static const int MAX_COLUMNS = 16;
+
+  // column numbers in the wsprnet.org csv format
+  enum Column { SPOT = 0, DTIME, RXCALL, RXGRID, SNR, FREQ, TXCALL, TXGRID,
+		POWER, DRIFT, DIST, AZ, BAND, VERSION, CODE, FREQ_DIFF };
+
+  // only split out the first max_cols columns.
+  WSPRLogLine(const std::string & line, int max_cols = MAX_COLUMNS);
+
+  int size() const { return num_cols; }
+
+  const char * colStart(int col) const { return base + col_start[col]; }
+  size_t colOffset(int col) const { return col_start[col]; }
+  size_t colLength(int col) const { return col_len[col]; }
+
+  void getColumn(int col, std::string & str) const {
+    str.assign(base + col_start[col], col_len[col]);
+  }
+
+private:
+  const char * base;
+  int num_cols;
+  size_t col_start[MAX_COLUMNS];
+  size_t col_len[MAX_COLUMNS];
+};
+
+// Exact-match list of callsigns to be dropped from a log.  
+// The test works on the raw line, so an excluded line is never parsed.
+class WSPRLogCallFilter {
+public:
+  enum Selection { RX = 1, TX = 2, BOTH = 3 };
+
+  WSPRLogCallFilter() { sel = BOTH; }
+
+  // read a list of calls, one per line (as written by CallRR | awk)
+  bool load(const std::string & fname);
+
+  void add(const std::string & call);
+
+  void setSelection(Selection _sel) { sel = _sel; }
+
+  static bool str2Selection(const std::string & str, Selection & _sel);
+
+  bool empty() const { return calls.empty(); }
+  size_t size() const { return calls.size(); }
+
+  bool isExcluded(const std::string & line) const;
+  bool isExcluded(const WSPRLogLine & ll) const;
+
+  // the rightmost raw column that isExcluded looks at
+  int lastColumn() const { 
+    return (sel & TX) ? WSPRLogLine::TXCALL : WSPRLogLine::RXCALL; 
+  }
+
+private:
+  Selection sel;
+  std::unordered_set<std::string> calls;
+};
+
 class WSPRLogEntry {
 public: 
-  WSPRLogEntry(const std::string & line); 
+  /// A lazy entry keeps a copy of the line and only converts a field
+  /// the first time getField asks for it.  Code that reads the
+  /// member variables directly (or calls calcDiff or the compare
+  /// functions) must use an eager entry, or call decodeAll first. 
+  WSPRLogEntry(const std::string & line, bool lazy = false); 
   
   unsigned long spot_id; 
   float drift;
@@ -37,6 +106,9 @@ public:
 
   static Field str2Field(const std::string & str); 
 
+  // column of the field in a raw log line, -1 if there isn't one. 
+  static int field2Column(Field sel);
+
   static void printFieldChoices(std::ostream & os) { 
     os << "One of: "; 
     int i = 0; 
@@ -55,6 +127,15 @@ public:
   bool getField(Field sel, double & val); 
   bool getField(Field sel, std::string & val);
   bool getField(Field sel, int & val);   
+  // any numeric field as a double: the double overload, or else the
+  // integer ones (FREQ_DIFF, BAND, DTIME ...).  false for the strings.
+  bool getNumber(Field sel, double & val); 
+
+  void decode(Field sel) {
+    if((decoded & (1 << sel)) == 0) decodeField(sel, raw.data()); 
+  }
+
+  void decodeAll(); 
   
   
   void calcDiff(const WSPRLogEntry * ot) { 
@@ -86,12 +167,45 @@ public:
 
 private:
   static void initMaps(); 
+  // fmt and the field map, set up once even with several reader threads
+  static bool initStatics(); 
   static boost::format * fmt; 
 
+  void decodeField(Field sel, const char * base); 
+
+  // the raw line is only kept for lazy entries.
+  std::string raw; 
+  size_t col_offset[WSPRLogLine::MAX_COLUMNS];
+  size_t col_len[WSPRLogLine::MAX_COLUMNS];
+  int num_cols; 
+  // bit (1 << Field) is set once the field has been converted
+  unsigned int decoded; 
+
   static std::map<std::string, Field> field_map;
 }; 
 
 
+/// Tables and counters built from a log.  WSPRLog::readLog can give
+/// each of several worker threads its own clone, then merge the
+/// clones back into the original.
+class WSPRLogAccumulator {
+public:
+  virtual ~WSPRLogAccumulator() { }
+
+  /// a new accumulator with the same settings and empty tables
+  virtual WSPRLogAccumulator * clone() const = 0; 
+
+  /// count one entry.  The entry still belongs to the reader.
+  virtual void add(WSPRLogEntry * ent) = 0; 
+
+  /// finish anything that is buffered.  Called at the end of each
+  /// log, and on each clone before it is merged. 
+  virtual void flush() { }
+
+  /// add in the tables from a clone of this accumulator
+  virtual void merge(const WSPRLogAccumulator & other) = 0; 
+}; 
+
 class WSPRLog {
 public:
   WSPRLog(); 
@@ -99,10 +213,37 @@ public:
   void readLog(std::istream & in); 
   void readLog(std::string infname, bool is_gzipped = false); 
 
+  /// Feed the log to an accumulator, using num_threads worker threads.
+  /// Blocks of lines are dealt out to the workers in turn, and the
+  /// workers' clones are merged in worker order, so the result does not
+  /// depend on how the threads were scheduled.  isKeeper is called from
+  /// the workers, so it must not change anything. 
+  void readLog(std::istream & in, WSPRLogAccumulator & acc, int num_threads = 1); 
+  void readLog(std::string infname, bool is_gzipped, 
+	       WSPRLogAccumulator & acc, int num_threads = 1); 
+
+  /// drop all lines whose rx and/or tx call is in the list file
+  bool excludeCalls(const std::string & fname, 
+		    WSPRLogCallFilter::Selection sel = WSPRLogCallFilter::BOTH);
+
+  /// cheap range test (lo <= val <= hi) on a raw numeric column, applied
+  /// before the line is parsed.  Ranges on the same field are or'ed
+  /// together, tests on different fields are and'ed.  This is only a
+  /// pre-filter: isKeeper still gets the final say. 
+  bool addPreFilter(WSPRLogEntry::Field sel, double lo, double hi);
+
+  /// cheap tests on the raw line, before it is parsed
+  bool acceptLine(const std::string & line) const;
+
+  /// tools that only look at entries through getField (and print)
+  /// can ask for lazily decoded entries.
+  void setLazyDecode(bool fl) { lazy_decode = fl; }
+
   /// use this for filtering by some property (like a field value)
   virtual bool isKeeper(WSPRLogEntry * ent) { return true; }
 
-  virtual bool processEntry(WSPRLogEntry * ent) = 0; 
+  /// tools that read through an accumulator don't need this.
+  virtual bool processEntry(WSPRLogEntry * ent) { return false; }
 
   virtual void updateCheck() {
     line_count++;
@@ -113,6 +254,27 @@ public:
 private: 
   int update_count_interval; 
   int line_count;
+  bool lazy_decode; 
+
+  WSPRLogCallFilter call_filter; 
+
+  class PreFilter {
+  public:
+    WSPRLogEntry::Field sel; 
+    int column; 
+    std::vector<std::pair<double, double> > ranges; 
+
+    bool accepts(const WSPRLogLine & ll) const; 
+  }; 
+  std::vector<PreFilter> pre_filters; 
+
+  // the rightmost raw column that any line filter looks at
+  int lastFilterColumn() const; 
+
+  // filter, parse, and count a block of lines
+  void addLines(const std::vector<std::string> & lines, WSPRLogAccumulator & acc); 
+
+  template<typename F> void openLog(const std::string & infname, bool is_gzipped, F reader); 
 }; 
 
 #endif
@@ -17,6 +17,7 @@ class myWSPRLog : public WSPRLog {
 public:
   myWSPRLog(double _f_lo, double _f_hi, bool print_header = false) : WSPRLog() {
     last_time = 0; 
+    skipped = 0; 
 
     freq_min = _f_lo; 
     freq_max = _f_hi; 
@@ -30,7 +31,9 @@ public:
   }
 
   void finish() {
-
+    if(skipped) {
+      std::cerr << boost::format("Skipped %d spots with a malformed rx or tx grid\n") % skipped; 
+    }
   }
   
   bool processEntry(WSPRLogEntry * ent) {
@@ -65,14 +68,18 @@ public:
     // prefix the record with the solar time for TX, RX, and midpoint
     // then print the actual record
 
-    SolarTime tx_time(fle->dtime, fle->txgrid);
-    SolarTime rx_time(fle->dtime, fle->rxgrid);    
+    float tx_hour, rx_hour; 
+    if(!sol_cache.getFHour(fle->dtime, fle->txgrid, tx_hour) ||
+       !sol_cache.getFHour(fle->dtime, fle->rxgrid, rx_hour)) {
+      skipped++; 
+      return; 
+    }
     float mid_hour = TimeCorr::circularMean(24.0, 
-					    tx_time.getFHour(), 
-					    rx_time.getFHour());
+					    tx_hour, 
+					    rx_hour);
 
     std::cout << boost::format("%ld,%ld,%ld,")
-      % tx_time.getFHour() % rx_time.getFHour() % mid_hour;
+      % tx_hour % rx_hour % mid_hour;
     
     fle->print(std::cout);
   }
@@ -127,6 +134,9 @@ public:
   }
 
 private:
+  SolarTimeCache sol_cache; 
+  // spots with a grid that didn't decode
+  uint64_t skipped; 
   unsigned long last_time; 
   std::map<std::string, std::list<WSPRLogEntry *> > pair_map;
   double freq_min, freq_max; 
@@ -1,6 +1,8 @@
 #include "WSPRLog.hxx"
 
 #include "SolarTime.hxx"
+#include "PathGeometry.hxx"
+#include "Terminator.hxx"
 #include "TimeCorr.hxx"
 
 #include <boost/format.hpp>
@@ -20,6 +22,7 @@ class myWSPRLog : public WSPRLog {
 public:
   myWSPRLog(const std::string outf_name) : WSPRLog() {
     last_time = 0; 
+    skipped = 0; 
 
     rx_suspect_threshold = 4;
     
@@ -27,7 +30,7 @@ public:
 
     printRHeader();
 
-    fmt = new boost::format("%ld,%6.2f,%6.2f,%6.2f,%f,%f,%3.0f,%3.0f,%3.0f,%4.0f,%6.0f,%s,%s,%s,%s\n");
+    fmt = new boost::format("%ld,%6.2f,%6.2f,%6.2f,%4.2f,%f,%f,%3.0f,%3.0f,%3.0f,%4.0f,%6.0f,%s,%s,%s,%s\n");
 
   }
 
@@ -152,6 +155,7 @@ public:
        << "\"RXSolarTime\", "
        << "\"TXSolarTime\", "
        << "\"MidSolarTime\", "
+       << "\"PathDark\", "
 
        << "\"FreqDiff\", "
        << "\"Freq\", "
@@ -192,18 +196,29 @@ public:
     // don't print entries whose freq_diff is "bad" 
     if(freqDiffIsBad(le)) return;
     // print the log entry in a form suitable for R
-    SolarTime tx_time(le->dtime, le->txgrid);
-    SolarTime rx_time(le->dtime, le->rxgrid);    
-    float mid_hour = TimeCorr::circularMean(24.0, tx_time.getFHour(), rx_time.getFHour()); 
+    float tx_hour, rx_hour; 
+    if(!sol_cache.getFHour(le->dtime, le->txgrid, tx_hour) ||
+       !sol_cache.getFHour(le->dtime, le->rxgrid, rx_hour)) {
+      skipped++; 
+      return; 
+    }
+    float mid_hour = sol_cache.getFHour(le->dtime, paths.midpoint(le->txgrid, le->rxgrid).lon); 
     
     os << *fmt 
-      % le->dtime % rx_time.getFHour() % tx_time.getFHour() % mid_hour
+      % le->dtime % rx_hour % tx_hour % mid_hour
+      % term.darkFraction(le->dtime, le->txgrid, le->rxgrid)
       % le->freq_diff % le->freq % le->snr % le->main_snr 
       % le->power % le->az % le->dist
       % le->rxcall % le->rxgrid % le->txcall % le->txgrid; 
   }
 
+  // spots with a grid that didn't decode
+  uint64_t skipped; 
+
 private:
+  SolarTimeCache sol_cache; 
+  PathGeometry paths; 
+  Terminator term; 
   boost::format * fmt;   
   std::ofstream os; 
   unsigned long last_time; 
@@ -268,4 +283,7 @@ int main(int argc, char * argv[])
   // call processEntry one last time, to see if we've
   // got something stuck in the pipeline. 
   wlog.processEntry(NULL); 
+  if(wlog.skipped) {
+    std::cerr << boost::format("Skipped %d spots with a malformed rx or tx grid\n") % wlog.skipped; 
+  }
 }
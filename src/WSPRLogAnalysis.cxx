@@ -0,0 +1,128 @@
+#include "WSPRLogAnalysis.hxx"
+#include "TimeHistoAnalysis.hxx"
+#include "DiffTimeAnalysis.hxx"
+#include "SolAzHistoAnalysis.hxx"
+#include "GridMapAnalysis.hxx"
+#include "HistoAnalysis.hxx"
+#include <boost/format.hpp>
+
+class RegistryEntry {
+public:
+  std::string help;
+  WSPRLogAnalyses::Factory factory;
+};
+
+typedef std::map<std::string, RegistryEntry> Registry;
+
+// built on first use, so Registrars in other files can run in any order
+static Registry & registry()
+{
+  static Registry reg;
+  static bool init = false;
+  if(!init) {
+    init = true;
+    RegistryEntry e;
+    e.help = "reports by solar hour at rx and tx.  Writes <out>_TH_rx.dat and <out>_TH_tx.dat";
+    e.factory = TimeHistoAnalysis::make;
+    reg["TimeHisto"] = e;
+    e.help = "reports by solar hour and frequency offset.  Writes <out>_FD_T_rx.dat and <out>_FD_T_tx.dat";
+    e.factory = DiffTimeAnalysis::make;
+    reg["DiffTime"] = e;
+    e.help = "reports by midpoint solar time and azimuth";
+    e.factory = SolAzHistoAnalysis::make;
+    reg["SolAzHisto"] = e;
+    e.help = "heat map by grid.  chars=2|4|6 by_band=1 by_hour=1";
+    e.factory = GridMapAnalysis::make;
+    reg["GridMap"] = e;
+    e.help = "histograms of numeric fields.  field=FIELD[:width], as many as you like";
+    e.factory = HistoAnalysis::make;
+    reg["Histo"] = e;
+  }
+  return reg;
+}
+
+void WSPRLogAnalyses::registerAnalysis(const std::string & name, const std::string & help, Factory factory)
+{
+  RegistryEntry e;
+  e.help = help;
+  e.factory = factory;
+  registry()[name] = e;
+}
+
+WSPRLogAnalysis * WSPRLogAnalyses::create(const std::string & name, const WSPRLogAnalysisArgs & args)
+{
+  Registry & reg = registry();
+  auto it = reg.find(name);
+  if(it == reg.end()) {
+    std::cerr << boost::format("There is no analysis called [%s].\n") % name;
+    return NULL;
+  }
+  return it->second.factory(args);
+}
+
+void WSPRLogAnalyses::list(std::ostream & os)
+{
+  for(auto & r: registry()) {
+    os << boost::format("  %-12s %s\n") % r.first % r.second.help;
+  }
+}
+
+std::string WSPRLogAnalyses::getArg(const WSPRLogAnalysisArgs & args, const std::string & name,
+				    const std::string & dflt)
+{
+  auto it = args.find(name);
+  return (it == args.end()) ? dflt : it->second;
+}
+
+WSPRLogAnalysisSet::~WSPRLogAnalysisSet()
+{
+  for(auto an: analyses) delete an;
+}
+
+void WSPRLogAnalysisSet::addAnalysis(WSPRLogAnalysis * an, const std::string & out)
+{
+  analyses.push_back(an);
+  outs.push_back(out);
+}
+
+WSPRLogAccumulator * WSPRLogAnalysisSet::clone() const
+{
+  WSPRLogAnalysisSet * ret = new WSPRLogAnalysisSet;
+  for(size_t i = 0; i < analyses.size(); i++) {
+    ret->addAnalysis(static_cast<WSPRLogAnalysis *>(analyses[i]->clone()), outs[i]);
+  }
+  return ret;
+}
+
+void WSPRLogAnalysisSet::add(WSPRLogEntry * ent)
+{
+  for(auto an: analyses) an->add(ent);
+}
+
+void WSPRLogAnalysisSet::flush()
+{
+  for(auto an: analyses) an->flush();
+}
+
+void WSPRLogAnalysisSet::merge(const WSPRLogAccumulator & other)
+{
+  const WSPRLogAnalysisSet & o = static_cast<const WSPRLogAnalysisSet &>(other);
+  for(size_t i = 0; i < analyses.size(); i++) {
+    analyses[i]->merge(*(o.analyses[i]));
+  }
+}
+
+bool WSPRLogAnalysisSet::lazyDecodeOK() const
+{
+  for(auto an: analyses) {
+    if(!an->lazyDecodeOK()) return false;
+  }
+  return true;
+}
+
+void WSPRLogAnalysisSet::report()
+{
+  for(size_t i = 0; i < analyses.size(); i++) {
+    analyses[i]->report(outs[i]);
+  }
+}
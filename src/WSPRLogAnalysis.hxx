@@ -0,0 +1,85 @@
+#ifndef WSPRLOG_ANALYSIS_HDR
+#define WSPRLOG_ANALYSIS_HDR
+#include "WSPRLog.hxx"
+#include <string>
+#include <map>
+#include <vector>
+#include <iostream>
+
+/// An accumulator that knows how to write its own report.  Each of
+/// the analysis tools (WSPRLogHisto, WSPRLogGridMap...) is built
+/// around one of these, and WSPRLogMulti runs any set of them over a
+/// single read of the log.
+class WSPRLogAnalysis : public WSPRLogAccumulator {
+public:
+  /// write the report.  out is whatever the tool's "out" (or
+  /// "out_base") argument is.
+  virtual void report(const std::string & out) = 0;
+
+  /// false if the analysis reads the entry's members directly, so
+  /// the entries must be fully decoded.
+  virtual bool lazyDecodeOK() const { return true; }
+};
+
+/// settings for an analysis, as name=value pairs.  A name may
+/// appear more than once (WSPRLogHisto's field).
+typedef std::multimap<std::string, std::string> WSPRLogAnalysisArgs;
+
+/// The analyses that WSPRLogMulti knows how to run, by name.  The
+/// ones in this library are always there; a tool can add its own with
+/// registerAnalysis (or a static Registrar) before it calls create.
+namespace WSPRLogAnalyses {
+  /// Makes an analysis from its settings.  On a bad setting, explain
+  /// on cerr and return NULL.
+  typedef WSPRLogAnalysis * (*Factory)(const WSPRLogAnalysisArgs & args);
+
+  void registerAnalysis(const std::string & name, const std::string & help, Factory factory);
+
+  class Registrar {
+  public:
+    Registrar(const std::string & name, const std::string & help, Factory factory) {
+      registerAnalysis(name, help, factory);
+    }
+  };
+
+  /// NULL (and a message) if there is no such analysis or the
+  /// settings are bad.
+  WSPRLogAnalysis * create(const std::string & name, const WSPRLogAnalysisArgs & args);
+
+  /// each analysis's name and help line
+  void list(std::ostream & os);
+
+  /// the value for name, or dflt if it isn't there
+  std::string getArg(const WSPRLogAnalysisArgs & args, const std::string & name,
+		     const std::string & dflt = "");
+}
+
+/// Several analyses fed from one read of the log.  Each worker thread
+/// gets a clone of the whole set.  The set owns the analyses.
+class WSPRLogAnalysisSet : public WSPRLogAccumulator {
+public:
+  WSPRLogAnalysisSet() { }
+  ~WSPRLogAnalysisSet();
+
+  /// the set takes ownership
+  void addAnalysis(WSPRLogAnalysis * an, const std::string & out);
+
+  WSPRLogAccumulator * clone() const;
+  void add(WSPRLogEntry * ent);
+  void flush();
+  void merge(const WSPRLogAccumulator & other);
+
+  bool lazyDecodeOK() const;
+
+  /// each analysis writes its report to its own out
+  void report();
+
+private:
+  WSPRLogAnalysisSet(const WSPRLogAnalysisSet &);
+  WSPRLogAnalysisSet & operator=(const WSPRLogAnalysisSet &);
+
+  std::vector<WSPRLogAnalysis *> analyses;
+  std::vector<std::string> outs;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "WSPRLog.hxx"
+#include "FlatCounter.hxx"
 
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
@@ -9,6 +10,8 @@
 #include <list>
 #include <math.h>
 #include <set>
+#include <vector>
+#include <algorithm>
 
 class myWSPRLog : public WSPRLog {
 public:
@@ -21,6 +24,9 @@ public:
     rx_suspect_threshold = 4;
     
     out.open(outf_name);
+
+    // skip out-of-band lines before they get parsed
+    addPreFilter(WSPRLogEntry::FREQ, f_lo, f_hi); 
   }
 
   bool isKeeper(WSPRLogEntry * ent) {
@@ -55,7 +61,8 @@ public:
   // if anyone ever reports more than 4 image pairs in one cycle, we mark
   // them as "bad"
   void dumpPairs() {
-    std::map<std::string, int> repcounts; 
+    // reports per rx call id
+    FlatCounter<int, int> repcounts; 
 
     for(auto & mapent : pair_map) {
       if(mapent.second.size() > 1) {
@@ -66,10 +73,12 @@ public:
 	fle->main_snr = fle->snr;
 	
 	// remember the reporting station
-	if(repcounts.find(fle->rxcall) == repcounts.end()) repcounts[fle->rxcall] = 1; 
-	else repcounts[fle->rxcall] += 1; 
+	int rx_id = calls.intern(fle->rxcall); 
+	int tx_id = calls.intern(fle->txcall); 
+	uint64_t pair_id = FlatCounter<uint64_t>::packPair(tx_id, rx_id); 
+	repcounts.add(rx_id); 
 
-	addToCount(total_pair_reports, mapent.first);
+	total_pair_reports.add(pair_id);
 
 	// skip reports where every entry is on exactly the same frequency.
 	int printed_count = 0; 
@@ -82,29 +91,20 @@ public:
 	}
 	if(printed_count > 0) {
 	  fle->print(out);
-	  addToCount(img_rx_reports, fle->rxcall, printed_count);
-	  addToCount(img_tx_reports, fle->txcall, printed_count);
-	  addToCount(img_pair_reports, mapent.first, printed_count);
+	  img_rx_reports.add(rx_id, printed_count);
+	  img_tx_reports.add(tx_id, printed_count);
+	  img_pair_reports.add(pair_id, printed_count);
 	}
       }
     }
 
     // now check all the folks in the repcounts map.  record bad guys in 
     // the badguy set. 
-    for(auto & repent : repcounts) {
-      if(repent.second > rx_suspect_threshold) {
-	multi_rx_reporters.insert(repent.first);
-      }
-    }
-  }
-
-  void addToCount(std::map<std::string, int> & reps, const std::string & k, int count = 1) {
-    if(reps.find(k) != reps.end()) {
-      reps[k] += count; 
-    }
-    else {
-      reps[k] = count; 
-    }
+    repcounts.forEach([this](int rx_id, int count) {
+	if(count > rx_suspect_threshold) {
+	  multi_rx_reporters.insert(calls.name(rx_id));
+	}
+      }); 
   }
 
   void clearMap() {
@@ -122,30 +122,45 @@ public:
     std::string key = ent->txcall + "," + ent->rxcall; 
     pair_map[key].push_back(ent); 
     // record the number of reports for each call
-    addToCount(total_rx_reports, ent->rxcall);
-    addToCount(total_tx_reports, ent->txcall);
-    addToCount(total_pair_reports, key);
+    int rx_id = calls.intern(ent->rxcall); 
+    int tx_id = calls.intern(ent->txcall); 
+    total_rx_reports.add(rx_id);
+    total_tx_reports.add(tx_id);
+    total_pair_reports.add(FlatCounter<uint64_t>::packPair(tx_id, rx_id));
   }
 
 
   void dumpReportCounts(const std::string & ofn) {
     std::string bn = boost::filesystem::basename(ofn); 
-    dumpRC(total_rx_reports, img_rx_reports, bn + "_rx.prop");
-    dumpRC(total_tx_reports, img_tx_reports, bn + "_tx.prop");
-    dumpRC(total_pair_reports, img_pair_reports, bn + "_pair.prop");    
+    auto call_name = [this](int id) { return calls.name(id); }; 
+    auto pair_name = [this](uint64_t id) { 
+      return calls.name(FlatCounter<uint64_t>::pairFirst(id)) + "," 
+      + calls.name(FlatCounter<uint64_t>::pairSecond(id)); 
+    }; 
+    dumpRC(total_rx_reports, img_rx_reports, call_name, bn + "_rx.prop");
+    dumpRC(total_tx_reports, img_tx_reports, call_name, bn + "_tx.prop");
+    dumpRC(total_pair_reports, img_pair_reports, pair_name, bn + "_pair.prop");    
   }
 
-  void dumpRC(std::map<std::string, int> & tots,
-	      std::map<std::string, int> & imgs,
+  template<typename K, typename N> 
+  void dumpRC(const FlatCounter<K, int> & tots,
+	      const FlatCounter<K, int> & imgs,
+	      N keyName, 
 	      const std::string & fn) {
+    // sort by name -- the order the report has always been in
+    std::vector<std::pair<std::string, K> > ents; 
+    imgs.forEach([&ents, &keyName](K k, int) { 
+	ents.push_back(std::make_pair(keyName(k), k)); 
+      }); 
+    std::sort(ents.begin(), ents.end()); 
+
     std::ofstream os(fn);
-    for(auto tp: tots) {
-      if(imgs.find(tp.first) != imgs.end()) {
-	int tot = tots[tp.first];
-	int img = imgs[tp.first]; 
-	float prop = ((float) img)/((float) tot);
-	os << tp.first << " " << tot << " " << img << " " << prop << std::endl;
-      }
+    for(auto & ent: ents) {
+      if(!tots.contains(ent.second)) continue; 
+      int tot = tots.get(ent.second);
+      int img = imgs.get(ent.second); 
+      float prop = ((float) img)/((float) tot);
+      os << ent.first << " " << tot << " " << img << " " << prop << std::endl;
     }
     os.close();
   }
@@ -154,8 +169,11 @@ private:
   unsigned long last_time; 
   std::map<std::string, std::list<WSPRLogEntry *> > pair_map; 
 
-  std::map<std::string, int> total_rx_reports, total_tx_reports, total_pair_reports;
-  std::map<std::string, int> img_rx_reports, img_tx_reports, img_pair_reports; 
+  StringInterner calls; 
+  FlatCounter<int, int> total_rx_reports, total_tx_reports; 
+  FlatCounter<int, int> img_rx_reports, img_tx_reports; 
+  // keyed by packed (tx id, rx id)
+  FlatCounter<uint64_t, int> total_pair_reports, img_pair_reports; 
   double f_lo, f_hi; 
   std::set<std::string> multi_rx_reporters; 
   int rx_suspect_threshold; 
@@ -163,7 +181,7 @@ private:
 
 int main(int argc, char * argv[])
 {
-  std::string in_name, out_name, multi_name;
+  std::string in_name, out_name, multi_name, exclude_name;
   double lo_freq, hi_freq; 
   bool input_gzipped; 
   namespace po = boost::program_options;
@@ -177,6 +195,7 @@ int main(int argc, char * argv[])
     ("out", po::value<std::string>(&out_name)->required(), "Filtered output log file (csv) in WSPR log format")
    ("flo", po::value<double>(&lo_freq)->required(), "lower bound of frequency range")
     ("fhi", po::value<double>(&hi_freq)->required(), "upper bound of frequency range")
+    ("exclude", po::value<std::string>(&exclude_name)->default_value(""), "List of calls (one per line) whose reports are dropped")
     ("igz", po::value<bool>(&input_gzipped)->default_value(false), "if true, input file is gzip compressed");
   
   po::positional_options_description pos_opts ;
@@ -212,6 +231,8 @@ int main(int argc, char * argv[])
 
   myWSPRLog wlog(out_name, lo_freq, hi_freq);
 
+  if((exclude_name != "") && !wlog.excludeCalls(exclude_name)) exit(-1);
+
   wlog.readLog(in_name, input_gzipped);
   
   // call processEntry one last time, to see if we've
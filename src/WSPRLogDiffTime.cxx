@@ -1,5 +1,5 @@
 #include "WSPRLog.hxx"
-#include "SolarTime.hxx"
+#include "DiffTimeAnalysis.hxx"
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
 #include <string>
@@ -9,135 +9,10 @@
 #include <math.h>
 #include <set>
 
-// plot distance, "solar time" pairs as histogram
-class myWSPRLog : public WSPRLog {
-public:
-  myWSPRLog(const std::string & out_base_name) : WSPRLog() {
-    osrx.open(out_base_name + "_FD_T_rx.dat");
-    ostx.open(out_base_name + "_FD_T_tx.dat");
-    
-    for(int i = 0; i < 24; i++) {
-      for(int j = 0; j < 200; j++) {
-	rxhisto[i][j] = 0;
-	txhisto[i][j] = 0;
-      }
-    }
-  }
-
-  ~myWSPRLog() {
-  }
-
-  enum SEL { RX, TX };
-
-  bool processEntry(WSPRLogEntry * ent) {
-    std::string from, to; 
-    double ft, tt, ftt; 
-    unsigned long et; 
-    double freq_diff;
-
-    if(ent == NULL) return false; 
-
-    to = ent->rxgrid;
-    from = ent->txgrid; 
-    et = ent->dtime; 
-    freq_diff = ent->freq_diff; 
-
-    // calculate the "local time" for to, from, and midpath
-    SolarTime tx_time(et, from);
-    SolarTime rx_time(et, to);     
-    
-    int ifreq_diff = (int) freq_diff; 
-
-    makeEntry(RX, rx_time.getFHour(), ifreq_diff); 
-    makeEntry(TX, tx_time.getFHour(), ifreq_diff);
-
-    return false; 
-  }
-
-
-  void makeEntry(SEL sel, double hr, int offset) {
-    int off_idx = offset + 100; 
-    if((off_idx < 0) || (off_idx >= 200)) return; 
-
-    int ihr = (int) hr;
-    if(ihr > 23) ihr -= 24;
-
-    if((ihr < 0) || (ihr > 23)) {
-      std::cerr << boost::format("makeEntry got hr = %f ihr = %d offset = %d off_idx = %d\n") % hr % ihr % offset % off_idx;
-      return; 
-    }
-
-    
-    switch (sel) {
-    case RX:
-      rxhisto[ihr][off_idx]++;
-      break;
-    case TX:
-      txhisto[ihr][off_idx]++;
-      break;
-    }
-  }
-
-  void dumpTables() {
-    dumpTable(RX, osrx);
-    dumpTable(TX, ostx);
-
-    osrx.close();
-    ostx.close();
-  }
-
-  void dumpTable(SEL sel, std::ostream & os) {
-    // first find total 
-    long total = 0;
-    long smax = 1; 
-    for(int i = 0; i < 24; i++) {
-      for(int j = 0; j < 200; j++) {
-	int val; 
-	switch (sel) {
-	case RX:
-	  val = rxhisto[i][j];
-	  break;
-	case TX:
-	  val = txhisto[i][j];
-	  break;
-	}
-	total += val; 
-	smax = (smax > val) ? smax : val; 
-      }
-    }
-    
-
-    double ftotal = ((double) total) + 1.0e-6; 
-    double fsmax = ((double) smax); 
-    for(int i = 0; i < 24; i++) {
-      for(int j = 0; j < 200; j++) {
-	int val; 
-	switch (sel) {
-	case RX:
-	  val = rxhisto[i][j];
-	  break;
-	case TX:
-	  val = txhisto[i][j];
-	  break;
-	}
-
-	double fval = ((double) val) / ftotal; 
-	double rmag = ((double) val) / fsmax;
-	os << boost::format("%d %d %f %f\n") % i % (j - 100) % fval % rmag; 
-      }
-      os << std::endl; 
-    }
-  }
-
-private:
-  std::ofstream osrx, ostx;
-  unsigned rxhisto[24][200];
-  unsigned txhisto[24][200];
-}; 
-
 int main(int argc, char * argv[])
 {
   bool input_gzipped; 
+  int num_threads; 
   std::string in_name, out_name; 
   namespace po = boost::program_options;
 
@@ -147,6 +22,7 @@ int main(int argc, char * argv[])
     ("help", "help message")
     ("log", po::value<std::string>(&in_name)->required(), "Input log file (csv) in WSPR log format")
     ("out_base", po::value<std::string>(&out_name)->required(), "Output data file basename")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of worker threads")
     ("igz", po::value<bool>(&input_gzipped)->default_value(false), "if true, input file is gzip compressed");
   
   po::positional_options_description pos_opts ;
@@ -184,9 +60,10 @@ int main(int argc, char * argv[])
 
 
 
-  myWSPRLog wlog(out_name); 
+  WSPRLog wlog; 
+  DiffTimeAnalysis acc; 
 
-  wlog.readLog(in_name, input_gzipped);
+  wlog.readLog(in_name, input_gzipped, acc, num_threads);
   
-  wlog.dumpTables();
+  acc.report(out_name);
 }
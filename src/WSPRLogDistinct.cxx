@@ -0,0 +1,327 @@
+#include "WSPRLog.hxx"
+#include "HyperLogLog.hxx"
+#include "SolarTime.hxx"
+#include "FlatCounter.hxx"
+#include "BinaryIO.hxx"
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+// How many distinct receivers, transmitters, and tx/rx paths were
+// heard in each cell -- band, by UTC or solar hour, and optionally by
+// grid field (or square).  The counts are HyperLogLog estimates, a
+// few KB per cell however many stations there are.  The sketches can
+// be saved and merged with those from other runs.
+
+class myAccumulator : public WSPRLogAccumulator {
+public:
+  enum HourMode { NONE, UTC, SOLAR };
+
+  myAccumulator(HourMode _hour_mode, WSPRLogEntry::Field _grid_sel, int _grid_chars, int _p) {
+    hour_mode = _hour_mode;
+    grid_sel = _grid_sel;
+    grid_chars = _grid_chars;
+    p = _p;
+    skipped = 0;
+  }
+
+  WSPRLogAccumulator * clone() const {
+    return new myAccumulator(hour_mode, grid_sel, grid_chars, p);
+  }
+
+  // distinct counts for one cell
+  class Cell {
+  public:
+    Cell(int p) : rx(p), tx(p), path(p) { spots = 0; }
+
+    bool merge(const Cell & other) {
+      spots += other.spots;
+      return rx.merge(other.rx) && tx.merge(other.tx) && path.merge(other.path);
+    }
+
+    uint64_t spots;
+    HyperLogLog rx, tx, path;
+  };
+
+  void merge(const WSPRLogAccumulator & other) {
+    const myAccumulator & o = static_cast<const myAccumulator &>(other);
+    for(size_t id = 0; id < o.cells.size(); id++) {
+      cell(o.cell_names.name(id)).merge(o.cells[id]);
+    }
+    skipped += o.skipped;
+  }
+
+  void add(WSPRLogEntry * ent) {
+    std::string txcall, rxcall;
+    int band;
+    unsigned long et;
+    ent->getField(WSPRLogEntry::BAND, band);
+    ent->getField(WSPRLogEntry::TXCALL, txcall);
+    ent->getField(WSPRLogEntry::RXCALL, rxcall);
+
+    key = std::to_string(band);
+    if(hour_mode != NONE) {
+      ent->getField(WSPRLogEntry::DTIME, et);
+      int hour;
+      if(hour_mode == UTC) {
+	hour = (et / 3600) % 24;
+      }
+      else {
+	// solar hour at the grid we're sorting by (or at the receiver)
+	ent->getField((grid_sel == WSPRLogEntry::UNDEFINED) ? WSPRLogEntry::RXGRID : grid_sel, grid);
+	float fhour;
+	if(!sol_cache.getFHour(et, grid, fhour)) {
+	  skipped++;
+	  return;
+	}
+	hour = ((int) fhour) % 24;
+      }
+      key.push_back(',');
+      key += std::to_string(hour);
+    }
+    if(grid_sel != WSPRLogEntry::UNDEFINED) {
+      ent->getField(grid_sel, grid);
+      key.push_back(',');
+      key.append(grid, 0, grid_chars);
+    }
+
+    Cell & c = cell(key);
+    uint64_t txh = stableHash(txcall);
+    uint64_t rxh = stableHash(rxcall);
+    c.spots++;
+    c.tx.addHash(txh);
+    c.rx.addHash(rxh);
+    c.path.addHash(stableHash(txh, rxh));
+  }
+
+  Cell & cell(const std::string & name) {
+    size_t id = (size_t) cell_names.intern(name);
+    if(id == cells.size()) cells.push_back(Cell(p));
+    return cells[id];
+  }
+
+  void report(std::ostream & os) {
+    std::vector<int> ids;
+    for(size_t id = 0; id < cells.size(); id++) ids.push_back(id);
+    cell_names.sortByName(ids);
+
+    os << boost::format("# distinct counts are estimates, standard error %.2f%%\n")
+      % (100.0 * HyperLogLog(p).stdError());
+    os << "# " << cellHeader() << ", spots, rx calls, tx calls, paths\n";
+    for(auto id: ids) {
+      const Cell & c = cells[id];
+      os << boost::format("%s, %d, %.0f, %.0f, %.0f\n")
+	% cell_names.name(id) % c.spots % c.rx.estimate() % c.tx.estimate() % c.path.estimate();
+    }
+  }
+
+  // what the cell names are made of, which is also how we tell
+  // whether a saved file can be merged with this run
+  std::string cellHeader() const {
+    const char * hour_names[] = { "", ",UTC hour", ",solar hour" };
+    std::string ret = std::string("band") + hour_names[hour_mode];
+    if(grid_sel != WSPRLogEntry::UNDEFINED) {
+      ret += (grid_sel == WSPRLogEntry::RXGRID) ? ",rx grid" : ",tx grid";
+      ret += std::to_string(grid_chars);
+    }
+    return ret;
+  }
+
+  // The saved form, for merging later:
+  //   "WSPRDHLL" magic, uint32 version, the cell header string,
+  //   uint32 number of cells, and for each cell its name, spot
+  //   count (uint64), and the rx, tx, and path sketches.
+  bool save(const std::string & fname) {
+    std::ofstream os(fname, std::ios::binary);
+    if(!os.is_open()) {
+      std::cerr << boost::format("Could not open sketch file [%s] for writing.\n") % fname;
+      return false;
+    }
+    os.write(magic, sizeof(magic));
+    BinaryIO::put<uint32_t>(os, VERSION);
+    BinaryIO::putString(os, cellHeader());
+    BinaryIO::put<uint32_t>(os, cells.size());
+    for(size_t id = 0; id < cells.size(); id++) {
+      BinaryIO::putString(os, cell_names.name(id));
+      BinaryIO::put<uint64_t>(os, cells[id].spots);
+      cells[id].rx.write(os);
+      cells[id].tx.write(os);
+      cells[id].path.write(os);
+    }
+    os.close();
+    return !os.fail();
+  }
+
+  bool load(const std::string & fname) {
+    std::ifstream is(fname, std::ios::binary);
+    if(!is.is_open()) {
+      std::cerr << boost::format("Could not open sketch file [%s] for reading.\n") % fname;
+      return false;
+    }
+    char fmagic[sizeof(magic)];
+    is.read(fmagic, sizeof(fmagic));
+    uint32_t version, num_cells;
+    std::string header;
+    if(!is.good() || !std::equal(fmagic, fmagic + sizeof(fmagic), magic) ||
+       !BinaryIO::get(is, version) || (version != VERSION)) {
+      std::cerr << boost::format("[%s] is not a WSPRLogDistinct sketch file.\n") % fname;
+      return false;
+    }
+    if(!BinaryIO::getString(is, header) || !BinaryIO::get(is, num_cells)) {
+      std::cerr << boost::format("Sketch file [%s] is truncated or damaged.\n") % fname;
+      return false;
+    }
+    if(header != cellHeader()) {
+      std::cerr << boost::format("Sketch file [%s] has cells by [%s], not [%s]\n")
+	% fname % header % cellHeader();
+      return false;
+    }
+    for(uint32_t i = 0; i < num_cells; i++) {
+      std::string name;
+      Cell c(p);
+      if(!BinaryIO::getString(is, name) || !BinaryIO::get(is, c.spots) ||
+	 !c.rx.read(is) || !c.tx.read(is) || !c.path.read(is)) {
+	std::cerr << boost::format("Sketch file [%s] is truncated or damaged.\n") % fname;
+	return false;
+      }
+      if(!cell(name).merge(c)) {
+	std::cerr << boost::format("Sketch file [%s] has precision %d, not %d\n")
+	  % fname % c.rx.getP() % p;
+	return false;
+      }
+    }
+    return true;
+  }
+
+  // spots whose grid didn't decode, so they have no solar hour
+  uint64_t skipped;
+
+private:
+  static const uint32_t VERSION = 1;
+  static const char magic[8];
+
+  HourMode hour_mode;
+  WSPRLogEntry::Field grid_sel;
+  int grid_chars;
+  int p;
+
+  SolarTimeCache sol_cache;
+  StringInterner cell_names;
+  std::vector<Cell> cells;
+  std::string key, grid;
+};
+
+const char myAccumulator::magic[8] = { 'W', 'S', 'P', 'R', 'D', 'H', 'L', 'L' };
+
+int main(int argc, char * argv[])
+{
+  std::string in_name, out_name, hour_name, grid_name, save_name;
+  std::vector<std::string> add_names;
+  bool input_gzipped;
+  int band;
+  int num_threads;
+  int grid_chars;
+  int p;
+  namespace po = boost::program_options;
+
+  po::options_description desc("Options:");
+
+  desc.add_options()
+    ("help", "help message")
+    ("log", po::value<std::string>(&in_name), "Input log file (csv) in WSPR log format")
+    ("out", po::value<std::string>(&out_name)->required(), "Distinct counts, one line per cell")
+    ("hour", po::value<std::string>(&hour_name)->default_value("utc"), "Split each band by UTC hour (utc), solar hour (solar), or not at all (none)")
+    ("grid", po::value<std::string>(&grid_name), "Also split by grid: RXGRID or TXGRID.  Solar hours are taken at this grid (or at the receiver).")
+    ("grid_chars", po::value<int>(&grid_chars)->default_value(2), "Number of grid characters in a cell (2 for fields, 4 for squares)")
+    ("precision", po::value<int>(&p)->default_value(12), "Each estimate uses 2^precision bytes, with standard error 1.04/sqrt(2^precision)")
+    ("save", po::value<std::string>(&save_name), "Also save the sketches to this file, for merging later")
+    ("add", po::value<std::vector<std::string> >(&add_names), "Merge in sketches saved by an earlier run.  May be given more than once.")
+    ("band", po::value<int>(&band), "Only use reports from this band (wsprnet band number, e.g. 10 for 30m)")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of worker threads")
+    ("igz", po::value<bool>(&input_gzipped)->default_value(false), "if true, input file is gzip compressed");
+
+  po::positional_options_description pos_opts ;
+  pos_opts.add("log", 1);
+  pos_opts.add("out", 1);
+
+  po::variables_map vm;
+
+  std::string what_am_i("Estimate distinct rx calls, tx calls, and paths by band, hour, and grid\n\tWSPRLogDistinct <log> <out> [--hour solar] [--grid RXGRID]\n");
+  try {
+    po::store(po::command_line_parser(argc, argv).options(desc)
+	      .positional(pos_opts).run(), vm);
+
+    if(vm.count("help")) {
+      std::cout << what_am_i
+		<< desc << std::endl;
+      exit(-1);
+    }
+
+    po::notify(vm);
+  }
+  catch(po::required_option & e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+    std::cerr << what_am_i
+	      << desc << std::endl;
+    exit(-1);
+  }
+  catch(po::error & e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+    std::cerr << what_am_i
+	      << desc << std::endl;
+    exit(-1);
+  }
+
+  if(!vm.count("log") && !vm.count("add")) {
+    std::cerr << "ERROR: need a log file, or sketches to --add, or both\n";
+    exit(-1);
+  }
+
+  myAccumulator::HourMode hour_mode;
+  if(hour_name == "utc") hour_mode = myAccumulator::UTC;
+  else if(hour_name == "solar") hour_mode = myAccumulator::SOLAR;
+  else if(hour_name == "none") hour_mode = myAccumulator::NONE;
+  else {
+    std::cerr << "ERROR: hour must be one of utc, solar, or none" << std::endl;
+    exit(-1);
+  }
+
+  WSPRLogEntry::Field grid_sel = WSPRLogEntry::UNDEFINED;
+  if(vm.count("grid")) {
+    grid_sel = WSPRLogEntry::str2Field(grid_name);
+    if((grid_sel != WSPRLogEntry::RXGRID) && (grid_sel != WSPRLogEntry::TXGRID)) {
+      std::cerr << "ERROR: grid must be RXGRID or TXGRID" << std::endl;
+      exit(-1);
+    }
+  }
+
+  myAccumulator acc(hour_mode, grid_sel, grid_chars, p);
+
+  for(auto & a: add_names) {
+    if(!acc.load(a)) exit(-1);
+  }
+
+  if(vm.count("log")) {
+    WSPRLog wlog;
+    // we only look at entries through getField
+    wlog.setLazyDecode(true);
+    if(vm.count("band")) wlog.addPreFilter(WSPRLogEntry::BAND, band, band);
+
+    wlog.readLog(in_name, input_gzipped, acc, num_threads);
+  }
+
+  std::ofstream ofs(out_name);
+  acc.report(ofs);
+  if(acc.skipped) {
+    std::cerr << boost::format("Skipped %d spots with a malformed grid\n") % acc.skipped;
+  }
+
+  if(vm.count("save") && !acc.save(save_name)) {
+    std::cerr << boost::format("Could not write sketch file [%s].\n") % save_name;
+    exit(-1);
+  }
+}
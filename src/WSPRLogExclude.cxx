@@ -0,0 +1,182 @@
+#include "WSPRLog.hxx"
+
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#include <boost/iostreams/filtering_streambuf.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <thread>
+
+// Remove every report whose rx (and/or tx) call is on an exclusion list. 
+// This replaces 
+//    grep -v -f band_excludes.lis band_file.csv > clean_band_file.csv
+// which matched the calls as substrings anywhere in the line. 
+//
+// The input is cut into blocks of lines.  Each worker filters one
+// block, and the blocks are written back out in their original order.
+
+const size_t LINES_PER_BLOCK = 16384; 
+
+class LineBlock {
+public:
+  std::vector<std::string> lines; 
+  std::string out; 
+  size_t num_lines; 
+}; 
+
+void filterBlock(const WSPRLogCallFilter * filter, LineBlock * blk)
+{
+  blk->out.clear();
+  for(size_t i = 0; i < blk->num_lines; i++) {
+    const std::string & line = blk->lines[i]; 
+    if(!filter->isExcluded(line)) {
+      blk->out.append(line);
+      blk->out.push_back('\n');
+    }
+  }
+}
+
+// read up to LINES_PER_BLOCK lines, return false if there weren't any. 
+bool readBlock(std::istream & in, LineBlock & blk) 
+{
+  blk.lines.resize(LINES_PER_BLOCK); 
+  blk.num_lines = 0;
+  while((blk.num_lines < LINES_PER_BLOCK) && 
+	getline(in, blk.lines[blk.num_lines])) {
+    blk.num_lines++;
+  }
+  return blk.num_lines != 0; 
+}
+
+// read a set of blocks, one per worker.  Returns the number of blocks filled.
+int readBlocks(std::istream & in, std::vector<LineBlock> & blocks)
+{
+  size_t i; 
+  for(i = 0; i < blocks.size(); i++) {
+    if(!readBlock(in, blocks[i])) break; 
+  }
+  return i; 
+}
+
+void filterLog(std::istream & in, std::ostream & out, 
+	       const WSPRLogCallFilter & filter, int num_threads)
+{
+  // while one set of blocks is being filtered, we read the next. 
+  std::vector<LineBlock> blocks[2]; 
+  blocks[0].resize(num_threads);
+  blocks[1].resize(num_threads);
+
+  int cur = 0; 
+  int num_blocks = readBlocks(in, blocks[cur]);
+  while(num_blocks > 0) {
+    std::vector<std::thread> workers; 
+    for(int i = 0; i < num_blocks; i++) {
+      workers.push_back(std::thread(filterBlock, &filter, &(blocks[cur][i])));
+    }
+
+    int next = 1 - cur; 
+    int next_num_blocks = readBlocks(in, blocks[next]); 
+
+    for(int i = 0; i < num_blocks; i++) {
+      workers[i].join();
+      out << blocks[cur][i].out; 
+    }
+
+    cur = next; 
+    num_blocks = next_num_blocks; 
+  }
+}
+
+int main(int argc, char * argv[])
+{
+  std::string in_name, out_name, calls_name, field_sel; 
+  bool input_gzipped; 
+  int num_threads; 
+  namespace po = boost::program_options;
+
+  po::options_description desc("Options:");
+
+  desc.add_options()
+    ("help", "help message")
+    ("log", po::value<std::string>(&in_name)->required(), "Input log file (csv) in WSPR log format")
+    ("out", po::value<std::string>(&out_name)->required(), "Filtered output log file (csv) in WSPR log format")
+    ("calls", po::value<std::string>(&calls_name)->required(), "List of calls to exclude, one per line")
+    ("field", po::value<std::string>(&field_sel)->default_value("BOTH"), "Match calls against RX, TX, or BOTH call fields")
+    ("threads", po::value<int>(&num_threads)->default_value(std::thread::hardware_concurrency()), "Number of worker threads")
+    ("igz", po::value<bool>(&input_gzipped)->default_value(false), "if true, input file is gzip compressed");
+  
+  po::positional_options_description pos_opts ;
+  pos_opts.add("log", 1);
+  pos_opts.add("out", 1);
+    
+  po::variables_map vm; 
+
+  std::string what_am_i("Remove reports from (or to) a list of excluded calls\n");
+  try {
+    po::store(po::command_line_parser(argc, argv).options(desc)
+	      .positional(pos_opts).run(), vm);
+    
+    if(vm.count("help")) {
+      std::cout << what_am_i
+		<< desc << std::endl; 
+      exit(-1);
+    }
+
+    po::notify(vm);
+  }
+  catch(po::required_option & e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl; 
+    std::cerr << what_am_i
+	      << desc << std::endl;
+    exit(-1);    
+  }
+  catch(po::error & e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl; 
+    std::cerr << what_am_i
+	      << desc << std::endl;
+    exit(-1);        
+  }
+
+  WSPRLogCallFilter filter; 
+  WSPRLogCallFilter::Selection sel; 
+  if(!WSPRLogCallFilter::str2Selection(field_sel, sel)) {
+    std::cerr << boost::format("Bad call field selector [%s] -- use RX, TX, or BOTH\n") % field_sel; 
+    exit(-1);
+  }
+  filter.setSelection(sel); 
+  if(!filter.load(calls_name)) exit(-1); 
+
+  if(num_threads < 1) num_threads = 1; 
+
+  std::ofstream out(out_name); 
+  if(!out.good()) {
+    std::cerr << boost::format("Could not open output file [%s] for writing.\n") % out_name; 
+    exit(-1);
+  }
+
+  if(input_gzipped) {
+    std::ifstream gzfile(in_name, std::ios_base::in | std::ios_base::binary);
+    if(!gzfile.good()) {
+      std::cerr << boost::format("Could not open input file [%s] for reading.\n") % in_name; 
+      exit(-1);
+    }
+    boost::iostreams::filtering_streambuf<boost::iostreams::input> inbuf;
+    inbuf.push(boost::iostreams::gzip_decompressor());
+    inbuf.push(gzfile);
+    std::istream in(&inbuf);
+    filterLog(in, out, filter, num_threads);
+  }
+  else {
+    std::ifstream in(in_name); 
+    if(!in.good()) {
+      std::cerr << boost::format("Could not open input file [%s] for reading.\n") % in_name; 
+      exit(-1);
+    }
+    filterLog(in, out, filter, num_threads);
+  }
+
+  out.close();
+}
@@ -1,4 +1,5 @@
 #include "WSPRLog.hxx"
+#include "GridMapAnalysis.hxx"
 
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
@@ -8,73 +9,16 @@
 #include <list>
 #include <math.h>
 #include <set>
-
-// build a heat map for the major grid divisions (AA to RR)
-// from the maidenhead grid locator
-class myWSPRLog : public WSPRLog {
-public:
-  myWSPRLog() : WSPRLog() {
-    for(char f = 'A'; f <= 'R'; f++) {
-      for(char s = 'A'; s <= 'R'; s++) {
-	std::pair<char, char> k(f, s);
-	rx_grid_map[k] = 0; 
-	tx_grid_map[k] = 0; 
-      }
-    }
-  }
-
-  ~myWSPRLog() { 
-  }
-
-  bool processEntry(WSPRLogEntry * ent) {
-    int fdiff; 
-    if(ent == NULL) return false;
-
-    std::string rxgrid, txgrid; 
-    ent->getField(WSPRLogEntry::RXGRID, rxgrid);
-    ent->getField(WSPRLogEntry::RXGRID, txgrid);     
-
-    std::pair<char, char> rxkey(std::toupper(rxgrid[0]), std::toupper(rxgrid[1]));
-    std::pair<char, char> txkey(std::toupper(txgrid[0]), std::toupper(txgrid[1]));    
-    if(rx_grid_map.find(rxkey) != rx_grid_map.end()) {
-      rx_grid_map[rxkey] += 1; 
-    }
-    else {
-      std::cerr << boost::format("Couldn't find key for rx grid [%s]\n") % rxgrid; 
-    }
-    if(tx_grid_map.find(txkey) != tx_grid_map.end()) {
-      tx_grid_map[txkey] += 1; 
-    }
-    else {
-      std::cerr << boost::format("Couldn't find key for tx grid [%s]\n") % txgrid; 
-    }
-    return false;
-  }
-
-  void report(std::string & ofname) {
-    std::ofstream os(ofname); 
-    for(char f = 'A'; f <= 'R'; f++) {
-      for(char s = 'A'; s <= 'R'; s++) {      
-	std::pair<char, char> k(f, s); 
-	int fi = f - 'A'; 
-	int si = s - 'A'; 
-	os << boost::format("%c %c %d %d %d %d\n")
-	  % f % s % fi % si % rx_grid_map[k] % tx_grid_map[k]; 
-      }
-      os << std::endl; 
-    }
-    os.close(); 
-  }
-
-private:
-  std::map<std::pair<char, char>, int> rx_grid_map;
-  std::map<std::pair<char, char>, int> tx_grid_map;   
-}; 
+#include <vector>
+#include <algorithm>
 
 int main(int argc, char * argv[])
 {
   std::string in_name, out_name;
   bool input_gzipped; 
+  int band; 
+  int num_threads; 
+  int chars; 
   namespace po = boost::program_options;
 
 
@@ -84,6 +28,11 @@ int main(int argc, char * argv[])
     ("help", "help message")
     ("log", po::value<std::string>(&in_name)->required(), "Input log file (csv) in WSPR log format")
     ("out", po::value<std::string>(&out_name)->required(), "Output table")
+    ("band", po::value<int>(&band), "Only use reports from this band (wsprnet band number, e.g. 10 for 30m)")
+    ("chars", po::value<int>(&chars)->default_value(2), "Map by field (2), square (4), or subsquare (6)")
+    ("by_band", "Make a separate map for each band")
+    ("by_hour", "Make a separate map for each UTC hour")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of worker threads")
     ("igz", po::value<bool>(&input_gzipped)->default_value(false), "if true, input file is gzip compressed");
   
   po::positional_options_description pos_opts ;
@@ -118,10 +67,20 @@ int main(int argc, char * argv[])
   }
 
 
-  myWSPRLog wlog;
+  if((chars != 2) && (chars != 4) && (chars != 6)) {
+    std::cerr << "ERROR: chars must be 2, 4, or 6" << std::endl; 
+    exit(-1); 
+  }
+
+  WSPRLog wlog;
+  GridMapAnalysis acc(chars, vm.count("by_band") > 0, vm.count("by_hour") > 0); 
+
+  // we only look at entries through getField
+  wlog.setLazyDecode(true); 
+  if(vm.count("band")) wlog.addPreFilter(WSPRLogEntry::BAND, band, band); 
 
-  wlog.readLog(in_name, input_gzipped);
+  wlog.readLog(in_name, input_gzipped, acc, num_threads);
   
 
-  wlog.report(out_name); 
+  acc.report(out_name); 
 }
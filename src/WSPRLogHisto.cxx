@@ -1,4 +1,6 @@
 #include "WSPRLog.hxx"
+#include "HistoAnalysis.hxx"
+#include "WSPRLogPartial.hxx"
 
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
@@ -8,57 +10,16 @@
 #include <list>
 #include <math.h>
 #include <set>
-
-class myWSPRLog : public WSPRLog {
-public:
-  myWSPRLog(WSPRLogEntry::Field _sel) : WSPRLog() {
-    sel = _sel; 
-  }
-
-
-  bool processEntry(WSPRLogEntry * ent) {
-    int el; 
-
-    ent->getField(sel, el); 
-
-    if(histogram.find(el) == histogram.end()) {
-      histogram[el] = 1; 
-    }
-    else {
-      histogram[el] += 1; 
-    }
-    
-    return false;
-  }
-
-
-  void printHistogram(std::ostream & os) {
-    // sum the samples.. 
-    int sum = 0; 
-    for(auto he: histogram) {
-      sum += he.second;
-    }
-
-    double fsum = ((double) sum); 
-    double cdf = 0.0; 
-
-    for(auto he: histogram) {
-      double v =((double) he.second); 
-      double pdf = v / fsum; 
-      cdf += pdf; 
-      os << boost::format("%d %d %f %f\n")
-	% he.first % he.second % pdf % cdf; 
-    }
-  }
-private:
-  std::map<int, int> histogram;
-  WSPRLogEntry::Field sel;
-}; 
+#include <vector>
+#include <cstdlib>
 
 int main(int argc, char * argv[])
 {
-  std::string in_name, out_name, field_selector;
+  std::string in_name, out_name, partial_name;
+  std::vector<std::string> field_specs;
   bool input_gzipped; 
+  int band; 
+  int num_threads; 
   namespace po = boost::program_options;
 
 
@@ -68,7 +29,10 @@ int main(int argc, char * argv[])
     ("help", "help message")
     ("log", po::value<std::string>(&in_name)->required(), "Input log file (csv) in WSPR log format")
     ("out", po::value<std::string>(&out_name)->required(), "Histogram table suitable for gnuplot")
-    ("field", po::value<std::string>(&field_selector)->required(), "Numeric field to use for histogram buckets")
+    ("field", po::value<std::vector<std::string> >(&field_specs)->required(), "Numeric field to use for histogram buckets, as FIELD or FIELD:width (e.g. DIST:100).  May be given more than once; all the histograms come from one pass over the log.")
+    ("band", po::value<int>(&band), "Only use reports from this band (wsprnet band number, e.g. 10 for 30m)")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of worker threads")
+    ("partial", po::value<std::string>(&partial_name), "Also save the raw counts to this file, for WSPRLogMerge")
     ("igz", po::value<bool>(&input_gzipped)->default_value(false), "if true, input file is gzip compressed");
   
   po::positional_options_description pos_opts ;
@@ -78,7 +42,7 @@ int main(int argc, char * argv[])
     
   po::variables_map vm; 
 
-  std::string what_am_i("Build histogram, pdf, cdf, from log file and selected field\n");
+  std::string what_am_i("Build histogram, pdf, cdf, from log file and selected fields\n\tWSPRLogHisto <log> <out> --field SNR [--field DIST:100 ...]\n");
 
   try {
     po::store(po::command_line_parser(argc, argv).options(desc)
@@ -106,18 +70,24 @@ int main(int argc, char * argv[])
   }
 
 
-  WSPRLogEntry::Field sel; 
-  sel = WSPRLogEntry::str2Field(field_selector); 
-  if(sel == WSPRLogEntry::UNDEFINED) {
-    std::cerr << "Bad field selected.\n";
-    WSPRLogEntry::printFieldChoices(std::cerr); 
-    exit(-1); 
+  std::vector<FieldHisto> fields; 
+  for(auto & spec: field_specs) {
+    if(!FieldHisto::parse(spec, fields)) exit(-1); 
   }
 
-  myWSPRLog wlog(sel); 
+  WSPRLog wlog; 
+  HistoAnalysis acc(fields); 
+
+  // we only look at entries through getField
+  wlog.setLazyDecode(true); 
+  if(vm.count("band")) wlog.addPreFilter(WSPRLogEntry::BAND, band, band); 
 
-  wlog.readLog(in_name, input_gzipped);
+  wlog.readLog(in_name, input_gzipped, acc, num_threads);
   
+  WSPRLogPartial part = acc.newPartial(); 
+  acc.toPartial(part); 
   std::ofstream ofs(out_name);
-  wlog.printHistogram(ofs);
+  WSPRLogReport::histo(part, ofs);
+  acc.reportDropped(std::cerr); 
+  if(vm.count("partial") && !part.write(partial_name)) exit(-1); 
 }
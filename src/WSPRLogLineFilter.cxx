@@ -31,6 +31,13 @@ public:
 	set60.insert(i * 60 + j);
       }
     }
+
+    // zero offset reports never make it past the raw line filter
+    addPreFilter(WSPRLogEntry::FREQ_DIFF, -HUGE_VAL, -1.0);
+    addPreFilter(WSPRLogEntry::FREQ_DIFF, 1.0, HUGE_VAL);
+
+    // we only look at entries through getField and print
+    setLazyDecode(true); 
   }
 
   ~myWSPRLog() { 
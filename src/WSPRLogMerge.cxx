@@ -0,0 +1,98 @@
+#include "WSPRLogPartial.hxx"
+#include <boost/program_options.hpp>
+#include <string>
+#include <iostream>
+#include <vector>
+
+// add up partial files written by WSPRLogTimeHisto, WSPRLogHisto, or
+// WSPRLogSolTimeOR (--partial) and make the report the tool would have
+// made from all of the logs at once.  For SolTimeOR partials it can
+// also report odds ratios over wider windows than the tool's buckets.
+int main(int argc, char * argv[])
+{
+  std::string out_name, partial_name; 
+  std::vector<std::string> in_names; 
+  std::string window_name, interval_name; 
+  double window_minutes, stride_minutes, conf; 
+  int resamples; 
+  uint64_t seed; 
+  namespace po = boost::program_options;
+
+  po::options_description desc("Options:");
+
+  desc.add_options()
+    ("help", "help message")
+    ("out", po::value<std::string>(&out_name)->required(), "Report file (or output basename, for WSPRLogTimeHisto partials)")
+    ("partial", po::value<std::string>(&partial_name), "Also save the summed counts to this partial file")
+    ("window_report", po::value<std::string>(&window_name), "SolTimeOR partials: also write odds ratios with confidence intervals for sliding windows to this file")
+    ("window", po::value<double>(&window_minutes)->default_value(60.0), "Window width in minutes, for --window_report")
+    ("stride", po::value<double>(&stride_minutes)->default_value(0.0), "Minutes from one window to the next (0 for the window width), for --window_report")
+    ("interval", po::value<std::string>(&interval_name)->default_value("wald"), "Confidence interval: wald, exact, or bootstrap, for --window_report")
+    ("conf", po::value<double>(&conf)->default_value(0.95), "Confidence level, for --window_report")
+    ("resamples", po::value<int>(&resamples)->default_value(1000), "Resamples per window, for --interval bootstrap")
+    ("seed", po::value<uint64_t>(&seed)->default_value(1), "Random seed, for --interval bootstrap")
+    ("in", po::value<std::vector<std::string> >(&in_names)->required(), "Partial files to add up");
+  
+  po::positional_options_description pos_opts ;
+  pos_opts.add("out", 1);
+  pos_opts.add("in", -1);
+
+  po::variables_map vm; 
+
+  std::string what_am_i("Sum partial files and write the usual report\n\tWSPRLogMerge <out> <partial> [<partial> ...]\n");
+  try {
+    po::store(po::command_line_parser(argc, argv).options(desc)
+	      .positional(pos_opts).run(), vm);
+    
+    if(vm.count("help")) {
+      std::cout << what_am_i
+		<< desc << std::endl; 
+      exit(-1);
+    }
+
+    po::notify(vm);
+  }
+  catch(po::required_option & e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl; 
+    std::cerr << what_am_i
+	      << desc << std::endl;
+    exit(-1);    
+  }
+  catch(po::error & e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl; 
+    std::cerr << what_am_i
+	      << desc << std::endl;
+    exit(-1);        
+  }
+
+  WindowOR::Interval interval; 
+  if(interval_name == "wald") interval = WindowOR::WALD; 
+  else if(interval_name == "exact") interval = WindowOR::EXACT; 
+  else if(interval_name == "bootstrap") interval = WindowOR::BOOTSTRAP; 
+  else {
+    std::cerr << "ERROR: interval must be one of wald, exact, or bootstrap" << std::endl; 
+    exit(-1); 
+  }
+  if(stride_minutes <= 0.0) stride_minutes = window_minutes; 
+
+  WSPRLogPartial sum; 
+  for(size_t i = 0; i < in_names.size(); i++) {
+    WSPRLogPartial part; 
+    if(!part.read(in_names[i])) exit(-1); 
+    if(i == 0) sum = part; 
+    else if(!sum.merge(part)) {
+      std::cerr << "ERROR: while merging " << in_names[i] << std::endl; 
+      exit(-1); 
+    }
+  }
+
+  if(!WSPRLogReport::render(sum, out_name)) exit(-1); 
+  if(vm.count("window_report")) {
+    if(sum.getKind() != "SolTimeOR") {
+      std::cerr << "ERROR: --window_report is only for SolTimeOR partials" << std::endl; 
+      exit(-1); 
+    }
+    if(!WSPRLogReport::solTimeORWindows(sum, window_name, window_minutes, stride_minutes, interval, conf, resamples, seed)) exit(-1); 
+  }
+  if(vm.count("partial") && !sum.write(partial_name)) exit(-1); 
+}
@@ -0,0 +1,116 @@
+#include "WSPRLog.hxx"
+#include "WSPRLogAnalysis.hxx"
+
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+#include <string>
+#include <iostream>
+#include <vector>
+
+// Run several analyses over one read of the log -- ten reports cost
+// one parse instead of ten.  Each --run names an analysis, where its
+// report goes, and its settings:
+//
+//   WSPRLogMulti log.csv --run Histo,out=snr.hist,field=SNR,field=DIST:100
+//        --run GridMap,out=grid4.dat,chars=4 --run TimeHisto,out=th
+//
+// With --threads, each worker thread runs all of the analyses on its
+// share of the log.
+
+int main(int argc, char * argv[])
+{
+  std::string in_name;
+  std::vector<std::string> run_specs;
+  bool input_gzipped;
+  int band;
+  int num_threads;
+  namespace po = boost::program_options;
+
+  po::options_description desc("Options:");
+
+  desc.add_options()
+    ("help", "help message")
+    ("list", "list the analyses and their settings")
+    ("log", po::value<std::string>(&in_name), "Input log file (csv) in WSPR log format")
+    ("run", po::value<std::vector<std::string> >(&run_specs), "An analysis to run, as NAME,out=FILE[,setting=value...].  May be given more than once.")
+    ("band", po::value<int>(&band), "Only use reports from this band (wsprnet band number, e.g. 10 for 30m)")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of worker threads")
+    ("igz", po::value<bool>(&input_gzipped)->default_value(false), "if true, input file is gzip compressed");
+
+  po::positional_options_description pos_opts ;
+  pos_opts.add("log", 1);
+
+  po::variables_map vm;
+
+  std::string what_am_i("Run several analyses in one pass over a WSPR log\n\tWSPRLogMulti <log> --run NAME,out=FILE[,setting=value...] ...\n");
+  try {
+    po::store(po::command_line_parser(argc, argv).options(desc)
+	      .positional(pos_opts).run(), vm);
+
+    if(vm.count("help")) {
+      std::cout << what_am_i
+		<< desc << std::endl;
+      WSPRLogAnalyses::list(std::cout);
+      exit(-1);
+    }
+
+    po::notify(vm);
+  }
+  catch(po::required_option & e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+    std::cerr << what_am_i
+	      << desc << std::endl;
+    exit(-1);
+  }
+  catch(po::error & e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+    std::cerr << what_am_i
+	      << desc << std::endl;
+    exit(-1);
+  }
+
+  if(vm.count("list")) {
+    WSPRLogAnalyses::list(std::cout);
+    exit(0);
+  }
+
+  if(!vm.count("log") || run_specs.empty()) {
+    std::cerr << "ERROR: need a log file and at least one --run\n";
+    std::cerr << what_am_i
+	      << desc << std::endl;
+    exit(-1);
+  }
+
+  WSPRLogAnalysisSet analyses;
+  for(auto & spec: run_specs) {
+    std::vector<std::string> words;
+    boost::split(words, spec, boost::is_any_of(","));
+    WSPRLogAnalysisArgs args;
+    for(size_t i = 1; i < words.size(); i++) {
+      size_t eq = words[i].find('=');
+      if(eq == std::string::npos) {
+	std::cerr << boost::format("ERROR: [%s] in [%s] should be setting=value\n") % words[i] % spec;
+	exit(-1);
+      }
+      args.insert(std::make_pair(words[i].substr(0, eq), words[i].substr(eq + 1)));
+    }
+    std::string out = WSPRLogAnalyses::getArg(args, "out");
+    if(out.empty()) {
+      std::cerr << boost::format("ERROR: [%s] needs an out=FILE\n") % spec;
+      exit(-1);
+    }
+    WSPRLogAnalysis * an = WSPRLogAnalyses::create(words[0], args);
+    if(an == NULL) exit(-1);
+    analyses.addAnalysis(an, out);
+  }
+
+  WSPRLog wlog;
+  // only if every analysis looks at entries through getField
+  wlog.setLazyDecode(analyses.lazyDecodeOK());
+  if(vm.count("band")) wlog.addPreFilter(WSPRLogEntry::BAND, band, band);
+
+  wlog.readLog(in_name, input_gzipped, analyses, num_threads);
+
+  analyses.report();
+}
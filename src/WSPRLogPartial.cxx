@@ -0,0 +1,446 @@
+#include "WSPRLogPartial.hxx"
+#include "BinaryIO.hxx"
+#include <boost/format.hpp>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+const uint32_t WSPRLogPartial::VERSION;
+
+static const char partial_magic[8] = { 'W', 'S', 'P', 'R', 'P', 'A', 'R', 'T' };
+
+using namespace BinaryIO;
+
+int WSPRLogPartial::findTable(const std::string & name) const
+{
+  for(size_t i = 0; i < tables.size(); i++) {
+    if(tables[i].name == name) return i;
+  }
+  return -1;
+}
+
+std::string WSPRLogPartial::getParam(const std::string & name) const
+{
+  std::istringstream is(params);
+  std::string word;
+  while(is >> word) {
+    size_t eq = word.find('=');
+    if((eq != std::string::npos) && (word.compare(0, eq, name) == 0) && (eq == name.size())) {
+      return word.substr(eq + 1);
+    }
+  }
+  return "";
+}
+
+std::vector<uint64_t> & WSPRLogPartial::dense(const std::string & name, const std::vector<uint32_t> & dims)
+{
+  int idx = findTable(name);
+  if(idx < 0) {
+    Table t;
+    t.name = name;
+    t.is_sparse = false;
+    t.dims = dims;
+    size_t size = 1;
+    for(auto d: dims) size *= d;
+    t.counts.assign(size, 0);
+    tables.push_back(t);
+    idx = tables.size() - 1;
+  }
+  return tables[idx].counts;
+}
+
+FlatCounter<int64_t, uint64_t> & WSPRLogPartial::sparse(const std::string & name)
+{
+  int idx = findTable(name);
+  if(idx < 0) {
+    Table t;
+    t.name = name;
+    t.is_sparse = true;
+    tables.push_back(t);
+    idx = tables.size() - 1;
+  }
+  return tables[idx].sparse_counts;
+}
+
+const std::vector<uint64_t> & WSPRLogPartial::dense(const std::string & name) const
+{
+  static const std::vector<uint64_t> none;
+  int idx = findTable(name);
+  return (idx < 0) ? none : tables[idx].counts;
+}
+
+const std::vector<uint32_t> & WSPRLogPartial::dims(const std::string & name) const
+{
+  static const std::vector<uint32_t> none;
+  int idx = findTable(name);
+  return (idx < 0) ? none : tables[idx].dims;
+}
+
+const FlatCounter<int64_t, uint64_t> & WSPRLogPartial::sparse(const std::string & name) const
+{
+  static const FlatCounter<int64_t, uint64_t> none;
+  int idx = findTable(name);
+  return (idx < 0) ? none : tables[idx].sparse_counts;
+}
+
+bool WSPRLogPartial::write(const std::string & fname) const
+{
+  std::ofstream os(fname, std::ios::binary);
+  if(!os.is_open()) {
+    std::cerr << boost::format("Could not open partial file [%s] for writing.\n") % fname;
+    return false;
+  }
+
+  os.write(partial_magic, sizeof(partial_magic));
+  put<uint32_t>(os, VERSION);
+  putString(os, kind);
+  putString(os, params);
+  put<uint32_t>(os, tables.size());
+  for(auto & t: tables) {
+    putString(os, t.name);
+    put<uint32_t>(os, t.is_sparse ? 1 : 0);
+    put<uint32_t>(os, t.dims.size());
+    for(auto d: t.dims) put<uint32_t>(os, d);
+    if(t.is_sparse) {
+      // in key order, so the same counts always make the same file
+      std::vector<std::pair<int64_t, uint64_t> > ents;
+      t.sparse_counts.sorted(ents);
+      put<uint64_t>(os, ents.size());
+      for(auto & e: ents) {
+	put<int64_t>(os, e.first);
+	put<uint64_t>(os, e.second);
+      }
+    }
+    else {
+      put<uint64_t>(os, t.counts.size());
+      os.write((const char *) t.counts.data(), t.counts.size() * sizeof(uint64_t));
+    }
+  }
+
+  os.close();
+  if(os.fail()) {
+    std::cerr << boost::format("Could not write partial file [%s].\n") % fname;
+    return false;
+  }
+  return true;
+}
+
+bool WSPRLogPartial::read(const std::string & fname)
+{
+  std::ifstream is(fname, std::ios::binary);
+  if(!is.is_open()) {
+    std::cerr << boost::format("Could not open partial file [%s] for reading.\n") % fname;
+    return false;
+  }
+
+  char magic[sizeof(partial_magic)];
+  is.read(magic, sizeof(magic));
+  if(!is.good() || !std::equal(magic, magic + sizeof(magic), partial_magic)) {
+    std::cerr << boost::format("[%s] is not a WSPRLog partial file.\n") % fname;
+    return false;
+  }
+
+  uint32_t version;
+  if(!get(is, version) || (version != VERSION)) {
+    std::cerr << boost::format("[%s] is partial file version %d, but we only read version %d.\n")
+      % fname % version % VERSION;
+    return false;
+  }
+
+  tables.clear();
+  uint32_t num_tables = 0;
+  bool ok = getString(is, kind) && getString(is, params) && get(is, num_tables);
+  for(uint32_t i = 0; ok && (i < num_tables); i++) {
+    Table t;
+    uint32_t is_sparse, ndims;
+    uint64_t nents;
+    ok = getString(is, t.name) && get(is, is_sparse) && get(is, ndims) && (ndims <= 16);
+    t.is_sparse = (is_sparse != 0);
+    uint64_t size = 1;
+    for(uint32_t d = 0; ok && (d < ndims); d++) {
+      uint32_t dim;
+      ok = get(is, dim);
+      t.dims.push_back(dim);
+      size *= dim;
+    }
+    ok = ok && get(is, nents);
+    if(!ok) break;
+
+    if(t.is_sparse) {
+      for(uint64_t e = 0; ok && (e < nents); e++) {
+	int64_t key;
+	uint64_t ct;
+	ok = get(is, key) && get(is, ct);
+	t.sparse_counts.add(key, ct);
+      }
+    }
+    else {
+      // the counts have to fill the table exactly
+      ok = (nents == size);
+      if(!ok) break;
+      t.counts.resize(nents);
+      is.read((char *) t.counts.data(), nents * sizeof(uint64_t));
+      ok = !is.fail();
+    }
+    tables.push_back(t);
+  }
+
+  if(!ok) {
+    std::cerr << boost::format("Partial file [%s] is truncated or damaged.\n") % fname;
+    tables.clear();
+    return false;
+  }
+  return true;
+}
+
+bool WSPRLogPartial::merge(const WSPRLogPartial & other)
+{
+  if((kind != other.kind) || (params != other.params)) {
+    std::cerr << boost::format("Can't merge a %s (%s) partial into a %s (%s) partial.\n")
+      % other.kind % other.params % kind % params;
+    return false;
+  }
+
+  // check every table before touching any
+  for(auto & ot: other.tables) {
+    int idx = findTable(ot.name);
+    if((idx >= 0) && ((tables[idx].is_sparse != ot.is_sparse) || (tables[idx].dims != ot.dims))) {
+      std::cerr << boost::format("Table [%s] has a different shape in the partials being merged.\n")
+	% ot.name;
+      return false;
+    }
+  }
+
+  for(auto & ot: other.tables) {
+    int idx = findTable(ot.name);
+    if(idx < 0) {
+      tables.push_back(ot);
+      continue;
+    }
+    Table & t = tables[idx];
+    if(t.is_sparse) {
+      t.sparse_counts.merge(ot.sparse_counts);
+    }
+    else {
+      for(size_t i = 0; i < t.counts.size(); i++) t.counts[i] += ot.counts[i];
+    }
+  }
+  return true;
+}
+
+void WSPRLogReport::timeHisto(const WSPRLogPartial & part, const std::string & out_base_name)
+{
+  const char * pos_names[] = { "rx", "tx" };
+  for(auto pos: pos_names) {
+    std::ofstream os(out_base_name + "_TH_" + pos + ".dat");
+    for(auto ct: part.dense(pos)) {
+      os << ct << std::endl;
+    }
+    os.close();
+  }
+}
+
+// one histogram table: bin, count, pdf, cdf.  The bin is printed as
+// the low edge of the bin, bin number * width.
+static void histoTable(const FlatCounter<int64_t, uint64_t> & counts, double width, std::ostream & os)
+{
+  std::vector<std::pair<int64_t, uint64_t> > sorted_hist;
+  counts.sorted(sorted_hist);
+
+  // sum the samples..
+  uint64_t sum = 0;
+  for(auto he: sorted_hist) {
+    sum += he.second;
+  }
+
+  double fsum = ((double) sum);
+  double cdf = 0.0;
+  bool int_width = (width == floor(width));
+
+  for(auto he: sorted_hist) {
+    double v =((double) he.second);
+    double pdf = v / fsum;
+    cdf += pdf;
+    if(int_width) {
+      os << boost::format("%d %d %f %f\n")
+	% (he.first * ((int64_t) width)) % he.second % pdf % cdf;
+    }
+    else {
+      os << boost::format("%g %d %f %f\n")
+	% (((double) he.first) * width) % he.second % pdf % cdf;
+    }
+  }
+}
+
+void WSPRLogReport::histo(const WSPRLogPartial & part, std::ostream & os)
+{
+  // one table per field spec (FIELD or FIELD:width)
+  std::vector<std::string> specs;
+  std::istringstream is(part.getParam("fields"));
+  std::string spec;
+  while(std::getline(is, spec, ',')) specs.push_back(spec);
+
+  // partials from before there could be more than one field
+  if(specs.empty()) {
+    histoTable(part.sparse("counts"), 1.0, os);
+    return;
+  }
+
+  bool first = true;
+  for(auto & sp: specs) {
+    size_t colon = sp.find(':');
+    double width = (colon == std::string::npos) ? 1.0 : atof(sp.c_str() + colon + 1);
+    // with more than one field, each gets a header and its own gnuplot
+    // index block
+    if(specs.size() > 1) {
+      if(!first) os << "\n\n";
+      os << "# " << sp << "\n";
+    }
+    first = false;
+    histoTable(part.sparse(sp), width, os);
+  }
+}
+
+// the odds ratios for a [2][buckets] table.
+//
+// That is OR = [(events at time = T) * (non-events over 24 hours)] /
+//              [(events in 24 hours) * (non-events at time = T)]
+//
+// [0] counts all reports, [1] the exceptional ones.
+static WindowOR makeOR(const std::vector<uint64_t> & histo, const uint64_t * counts, size_t buckets)
+{
+  std::vector<uint64_t> all(histo.begin(), histo.begin() + buckets);
+  std::vector<uint64_t> exc(histo.begin() + buckets, histo.begin() + 2 * buckets);
+  double exc_count = (double) counts[1];
+  double norm_count = (double) (((int64_t) counts[0]) - ((int64_t) counts[1]));
+  return WindowOR(buckets, 1, all, exc, exc_count, norm_count);
+}
+
+// one bucket at a time
+static void calcOR(const std::vector<uint64_t> & histo, const uint64_t * counts,
+		   size_t buckets, std::vector<float> & ort)
+{
+  WindowOR wor = makeOR(histo, counts, buckets);
+  ort.assign(buckets, 0.0);
+  for(size_t i = 0; i < buckets; i++) {
+    ort[i] = (float) wor.estimate(0, i, 1).OR;
+  }
+}
+
+static const char * timeBaseName(const WSPRLogPartial & part)
+{
+  std::string time_base = part.getParam("time_base");
+  if(time_base == "sunrise") return "hours since sunrise";
+  else if(time_base == "sunset") return "hours since sunset";
+  return "solar hour";
+}
+
+void WSPRLogReport::solTimeOR(const WSPRLogPartial & part, const std::string & fname)
+{
+  std::ofstream os(fname);
+
+  const std::vector<uint64_t> & rx_histo = part.dense("rx");
+  const std::vector<uint64_t> & tx_histo = part.dense("tx");
+  const std::vector<uint64_t> & mid_histo = part.dense("mid");
+  // rx, tx, mid by mode
+  const std::vector<uint64_t> & counts = part.dense("counts");
+  const size_t buckets = rx_histo.size() / 2;
+  if((buckets == 0) || (counts.size() != 6)) return;
+  const float minutes_per_bucket = (24.0 * 60.0) / ((float) buckets);
+
+  std::vector<float> rx_or, tx_or, mid_or;
+  calcOR(rx_histo, &counts[0], buckets, rx_or);
+  calcOR(tx_histo, &counts[2], buckets, tx_or);
+  calcOR(mid_histo, &counts[4], buckets, mid_or);
+
+  os << "# " << timeBaseName(part) << ", rximage reports, rxall reports, tximage reps, txall reps, midimage reps, imgall reps, rxOR, txOR, midOR\n";
+
+  for(size_t i = 0; i < buckets; i++) {
+    os << boost::format("%5.2f, ") % ((((float) i) * minutes_per_bucket) / 60.0);
+    os << boost::format(" %8d, %8d, %8d, %8d, %8d, %8d, ")
+      % rx_histo[buckets + i] % rx_histo[i]
+      % tx_histo[buckets + i] % tx_histo[i]
+      % mid_histo[buckets + i] % mid_histo[i];
+
+    os << boost::format("%g, %g, %g\n")
+      % rx_or[i] % tx_or[i] % mid_or[i];
+  }
+
+  os.close();
+}
+
+bool WSPRLogReport::solTimeORWindows(const WSPRLogPartial & part, const std::string & fname,
+				     double window_minutes, double stride_minutes,
+				     WindowOR::Interval interval, double conf,
+				     int resamples, uint64_t seed)
+{
+  const std::vector<uint64_t> & counts = part.dense("counts");
+  const size_t buckets = part.dense("rx").size() / 2;
+  if((buckets == 0) || (counts.size() != 6)) {
+    std::cerr << "This doesn't look like a SolTimeOR partial.\n";
+    return false;
+  }
+  const double minutes_per_bucket = (24.0 * 60.0) / ((double) buckets);
+  double wb = window_minutes / minutes_per_bucket;
+  double sb = stride_minutes / minutes_per_bucket;
+  size_t width = (size_t) lround(wb);
+  size_t stride = (size_t) lround(sb);
+  if((width < 1) || (stride < 1) ||
+     (fabs(wb - ((double) width)) > 1e-6) || (fabs(sb - ((double) stride)) > 1e-6)) {
+    std::cerr << boost::format("Window and stride must be multiples of the %g minute buckets.\n")
+      % minutes_per_bucket;
+    return false;
+  }
+
+  const char * names[] = { "rx", "tx", "mid" };
+  std::vector<WindowOR> wors;
+  for(int p = 0; p < 3; p++) {
+    wors.push_back(makeOR(part.dense(names[p]), &counts[2 * p], buckets));
+  }
+
+  std::ofstream os(fname);
+  const char * interval_names[] = { "Wald", "exact", "bootstrap" };
+  os << boost::format("# %g minute windows every %g minutes, %g %s intervals\n")
+    % window_minutes % stride_minutes % conf % interval_names[interval];
+  os << "# " << timeBaseName(part) << " (window center)";
+  for(auto n: names) {
+    os << boost::format(", %1%image reps, %1%other reps, %1%OR, %1%lo, %1%hi") % n;
+  }
+  os << "\n";
+
+  for(size_t start = 0; start < buckets; start += stride) {
+    double center = fmod((((double) start) + 0.5 * ((double) width)) * minutes_per_bucket / 60.0, 24.0);
+    os << boost::format("%5.2f") % center;
+    for(auto & wor: wors) {
+      WindowOR::Estimate est = wor.estimate(0, start, width, interval, conf, resamples, seed);
+      os << boost::format(", %8d, %8d, %g, %g") % est.De % est.He % est.OR % est.lo;
+      // - for no upper limit
+      if(est.bounded) os << boost::format(", %g") % est.hi;
+      else os << ", -";
+    }
+    os << "\n";
+  }
+  os.close();
+  return true;
+}
+
+bool WSPRLogReport::render(const WSPRLogPartial & part, const std::string & out)
+{
+  if(part.getKind() == "TimeHisto") {
+    timeHisto(part, out);
+  }
+  else if(part.getKind() == "Histo") {
+    std::ofstream os(out);
+    histo(part, os);
+  }
+  else if(part.getKind() == "SolTimeOR") {
+    solTimeOR(part, out);
+  }
+  else {
+    std::cerr << boost::format("Don't know how to make a report from a [%s] partial.\n") % part.getKind();
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,106 @@
+#ifndef WSPRLOGPARTIAL_HDR
+#define WSPRLOGPARTIAL_HDR
+#include "FlatCounter.hxx"
+#include "OddsRatio.hxx"
+#include <string>
+#include <vector>
+#include <deque>
+#include <iostream>
+#include <cstdint>
+
+/// Raw counts from one run of a tool, saved so that runs over
+/// different logs (a month each, say) can be added up later by
+/// WSPRLogMerge.  Only counts go in here -- never ratios or other
+/// derived values -- so partials add exactly.
+///
+/// The file is binary, in the byte order of the machine that wrote it:
+///   "WSPRPART"  8 byte magic
+///   version     uint32
+///   kind        string  (the tool, e.g. "SolTimeOR")
+///   params      string  (settings that change the meaning of the counts)
+///   tables      uint32 count, then each table:
+///     name      string
+///     sparse    uint32 (0 or 1)
+///     dims      uint32 count, then uint32 each
+///     entries   uint64 count, then uint64 counts (dense) or
+///               (int64 key, uint64 count) pairs (sparse)
+/// Strings are a uint32 length followed by the characters.
+class WSPRLogPartial {
+public:
+  static const uint32_t VERSION = 1;
+
+  WSPRLogPartial(const std::string & _kind = "", const std::string & _params = "") {
+    kind = _kind;
+    params = _params;
+  }
+
+  const std::string & getKind() const { return kind; }
+  const std::string & getParams() const { return params; }
+  /// params are "name=value" words separated by spaces.  Returns
+  /// "" if the name isn't there.
+  std::string getParam(const std::string & name) const;
+
+  /// a dense table, created (all zeros) on first use.  Counts are in
+  /// row major order, last dimension fastest.
+  std::vector<uint64_t> & dense(const std::string & name, const std::vector<uint32_t> & dims);
+  /// a sparse table, keyed by value
+  FlatCounter<int64_t, uint64_t> & sparse(const std::string & name);
+
+  bool hasTable(const std::string & name) const { return findTable(name) >= 0; }
+  /// empty if there is no such table
+  const std::vector<uint64_t> & dense(const std::string & name) const;
+  const std::vector<uint32_t> & dims(const std::string & name) const;
+  const FlatCounter<int64_t, uint64_t> & sparse(const std::string & name) const;
+
+  bool write(const std::string & fname) const;
+  /// complains on std::cerr and returns false for a bad or foreign file
+  bool read(const std::string & fname);
+
+  /// add another partial's counts to ours.  It must be the same kind,
+  /// with the same params and table shapes.
+  bool merge(const WSPRLogPartial & other);
+
+private:
+  class Table {
+  public:
+    std::string name;
+    bool is_sparse;
+    std::vector<uint32_t> dims;
+    std::vector<uint64_t> counts;
+    FlatCounter<int64_t, uint64_t> sparse_counts;
+  };
+
+  int findTable(const std::string & name) const;
+
+  std::string kind;
+  std::string params;
+  // a deque, so references handed out by dense() and sparse() stay good
+  // as more tables are added
+  std::deque<Table> tables;
+};
+
+/// The reports made from partials.  The tools use these too, so a
+/// report from WSPRLogMerge matches the one the tool would have
+/// written from all the logs at once.
+namespace WSPRLogReport {
+  /// WSPRLogTimeHisto: <base>_TH_rx.dat and <base>_TH_tx.dat
+  void timeHisto(const WSPRLogPartial & part, const std::string & out_base_name);
+  /// WSPRLogHisto: value, count, pdf, cdf for each field
+  void histo(const WSPRLogPartial & part, std::ostream & os);
+  /// WSPRLogSolTimeOR: counts and odds ratios by hour at rx, tx and midpoint
+  void solTimeOR(const WSPRLogPartial & part, const std::string & fname);
+  /// WSPRLogSolTimeOR: odds ratios and confidence intervals for
+  /// window_minutes wide windows, one every stride_minutes, wrapping
+  /// around the day.  Both must be a whole number of the partial's
+  /// buckets; complains and returns false if not.  resamples and
+  /// seed are for WindowOR::BOOTSTRAP intervals.
+  bool solTimeORWindows(const WSPRLogPartial & part, const std::string & fname,
+			double window_minutes, double stride_minutes,
+			WindowOR::Interval interval = WindowOR::WALD, double conf = 0.95,
+			int resamples = 1000, uint64_t seed = 1);
+
+  /// render whatever kind of partial this is.  out is the report file
+  /// (or base name, for WSPRLogTimeHisto).
+  bool render(const WSPRLogPartial & part, const std::string & out);
+}
+#endif
@@ -0,0 +1,302 @@
+#include "WSPRLog.hxx"
+#include "QuantileSketch.hxx"
+#include "FlatCounter.hxx"
+#include "BinaryIO.hxx"
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+// quantiles (p50, p90, p99 by default) of a numeric field, for each
+// group of reports with the same values of the grouping fields
+// (say BAND and HOUR).  Each group gets a KLL sketch, so memory
+// doesn't grow with the number of reports, and sketches saved from
+// several runs (a month each, say) can be merged later.
+
+// HOUR isn't a log field -- it is the UTC hour of the report
+static const std::string hour_group("HOUR");
+
+class myAccumulator : public WSPRLogAccumulator {
+public:
+  myAccumulator(WSPRLogEntry::Field _val_sel, const std::vector<std::string> & _group_names, int _k) {
+    val_sel = _val_sel;
+    group_names = _group_names;
+    for(auto & g: group_names) group_sels.push_back(WSPRLogEntry::str2Field(g));
+    k = _k;
+  }
+
+  WSPRLogAccumulator * clone() const {
+    return new myAccumulator(val_sel, group_names, k);
+  }
+
+  void merge(const WSPRLogAccumulator & other) {
+    const myAccumulator & o = static_cast<const myAccumulator &>(other);
+    for(size_t id = 0; id < o.sketches.size(); id++) {
+      sketch(o.groups.name(id)).merge(o.sketches[id]);
+    }
+  }
+
+  void add(WSPRLogEntry * ent) {
+    double v;
+    if(!getValue(ent, v)) return;
+
+    key.clear();
+    for(size_t i = 0; i < group_sels.size(); i++) {
+      if(i > 0) key.push_back(',');
+      appendGroup(ent, i, key);
+    }
+    sketch(key).add(v);
+  }
+
+  KLLSketch & sketch(const std::string & name) {
+    size_t id = (size_t) groups.intern(name);
+    if(id == sketches.size()) sketches.push_back(KLLSketch(k));
+    return sketches[id];
+  }
+
+  // one line per group, in group name order
+  void report(const std::vector<double> & qs, std::ostream & os) {
+    std::vector<int> ids;
+    for(size_t id = 0; id < sketches.size(); id++) ids.push_back(id);
+    groups.sortByName(ids);
+
+    double rank_err = KLLSketch(k).rankError();
+    os << boost::format("# quantile rank error +/- %.4f (99%% confidence)\n") % rank_err;
+    os << "# " << boost::algorithm::join(group_names, ",") << (group_names.empty() ? "" : ", ")
+       << "count, min";
+    for(auto q: qs) os << boost::format(", p%g") % (100.0 * q);
+    os << ", max\n";
+
+    std::vector<double> res;
+    for(auto id: ids) {
+      const KLLSketch & sk = sketches[id];
+      sk.quantiles(qs, res);
+      if(!group_names.empty()) os << groups.name(id) << ", ";
+      os << boost::format("%d, %g") % sk.count() % sk.min();
+      for(auto r: res) os << boost::format(", %g") % r;
+      os << boost::format(", %g\n") % sk.max();
+    }
+  }
+
+  // The saved form, for merging later:
+  //   "WSPRQSKT" magic, uint32 version, value field, grouping fields
+  //   (comma separated), uint32 k, uint32 number of groups, and for
+  //   each group its name and sketch.
+  bool save(const std::string & fname, const std::string & val_name) {
+    std::ofstream os(fname, std::ios::binary);
+    if(!os.is_open()) {
+      std::cerr << boost::format("Could not open sketch file [%s] for writing.\n") % fname;
+      return false;
+    }
+    os.write(magic, sizeof(magic));
+    BinaryIO::put<uint32_t>(os, VERSION);
+    BinaryIO::putString(os, val_name);
+    BinaryIO::putString(os, boost::algorithm::join(group_names, ","));
+    BinaryIO::put<uint32_t>(os, k);
+    BinaryIO::put<uint32_t>(os, sketches.size());
+    for(size_t id = 0; id < sketches.size(); id++) {
+      BinaryIO::putString(os, groups.name(id));
+      sketches[id].write(os);
+    }
+    os.close();
+    return !os.fail();
+  }
+
+  // merge in a saved sketch file.  It must be for the same value and
+  // grouping fields, and the same k.
+  bool load(const std::string & fname, const std::string & val_name) {
+    std::ifstream is(fname, std::ios::binary);
+    if(!is.is_open()) {
+      std::cerr << boost::format("Could not open sketch file [%s] for reading.\n") % fname;
+      return false;
+    }
+    char fmagic[sizeof(magic)];
+    is.read(fmagic, sizeof(fmagic));
+    uint32_t version, fk, num_groups;
+    std::string fval, fgroups;
+    if(!is.good() || !std::equal(fmagic, fmagic + sizeof(fmagic), magic) ||
+       !BinaryIO::get(is, version) || (version != VERSION)) {
+      std::cerr << boost::format("[%s] is not a WSPRLogQuantiles sketch file.\n") % fname;
+      return false;
+    }
+    if(!BinaryIO::getString(is, fval) || !BinaryIO::getString(is, fgroups) ||
+       !BinaryIO::get(is, fk) || !BinaryIO::get(is, num_groups)) {
+      std::cerr << boost::format("Sketch file [%s] is truncated or damaged.\n") % fname;
+      return false;
+    }
+    if((fval != val_name) || (fgroups != boost::algorithm::join(group_names, ",")) ||
+       (((int) fk) != k)) {
+      std::cerr << boost::format("Sketch file [%s] is for field %s grouped by [%s] with k = %d\n")
+	% fname % fval % fgroups % fk;
+      return false;
+    }
+    for(uint32_t i = 0; i < num_groups; i++) {
+      std::string name;
+      KLLSketch sk(k);
+      if(!BinaryIO::getString(is, name) || !sk.read(is)) {
+	std::cerr << boost::format("Sketch file [%s] is truncated or damaged.\n") % fname;
+	return false;
+      }
+      sketch(name).merge(sk);
+    }
+    return true;
+  }
+
+private:
+  bool getValue(WSPRLogEntry * ent, double & v) {
+    if(ent->getField(val_sel, v)) return true;
+    // some fields (FREQ_DIFF) only come as integers
+    int iv;
+    if(!ent->getField(val_sel, iv)) return false;
+    v = (double) iv;
+    return true;
+  }
+
+  void appendGroup(WSPRLogEntry * ent, size_t i, std::string & out) {
+    if(group_sels[i] == WSPRLogEntry::UNDEFINED) {
+      unsigned long et;
+      ent->getField(WSPRLogEntry::DTIME, et);
+      out += std::to_string((et / 3600) % 24);
+      return;
+    }
+    if(ent->getField(group_sels[i], field_str)) {
+      out += field_str;
+      return;
+    }
+    int iv;
+    ent->getField(group_sels[i], iv);
+    out += std::to_string(iv);
+  }
+
+  static const uint32_t VERSION = 1;
+  static const char magic[8];
+
+  WSPRLogEntry::Field val_sel;
+  std::vector<std::string> group_names;
+  std::vector<WSPRLogEntry::Field> group_sels;
+  int k;
+
+  StringInterner groups;
+  std::vector<KLLSketch> sketches;
+  std::string key, field_str;
+};
+
+const char myAccumulator::magic[8] = { 'W', 'S', 'P', 'R', 'Q', 'S', 'K', 'T' };
+
+int main(int argc, char * argv[])
+{
+  std::string in_name, out_name, field_selector, quantile_list, save_name;
+  std::vector<std::string> group_selectors, add_names;
+  bool input_gzipped;
+  int band;
+  int num_threads;
+  int k;
+  namespace po = boost::program_options;
+
+  po::options_description desc("Options:");
+
+  desc.add_options()
+    ("help", "help message")
+    ("log", po::value<std::string>(&in_name), "Input log file (csv) in WSPR log format")
+    ("out", po::value<std::string>(&out_name)->required(), "Quantile table, one line per group")
+    ("field", po::value<std::string>(&field_selector)->required(), "Numeric field to find the quantiles of (e.g. SNR, DIST, FREQ_DIFF)")
+    ("group", po::value<std::vector<std::string> >(&group_selectors), "Field to group reports by, or HOUR for the UTC hour.  May be given more than once.")
+    ("quantiles", po::value<std::string>(&quantile_list)->default_value("0.5,0.9,0.99"), "Comma separated list of quantiles to report")
+    ("k", po::value<int>(&k)->default_value(200), "Sketch size.  Bigger is more accurate (rank error is about 2.3/k^0.97, 1.3% for k = 200) and uses more memory.")
+    ("save", po::value<std::string>(&save_name), "Also save the sketches to this file, for merging later")
+    ("add", po::value<std::vector<std::string> >(&add_names), "Merge in sketches saved by an earlier run.  May be given more than once.")
+    ("band", po::value<int>(&band), "Only use reports from this band (wsprnet band number, e.g. 10 for 30m)")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of worker threads")
+    ("igz", po::value<bool>(&input_gzipped)->default_value(false), "if true, input file is gzip compressed");
+
+  po::positional_options_description pos_opts ;
+  pos_opts.add("log", 1);
+  pos_opts.add("out", 1);
+
+  po::variables_map vm;
+
+  std::string what_am_i("Quantiles of a field for each group of reports, from a log and/or saved sketches\n\tWSPRLogQuantiles <log> <out> --field SNR --group BAND --group HOUR\n");
+  try {
+    po::store(po::command_line_parser(argc, argv).options(desc)
+	      .positional(pos_opts).run(), vm);
+
+    if(vm.count("help")) {
+      std::cout << what_am_i
+		<< desc << std::endl;
+      exit(-1);
+    }
+
+    po::notify(vm);
+  }
+  catch(po::required_option & e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+    std::cerr << what_am_i
+	      << desc << std::endl;
+    exit(-1);
+  }
+  catch(po::error & e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+    std::cerr << what_am_i
+	      << desc << std::endl;
+    exit(-1);
+  }
+
+  if(!vm.count("log") && !vm.count("add")) {
+    std::cerr << "ERROR: need a log file, or sketches to --add, or both\n";
+    exit(-1);
+  }
+
+  WSPRLogEntry::Field sel = WSPRLogEntry::str2Field(field_selector);
+  if(sel == WSPRLogEntry::UNDEFINED) {
+    std::cerr << "Bad field selected.\n";
+    WSPRLogEntry::printFieldChoices(std::cerr);
+    exit(-1);
+  }
+  for(auto & g: group_selectors) {
+    if((g != hour_group) && (WSPRLogEntry::str2Field(g) == WSPRLogEntry::UNDEFINED)) {
+      std::cerr << "Bad group field selected.\n";
+      WSPRLogEntry::printFieldChoices(std::cerr);
+      std::cerr << hour_group << std::endl;
+      exit(-1);
+    }
+  }
+
+  std::vector<double> qs;
+  std::vector<std::string> qwords;
+  boost::algorithm::split(qwords, quantile_list, boost::algorithm::is_any_of(","));
+  for(auto & w: qwords) {
+    double q = atof(w.c_str());
+    if((q < 0.0) || (q > 1.0)) {
+      std::cerr << "ERROR: quantiles must be between 0 and 1\n";
+      exit(-1);
+    }
+    qs.push_back(q);
+  }
+
+  myAccumulator acc(sel, group_selectors, k);
+
+  for(auto & a: add_names) {
+    if(!acc.load(a, field_selector)) exit(-1);
+  }
+
+  if(vm.count("log")) {
+    WSPRLog wlog;
+    // we only look at entries through getField
+    wlog.setLazyDecode(true);
+    if(vm.count("band")) wlog.addPreFilter(WSPRLogEntry::BAND, band, band);
+
+    wlog.readLog(in_name, input_gzipped, acc, num_threads);
+  }
+
+  std::ofstream ofs(out_name);
+  acc.report(qs, ofs);
+
+  if(vm.count("save") && !acc.save(save_name, field_selector)) {
+    std::cerr << boost::format("Could not write sketch file [%s].\n") % save_name;
+    exit(-1);
+  }
+}
@@ -1,6 +1,5 @@
 #include "WSPRLog.hxx"
-#include "SolarTime.hxx"
-#include "TimeCorr.hxx"
+#include "SolAzHistoAnalysis.hxx"
 
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
@@ -14,70 +13,11 @@
 #include <math.h>
 #include <set>
 
-// plot distance, azimuth pairs.
-const int NUM_TIME_BUCKETS = (24 * 10);
-const int NUM_AZ_BUCKETS = (360 / 5);
-  
-class myWSPRLog : public WSPRLog {
-public:
-  myWSPRLog() : WSPRLog() {
-    total_reports = 0; 
-    for(int tbucket = 0; tbucket < NUM_TIME_BUCKETS; tbucket++) {
-      for(int azbucket = 0; azbucket < NUM_AZ_BUCKETS; azbucket++) {
-	histo[tbucket][azbucket] = 0; 
-      }
-    }
-  }
-
-
-  bool processEntry(WSPRLogEntry * ent) {
-    int x, y; 
-    
-
-    if(ent == NULL) return false; 
-
-    SolarTime tx_time(ent->dtime, ent->txgrid);
-    SolarTime rx_time(ent->dtime, ent->rxgrid);    
-    float mid_hour = TimeCorr::circularMean(24.0, tx_time.getFHour(), rx_time.getFHour());
-    bump(mid_hour, ent->az); 
-    return false;
-  }
-
-  void bump(float t_hour, float az) {
-    // quantize into 10 minute buckets
-    int time_bucket = ((int) floor(t_hour * 6.0));
-    // quantize into 5 degree segments
-    int az_bucket = (int) (az / 5.0); 
-    if(time_bucket >= NUM_TIME_BUCKETS) time_bucket = (NUM_TIME_BUCKETS - 1);
-    if(az_bucket >= NUM_AZ_BUCKETS) az_bucket = (NUM_AZ_BUCKETS - 1);    
-    histo[time_bucket][az_bucket]++;
-    total_reports++; 
-  }
-
-  void writeReport(const std::string & out_name) {
-    std::ofstream os(out_name);    
-    float rscale = 1.0 / ((float) total_reports); 
-
-    for(int tbucket = 0; tbucket < NUM_TIME_BUCKETS; tbucket++) {
-      for(int azbucket = 0; azbucket < NUM_AZ_BUCKETS; azbucket++) {
-	float val = (float) histo[tbucket][azbucket]; 
-	val = val * rscale; 
-	os << boost::format("%d %d %f\n")
-	  % (tbucket * 10) % (azbucket * 5) % val; 
-      }
-    }
-    os.close();
-  }
-
-private:
-  int histo[NUM_TIME_BUCKETS][NUM_AZ_BUCKETS]; 
-  int total_reports; 
-}; 
-
 int main(int argc, char * argv[])
 {
   std::string in_name, out_name, x_field_selector, y_field_selector;
   bool input_gzipped; 
+  int num_threads; 
   namespace po = boost::program_options;
 
 
@@ -87,6 +27,7 @@ int main(int argc, char * argv[])
     ("help", "help message")
     ("in", po::value<std::string>(&in_name)->required(), "Input log file (csv) in WSPR log format")
     ("out", po::value<std::string>(&out_name)->required(), "Output data file")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of worker threads")
     ("igz", po::value<bool>(&input_gzipped)->default_value(false), "if true, input file is gzip compressed");
   
   po::positional_options_description pos_opts ;
@@ -122,9 +63,10 @@ int main(int argc, char * argv[])
     exit(-1);        
   }
 
-  myWSPRLog wlog;
+  WSPRLog wlog;
+  SolAzHistoAnalysis acc; 
 
-  wlog.readLog(in_name, input_gzipped);
+  wlog.readLog(in_name, input_gzipped, acc, num_threads);
 
-  wlog.writeReport(out_name); 
+  acc.report(out_name); 
 }
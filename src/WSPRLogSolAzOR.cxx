@@ -1,6 +1,8 @@
 #include "WSPRLog.hxx"
 #include "SolarTime.hxx"
 #include "TimeCorr.hxx"
+#include "DenseHistogram.hxx"
+#include "OddsRatio.hxx"
 
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
@@ -13,70 +15,73 @@
 #include <list>
 #include <math.h>
 #include <set>
+#include <vector>
 
 // plot distance, azimuth pairs.
-const int NUM_TIME_BUCKETS = (24 * 10);
-const int NUM_AZ_BUCKETS = (360 / 5);
-  
-class myWSPRLog : public WSPRLog {
+// 6 minute time buckets, 5 degree azimuth segments
+typedef HistoAxis<(24 * 10), 0, 1, 10> TimeAxis; 
+typedef HistoAxis<(360 / 5), 0, 5> AzAxis; 
+
+class myAccumulator : public WSPRLogAccumulator {
 public:
-  myWSPRLog() : WSPRLog() {
+  myAccumulator(int _mode_index = 0) {
     total_reports[0] = 0;
     total_reports[1] = 0;     
-    mode_index = 0; 
-    for(int tbucket = 0; tbucket < NUM_TIME_BUCKETS; tbucket++) {
-      for(int azbucket = 0; azbucket < NUM_AZ_BUCKETS; azbucket++) {
-	histo[0][tbucket][azbucket] = 0;
-	histo[1][tbucket][azbucket] = 0; 	
-      }
+    skipped = 0; 
+    mode_index = _mode_index; 
+  }
+
+  WSPRLogAccumulator * clone() const { return new myAccumulator(mode_index); }
+
+  void merge(const WSPRLogAccumulator & other) {
+    const myAccumulator & o = static_cast<const myAccumulator &>(other); 
+    for(int m = 0; m < 2; m++) {
+      histo[m].merge(o.histo[m]); 
+      total_reports[m] += o.total_reports[m]; 
     }
+    skipped += o.skipped; 
   }
 
   void setExcMode(bool fl) {
+    // spots already in the block belong to the old mode
+    flushBlock(); 
     mode_index = fl ? 1 : 0; 
   }
 
-  bool processEntry(WSPRLogEntry * ent) {
-    int x, y; 
-    
+  void add(WSPRLogEntry * ent) {
+    if(!sol_block.add(ent->dtime, ent->txgrid, ent->rxgrid)) {
+      skipped++; 
+      return; 
+    }
+    block_az.push_back(ent->az); 
+    if(sol_block.full()) flushBlock(); 
+  }
 
-    if(ent == NULL) return false; 
+  void flush() { flushBlock(); }
 
-    SolarTime tx_time(ent->dtime, ent->txgrid);
-    SolarTime rx_time(ent->dtime, ent->rxgrid);    
-    float mid_hour = TimeCorr::circularMean(24.0, tx_time.getFHour(), rx_time.getFHour());
-    bump(mid_hour, ent->az); 
-    return false;
-  }
+  void flushBlock() {
+    if(sol_block.empty()) return; 
 
+    sol_block.compute(); 
+    size_t n = sol_block.size(); 
+    block_hour.assign(sol_block.mid_hour.begin(), sol_block.mid_hour.end()); 
+    histo[mode_index].addBatch(n, block_hour.data(), block_az.data()); 
+    total_reports[mode_index] += n; 
 
-  void bump(float t_hour, float az) {
-    // quantize into 10 minute buckets
-    int time_bucket = ((int) floor(t_hour * 10.0));
-    // quantize into 5 degree segments
-    int az_bucket = (int) (az / 5.0); 
-    if(time_bucket >= NUM_TIME_BUCKETS) time_bucket = (NUM_TIME_BUCKETS - 1);
-    if(az_bucket >= NUM_AZ_BUCKETS) az_bucket = (NUM_AZ_BUCKETS - 1);    
-    histo[mode_index][time_bucket][az_bucket]++;
-    total_reports[mode_index]++; 
+    sol_block.clear(); 
+    block_az.clear(); 
   }
 
+  // one 6 minute bucket per cell, so each cell has the same odds ratio
+  // as in the window report
   void writeReport(const std::string & out_name) {
+    flushBlock(); 
     std::ofstream os(out_name);    
-    float count_ratio = ((float) total_reports[0]) / ((float) total_reports[1]); 
-
-    for(int tbucket = 0; tbucket < NUM_TIME_BUCKETS; tbucket++) {
-      for(int azbucket = 0; azbucket < NUM_AZ_BUCKETS; azbucket++) {
-	float exc_val = (float) histo[1][tbucket][azbucket];
-	float std_val = (float) histo[0][tbucket][azbucket]; 	
-
-        float De = exc_val; 
-	float He = std_val - exc_val; 
-	float OR;
-	float soltime = ((float) tbucket) / 10.0;
-	  
-	if(He > 0.0) OR = (De / He) * count_ratio; 
-	else OR = 0.0; 
+    WindowOR wor = makeOR(); 
+
+    for(int tbucket = 0; tbucket < TimeAxis::BINS; tbucket++) {
+      for(int azbucket = 0; azbucket < AzAxis::BINS; azbucket++) {
+	double OR = wor.estimate(azbucket, tbucket, 1).OR; 
 	os << boost::format("%5.2f %d %f\n")
 	  % (tbucket / 10.0) % (azbucket * 5) % OR; 
       }
@@ -84,8 +89,56 @@ public:
     os.close();
   }
 
+  // odds ratios over windows of width time buckets, every stride
+  // buckets, wrapping around the day, for each azimuth segment
+  void writeWindowReport(const std::string & out_name, size_t width, size_t stride,
+			 WindowOR::Interval interval, double conf, int resamples, uint64_t seed) {
+    flushBlock(); 
+    WindowOR wor = makeOR(); 
+
+    std::ofstream os(out_name); 
+    const char * interval_names[] = { "Wald", "exact", "bootstrap" }; 
+    os << boost::format("# %d minute windows every %d minutes, %g %s intervals\n")
+      % (width * 6) % (stride * 6) % conf % interval_names[interval]; 
+    os << "# solar hour (window center), azimuth, OR, lo, hi, image reports, other reports\n"; 
+    for(size_t start = 0; start < TimeAxis::BINS; start += stride) {
+      double center = fmod((((double) start) + 0.5 * ((double) width)) / 10.0, 24.0); 
+      for(int azbucket = 0; azbucket < AzAxis::BINS; azbucket++) {
+	WindowOR::Estimate est = wor.estimate(azbucket, start, width, interval, conf, resamples, seed); 
+	os << boost::format("%5.2f %d %f %f") % center % (azbucket * 5) % est.OR % est.lo; 
+	// - for no upper limit
+	if(est.bounded) os << boost::format(" %f") % est.hi; 
+	else os << " -"; 
+	os << boost::format(" %d %d\n") % est.De % est.He; 
+      }
+    }
+    os.close(); 
+  }
+
+  // spots with a grid that didn't decode
+  uint64_t skipped; 
+
 private:
-  int histo[2][NUM_TIME_BUCKETS][NUM_AZ_BUCKETS]; 
+  // odds ratios by azimuth (rows) and time: the exceptional reports
+  // against the day's odds of one
+  WindowOR makeOR() const {
+    // the windows slide along time, so time is the fast axis here
+    std::vector<uint64_t> all(AzAxis::BINS * TimeAxis::BINS), exc(AzAxis::BINS * TimeAxis::BINS); 
+    for(int azbucket = 0; azbucket < AzAxis::BINS; azbucket++) {
+      for(int tbucket = 0; tbucket < TimeAxis::BINS; tbucket++) {
+	all[azbucket * TimeAxis::BINS + tbucket] = histo[0].at(tbucket, azbucket); 
+	exc[azbucket * TimeAxis::BINS + tbucket] = histo[1].at(tbucket, azbucket); 
+      }
+    }
+    // the exceptional reports are in the full log too
+    return WindowOR(TimeAxis::BINS, AzAxis::BINS, all, exc, 
+		    (double) total_reports[1], (double) (total_reports[0] - total_reports[1])); 
+  }
+
+  SolarTimeBlock sol_block; 
+  // the histogram bins in double, as it always has
+  std::vector<double> block_hour, block_az; 
+  DenseHistogram<TimeAxis, AzAxis> histo[2]; 
   int total_reports[2]; 
   int mode_index; 
 }; 
@@ -93,7 +146,13 @@ private:
 int main(int argc, char * argv[])
 {
   std::string std_name, exc_name, report_name; 
+  std::string window_name, interval_name; 
+  int window_minutes, stride_minutes; 
+  double conf; 
+  int resamples; 
+  uint64_t seed; 
   bool input_gzipped; 
+  int num_threads; 
   namespace po = boost::program_options;
 
 
@@ -104,6 +163,14 @@ int main(int argc, char * argv[])
     ("standard", po::value<std::string>(&std_name)->required(), "WSPR log for baseline reports")
     ("exception", po::value<std::string>(&exc_name)->required(), "WSPR log for baseline reports")
     ("report", po::value<std::string>(&report_name)->required(), "Output data file containing calls, and risk ratios")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of worker threads")
+    ("window_report", po::value<std::string>(&window_name), "Also write odds ratios with confidence intervals for sliding time windows to this file")
+    ("window", po::value<int>(&window_minutes)->default_value(60), "Window width in minutes (a multiple of 6), for --window_report")
+    ("stride", po::value<int>(&stride_minutes)->default_value(0), "Minutes from one window to the next (0 for the window width), for --window_report")
+    ("interval", po::value<std::string>(&interval_name)->default_value("wald"), "Confidence interval: wald, exact, or bootstrap, for --window_report")
+    ("conf", po::value<double>(&conf)->default_value(0.95), "Confidence level, for --window_report")
+    ("resamples", po::value<int>(&resamples)->default_value(1000), "Resamples per window, for --interval bootstrap")
+    ("seed", po::value<uint64_t>(&seed)->default_value(1), "Random seed, for --interval bootstrap")
     ("igz", po::value<bool>(&input_gzipped)->default_value(false), "if true, input file is gzip compressed");
   
   po::positional_options_description pos_opts ;
@@ -140,12 +207,33 @@ int main(int argc, char * argv[])
     exit(-1);        
   }
 
-  myWSPRLog wlog;
+  WindowOR::Interval interval; 
+  if(interval_name == "wald") interval = WindowOR::WALD; 
+  else if(interval_name == "exact") interval = WindowOR::EXACT; 
+  else if(interval_name == "bootstrap") interval = WindowOR::BOOTSTRAP; 
+  else {
+    std::cerr << "ERROR: interval must be one of wald, exact, or bootstrap" << std::endl; 
+    exit(-1); 
+  }
+  if(stride_minutes <= 0) stride_minutes = window_minutes; 
+  if((window_minutes < 6) || ((window_minutes % 6) != 0) || ((stride_minutes % 6) != 0)) {
+    std::cerr << "ERROR: window and stride must be multiples of the 6 minute time buckets" << std::endl; 
+    exit(-1); 
+  }
+
+  WSPRLog wlog;
+  myAccumulator acc; 
 
-  wlog.setExcMode(true);
-  wlog.readLog(exc_name, input_gzipped);
-  wlog.setExcMode(false);
-  wlog.readLog(std_name, input_gzipped);  
+  acc.setExcMode(true);
+  wlog.readLog(exc_name, input_gzipped, acc, num_threads);
+  acc.setExcMode(false);
+  wlog.readLog(std_name, input_gzipped, acc, num_threads);  
     
-  wlog.writeReport(report_name); 
+  acc.writeReport(report_name); 
+  if(acc.skipped) {
+    std::cerr << boost::format("Skipped %d spots with a malformed rx or tx grid\n") % acc.skipped; 
+  }
+  if(vm.count("window_report")) {
+    acc.writeWindowReport(window_name, window_minutes / 6, stride_minutes / 6, interval, conf, resamples, seed); 
+  }
 }
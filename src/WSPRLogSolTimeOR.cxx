@@ -1,6 +1,9 @@
 #include "WSPRLog.hxx"
 #include "SolarTime.hxx"
 #include "TimeCorr.hxx"
+#include "Terminator.hxx"
+#include "DenseHistogram.hxx"
+#include "WSPRLogPartial.hxx"
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
 #include <string>
@@ -23,55 +26,70 @@ const int MINUTES_PER_BUCKET = 2;
 const int BUCKETS_PER_TABLE = ((24 * 60) / MINUTES_PER_BUCKET);
 const int BUCKETS_PER_HOUR = (60 / MINUTES_PER_BUCKET);
 
-class myWSPRLog : public WSPRLog {
+// [0] is standard, [1] is exception
+typedef HistoAxis<2, 0, 1> ModeAxis; 
+typedef HistoAxis<BUCKETS_PER_TABLE, 0, 1, BUCKETS_PER_HOUR, HISTO_WRAP> HourAxis; 
+typedef DenseHistogram<ModeAxis, HourAxis> HourHisto; 
+
+class myAccumulator : public WSPRLogAccumulator {
 public:
-  myWSPRLog() : WSPRLog() {
-    exc_mode = false;
+  // what the hour in each table is measured from
+  enum TimeBase { SOLAR, SUNRISE, SUNSET }; 
+
+  myAccumulator(TimeBase _time_base = SOLAR, bool _exc_mode = false) {
+    exc_mode = _exc_mode;
+    time_base = _time_base; 
     initCounts();
   }
 
-  ~myWSPRLog() {
+  WSPRLogAccumulator * clone() const { return new myAccumulator(time_base, exc_mode); }
+
+  void merge(const WSPRLogAccumulator & other) {
+    const myAccumulator & o = static_cast<const myAccumulator &>(other); 
+    for(int m = 0; m < 2; m++) {
+      rx_counts[m] += o.rx_counts[m]; 
+      tx_counts[m] += o.tx_counts[m]; 
+      mid_counts[m] += o.mid_counts[m]; 
+    }
+    rx_histo.merge(o.rx_histo); 
+    tx_histo.merge(o.tx_histo); 
+    mid_histo.merge(o.mid_histo); 
+    skipped += o.skipped; 
   }
 
   enum Position { RX, TX, MID };
   // counts [0] is standard, [1] is exception
   unsigned int rx_counts[2], tx_counts[2], mid_counts[2]; 
 
-  std::vector<unsigned int> rx_histo[2];
-  std::vector<unsigned int> tx_histo[2];
-  std::vector<unsigned int> mid_histo[2];
+  HourHisto rx_histo, tx_histo, mid_histo; 
+  // spots with a grid that didn't decode
+  uint64_t skipped; 
 
   void initCounts() {
+    skipped = 0; 
     rx_counts[0] = rx_counts[1] = 0;
     tx_counts[0] = tx_counts[1] = 0;    
     mid_counts[0] = mid_counts[1] = 0;    
 
-    for(int m = 0; m < 2; m++) {
-      rx_histo[m].resize(BUCKETS_PER_TABLE, 0);
-      tx_histo[m].resize(BUCKETS_PER_TABLE, 0);
-      mid_histo[m].resize(BUCKETS_PER_TABLE, 0);            
-    }
+    rx_histo.clear(); 
+    tx_histo.clear(); 
+    mid_histo.clear(); 
   }
 
   void bump(Position pos, float hour) {
     int mode = exc_mode ? 1 : 0; 
-    int tim = (int) (floor(hour * ((float) BUCKETS_PER_HOUR)));
-    if(tim > BUCKETS_PER_TABLE) {
-      std::cerr << boost::format(" hour = %f  Time index is %d. How did that happen?\n") % hour % tim; 
-      exit(-1);
-    }
 
     switch (pos) {
     case RX:
-      rx_histo[mode][tim]++; 
+      rx_histo.add(mode, hour); 
       rx_counts[mode]++; 
       break; 
     case TX:
-      tx_histo[mode][tim]++; 
+      tx_histo.add(mode, hour); 
       tx_counts[mode]++; 
       break; 
     case MID:
-      mid_histo[mode][tim]++; 
+      mid_histo.add(mode, hour); 
       mid_counts[mode]++; 
       break; 
     }
@@ -79,114 +97,124 @@ public:
 
 
 
-  void setExcMode(bool fl) { exc_mode = fl; }
-
-  bool processEntry(WSPRLogEntry * ent) {
-    if(ent == NULL) return false; 
-    
-    // calculate solar time for rx, tx, and midpoint 
-    SolarTime tx_time(ent->dtime, ent->txgrid);
-    SolarTime rx_time(ent->dtime, ent->rxgrid);    
-    float mid_hour = TimeCorr::circularMean(24.0, tx_time.getFHour(), rx_time.getFHour());
+  void setExcMode(bool fl) { 
+    // spots already in the block belong to the old mode
+    flushBlock(); 
+    exc_mode = fl; 
+  }
 
-    bump(RX, rx_time.getFHour());
-    bump(TX, tx_time.getFHour());
-    bump(MID, mid_hour);
+  void add(WSPRLogEntry * ent) {
+    if(time_base != SOLAR) {
+      bumpSun(ent); 
+      return; 
+    }
 
-    return false;
+    // solar times are worked out a block of spots at a time
+    if(!sol_block.add(ent->dtime, ent->txgrid, ent->rxgrid)) skipped++; 
+    else if(sol_block.full()) flushBlock(); 
   }
 
-// accumulate number of reports per solar hour for a
-// image and normal log reports.  Print the odds ratio
-//  associated with each hour of the day for
-// solar time at the receiver, transmitter, and halfway point
-// 
-// That is OR = [(events at time = T) * (non-events over 24 hours)] /
-//              [(events in 24 hours) * (non-events at time = T)]
-// 
-
-  void calcOR(Position pos, std::vector<float> & ort) {
-    std::vector<unsigned int> exc_histo;
-    std::vector<unsigned int> norm_histo;
-    float exc_count;
-    float norm_count; 
-    for(int i = 0; i < BUCKETS_PER_TABLE; i++) {
-      ort.push_back(0.0);
+  void flush() { flushBlock(); }
+
+  // hours since sunrise (or sunset).  Spots where the sun doesn't rise
+  // or set that day don't make it into the table. 
+  void bumpSun(WSPRLogEntry * ent) {
+    Terminator::SunDay rx_day = term.gridDay(ent->dtime, ent->rxgrid); 
+    Terminator::SunDay tx_day = term.gridDay(ent->dtime, ent->txgrid); 
+    Terminator::SunDay mid_day = term.midpointDay(ent->dtime, ent->txgrid, ent->rxgrid); 
+    if((rx_day.state == Terminator::SunDay::NO_PLACE) || 
+       (tx_day.state == Terminator::SunDay::NO_PLACE)) {
+      skipped++; 
+      return; 
     }
 
-    switch (pos) {
-    case RX:
-      exc_histo = rx_histo[1]; 
-      norm_histo = rx_histo[0]; 
-      exc_count = (float) rx_counts[1];
-      norm_count = (float) (rx_counts[0] - rx_counts[1]) ;
-      break; 
-    case TX:
-      exc_histo = tx_histo[1]; 
-      norm_histo = tx_histo[0]; 
-      exc_count = (float) tx_counts[1];
-      norm_count = (float) (tx_counts[0] - tx_counts[1]) ;
-      break; 
-    case MID:
-      exc_histo = mid_histo[1]; 
-      norm_histo = mid_histo[0]; 
-      exc_count = (float) mid_counts[1];
-      norm_count = (float) (mid_counts[0] - mid_counts[1]) ;
-      break; 
+    float rx_hour, tx_hour, mid_hour; 
+    if(time_base == SUNRISE) {
+      rx_hour = Terminator::hoursSinceRise(ent->dtime, rx_day); 
+      tx_hour = Terminator::hoursSinceRise(ent->dtime, tx_day); 
+      mid_hour = Terminator::hoursSinceRise(ent->dtime, mid_day); 
+    }
+    else {
+      rx_hour = Terminator::hoursSinceSet(ent->dtime, rx_day); 
+      tx_hour = Terminator::hoursSinceSet(ent->dtime, tx_day); 
+      mid_hour = Terminator::hoursSinceSet(ent->dtime, mid_day); 
     }
 
-    for(int i = 0; i < BUCKETS_PER_TABLE; i++) {
-      float De = (float) exc_histo[i]; 
-      float He = (float) (norm_histo[i] - exc_histo[i]);
+    if(rx_hour >= 0.0) bump(RX, rx_hour);
+    if(tx_hour >= 0.0) bump(TX, tx_hour);
+    if(mid_hour >= 0.0) bump(MID, mid_hour);
+  }
 
-      ort[i] = (De * norm_count) / (He * exc_count);
+  void flushBlock() {
+    if(sol_block.empty()) return; 
+    
+    // calculate solar time for rx, tx, and midpoint 
+    sol_block.compute();
+    for(size_t i = 0; i < sol_block.size(); i++) {
+      bump(RX, sol_block.rx_hour[i]);
+      bump(TX, sol_block.tx_hour[i]);
+      bump(MID, sol_block.mid_hour[i]);
     }
+    sol_block.clear(); 
   }
 
-  void dumpTables(const std::string & fname) {
-
-    std::ofstream os(fname); 
-
-    std::vector<float> rx_or, tx_or, mid_or; 
-    calcOR(RX, rx_or);
-    calcOR(TX, tx_or);
-    calcOR(MID, mid_or);
+  // the raw counts, for the report or a partial file.  The odds
+  // ratios are worked out from these by WSPRLogReport::solTimeOR.
+  void toPartial(WSPRLogPartial & part) {
+    flushBlock(); 
 
-    // we go by quarter hour.  
-    os << "# solar hour, rximage reports, rxall reports, tximage reps, txall reps, midimage reps, imgall reps, rxOR, txOR, midOR\n";
-
-    for(int i = 0; i < BUCKETS_PER_TABLE; i++) {
-      os << boost::format("%5.2f, ") % (((float) (i * MINUTES_PER_BUCKET)) / 60.0);
-      os << boost::format(" %8d, %8d, %8d, %8d, %8d, %8d, ") 
-	% rx_histo[1][i] % rx_histo[0][i] 
-	% tx_histo[1][i] % tx_histo[0][i]
-	% mid_histo[1][i] % mid_histo[0][i];
-
-      os << boost::format("%g, %g, %g\n")
-	% rx_or[i] % tx_or[i] % mid_or[i]; 
+    const HourHisto * histos[] = { &rx_histo, &tx_histo, &mid_histo }; 
+    const char * names[] = { "rx", "tx", "mid" }; 
+    for(int p = 0; p < 3; p++) {
+      std::vector<uint64_t> & tbl = part.dense(names[p], { 2, BUCKETS_PER_TABLE }); 
+      for(size_t i = 0; i < HourHisto::SIZE; i++) tbl[i] = (*histos[p])[i]; 
     }
 
-    os.close();
+    // rx, tx, mid by mode
+    std::vector<uint64_t> & counts = part.dense("counts", { 3, 2 }); 
+    for(int m = 0; m < 2; m++) {
+      counts[m] = rx_counts[m]; 
+      counts[2 + m] = tx_counts[m]; 
+      counts[4 + m] = mid_counts[m]; 
+    }
   }
 
 private:
+  SolarTimeBlock sol_block; 
+  Terminator term; 
+  TimeBase time_base; 
   bool exc_mode; 
 }; 
 
 int main(int argc, char * argv[])
 {
   bool input_gzipped; 
-  std::string std_name, exc_name, report_name; 
+  int num_threads; 
+  std::string std_name, exc_name, report_name, time_base_name, partial_name; 
+  std::string window_name, interval_name; 
+  double window_minutes, stride_minutes, conf; 
+  int resamples; 
+  uint64_t seed; 
   namespace po = boost::program_options;
 
   po::options_description desc("Options:");
 
   desc.add_options()
     ("help", "help message")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of worker threads")
+    ("partial", po::value<std::string>(&partial_name), "Also save the raw counts to this file, for WSPRLogMerge")
     ("igz", po::value<bool>(&input_gzipped)->default_value(false), "if true, input file is gzip compressed")    
     ("standard", po::value<std::string>(&std_name)->required(), "WSPR log for baseline reports")
     ("exception", po::value<std::string>(&exc_name)->required(), "WSPR log for baseline reports")
-    ("report", po::value<std::string>(&report_name)->required(), "Output data file containing calls, and risk ratios");
+    ("report", po::value<std::string>(&report_name)->required(), "Output data file containing calls, and risk ratios")
+    ("time_base", po::value<std::string>(&time_base_name)->default_value("solar"), "measure time as solar hour (solar), hours since sunrise (sunrise), or hours since sunset (sunset)")
+    ("window_report", po::value<std::string>(&window_name), "Also write odds ratios with confidence intervals for sliding windows to this file")
+    ("window", po::value<double>(&window_minutes)->default_value(60.0), "Window width in minutes, for --window_report")
+    ("stride", po::value<double>(&stride_minutes)->default_value(0.0), "Minutes from one window to the next (0 for the window width), for --window_report")
+    ("interval", po::value<std::string>(&interval_name)->default_value("wald"), "Confidence interval: wald, exact, or bootstrap, for --window_report")
+    ("conf", po::value<double>(&conf)->default_value(0.95), "Confidence level, for --window_report")
+    ("resamples", po::value<int>(&resamples)->default_value(1000), "Resamples per window, for --interval bootstrap")
+    ("seed", po::value<uint64_t>(&seed)->default_value(1), "Random seed, for --interval bootstrap");
   
   po::positional_options_description pos_opts ;
   pos_opts.add("standard", 1);
@@ -223,13 +251,40 @@ int main(int argc, char * argv[])
 
 
 
-  myWSPRLog wlog;
+  myAccumulator::TimeBase time_base; 
+  if(time_base_name == "solar") time_base = myAccumulator::SOLAR; 
+  else if(time_base_name == "sunrise") time_base = myAccumulator::SUNRISE; 
+  else if(time_base_name == "sunset") time_base = myAccumulator::SUNSET; 
+  else {
+    std::cerr << "ERROR: time_base must be one of solar, sunrise, or sunset" << std::endl; 
+    exit(-1); 
+  }
+  WindowOR::Interval interval; 
+  if(interval_name == "wald") interval = WindowOR::WALD; 
+  else if(interval_name == "exact") interval = WindowOR::EXACT; 
+  else if(interval_name == "bootstrap") interval = WindowOR::BOOTSTRAP; 
+  else {
+    std::cerr << "ERROR: interval must be one of wald, exact, or bootstrap" << std::endl; 
+    exit(-1); 
+  }
+  if(stride_minutes <= 0.0) stride_minutes = window_minutes; 
 
-  wlog.setExcMode(true);
-  wlog.readLog(exc_name, input_gzipped);
+  WSPRLog wlog; 
+  myAccumulator acc(time_base);
+
+  acc.setExcMode(true);
+  wlog.readLog(exc_name, input_gzipped, acc, num_threads);
   
-  wlog.setExcMode(false);
-  wlog.readLog(std_name, input_gzipped);
+  acc.setExcMode(false);
+  wlog.readLog(std_name, input_gzipped, acc, num_threads);
   
-  wlog.dumpTables(report_name);
+  WSPRLogPartial part("SolTimeOR", "time_base=" + time_base_name); 
+  acc.toPartial(part); 
+  if(acc.skipped) {
+    std::cerr << boost::format("Skipped %d spots with a malformed rx or tx grid\n") % acc.skipped; 
+  }
+  WSPRLogReport::solTimeOR(part, report_name);
+  if(vm.count("window_report") && 
+     !WSPRLogReport::solTimeORWindows(part, window_name, window_minutes, stride_minutes, interval, conf, resamples, seed)) exit(-1); 
+  if(vm.count("partial") && !part.write(partial_name)) exit(-1); 
 }
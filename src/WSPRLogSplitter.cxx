@@ -14,6 +14,12 @@ public:
   myWSPRLog(const std::string outf_base_name): WSPRLog() {
     buildBandList(outf_base_name); 
     distance_threshold = 100; 
+
+    // skip short paths and out-of-band lines before they get parsed
+    for(auto bfe: band_list) {
+      addPreFilter(WSPRLogEntry::FREQ, bfe->lo, bfe->hi); 
+    }
+    addPreFilter(WSPRLogEntry::DIST, distance_threshold, HUGE_VAL); 
   }
 
 
@@ -0,0 +1,327 @@
+#include "CountHistogram.hxx"
+#include "ChiSquared.hxx"
+#include "KolmogorovSmirnov.hxx"
+
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/math/distributions/normal.hpp>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+
+// Compare many standard/experiment histogram pairs in one run -- each
+// band, rx/tx/mid position, field ... -- instead of a ChiSquaredTest,
+// KSTest and RiskRatio per pair.  The pairs come from a file, one per
+// line:
+//
+//   # name        standard             experiment
+//   20m_rx        20m.part:rx:0        20m.part:rx:1
+//   30m_snr       30m_all.hist         30m_img.hist
+//
+// or from --pair NAME,STANDARD,EXPERIMENT.  A histogram is anything
+// CountHistogram::read takes (text, binary, or partial:table:row).
+// The pairs are dealt out to the threads, and then the p values of
+// each test are corrected for the number of pairs (Holm or
+// Benjamini-Hochberg) before the one table is written.
+
+class ScanPair {
+public:
+  std::string name, S_spec, X_spec;
+  CountHistogram S, X;
+
+  uint64_t n, m;
+  // false if either histogram is empty: no tests, and the pair
+  // doesn't count in the correction
+  bool valid;
+  double X2, chi_p, chi_p_adj;
+  KolmogorovSmirnov::Result ks;
+  double ks_p_adj;
+  // the risk ratio (pdf(X) / pdf(S)) in the buckets where it is
+  // highest and lowest, with its confidence interval.  rr_valid is
+  // false if no bucket has counts on both sides.
+  bool rr_valid;
+  double rr_max, rr_max_at, rr_max_lo, rr_max_hi;
+  double rr_min, rr_min_at, rr_min_lo, rr_min_hi;
+};
+
+static void riskRatios(ScanPair & pr, double z)
+{
+  pr.rr_valid = false;
+  pr.rr_max = pr.rr_min = 0.0;
+  pr.rr_max_at = pr.rr_min_at = 0.0;
+  pr.rr_max_lo = pr.rr_max_hi = pr.rr_min_lo = pr.rr_min_hi = 0.0;
+  if(!pr.valid) return;
+
+  double fn = (double) pr.n;
+  double fm = (double) pr.m;
+  double norm = fm / fn;
+  for(size_t i = 0; i < pr.S.size(); i++) {
+    // no ratio (or interval) without counts on both sides
+    if((pr.S[i] == 0) || (pr.X[i] == 0)) continue;
+    double s = (double) pr.S[i];
+    double x = (double) pr.X[i];
+    double rr = (x / s) / norm;
+    // Katz: log(rr) is about normal
+    double se = sqrt(1.0 / x - 1.0 / fm + 1.0 / s - 1.0 / fn);
+    double lo = rr * exp(-z * se);
+    double hi = rr * exp(z * se);
+    if(!pr.rr_valid || (rr > pr.rr_max)) {
+      pr.rr_max = rr;
+      pr.rr_max_at = pr.S.binLow(i);
+      pr.rr_max_lo = lo;
+      pr.rr_max_hi = hi;
+    }
+    if(!pr.rr_valid || (rr < pr.rr_min)) {
+      pr.rr_min = rr;
+      pr.rr_min_at = pr.S.binLow(i);
+      pr.rr_min_lo = lo;
+      pr.rr_min_hi = hi;
+    }
+    pr.rr_valid = true;
+  }
+}
+
+static void scanPair(ScanPair & pr, KolmogorovSmirnov::Method method, double z)
+{
+  pr.n = pr.S.total();
+  pr.m = pr.X.total();
+  pr.valid = (pr.n != 0) && (pr.m != 0);
+  riskRatios(pr, z);
+  if(!pr.valid) return;
+
+  pr.X2 = ChiSquared::pearsonCTS(pr.S.counts, pr.X.counts, false);
+  // counts where the standard has none: no chance they're the same
+  pr.chi_p = ChiSquared::impossible(pr.S.counts, pr.X.counts) ? 0.0 :
+    ChiSquared::significance(pr.X2, pr.S.size());
+  pr.ks = KolmogorovSmirnov::histograms(pr.S.counts, pr.X.counts, method);
+}
+
+// adjusted p values, in the order given.  Only the valid pairs are
+// counted (or sorted); the rest keep p as it was.
+static void adjustP(const std::vector<double> & p, const std::vector<bool> & valid,
+		    const std::string & correction, std::vector<double> & adj)
+{
+  adj = p;
+  if(correction == "none") return;
+
+  std::vector<size_t> order;
+  for(size_t i = 0; i < p.size(); i++) {
+    if(valid[i]) order.push_back(i);
+  }
+  std::sort(order.begin(), order.end(),
+	    [&p](size_t a, size_t b) { return p[a] < p[b]; });
+  double tests = (double) order.size();
+
+  if(correction == "holm") {
+    // step down: the j'th smallest is compared with alpha / (tests - j)
+    double run_max = 0.0;
+    for(size_t j = 0; j < order.size(); j++) {
+      double v = std::min(1.0, (tests - ((double) j)) * p[order[j]]);
+      run_max = std::max(run_max, v);
+      adj[order[j]] = run_max;
+    }
+  }
+  else {
+    // Benjamini-Hochberg, step up from the largest
+    double run_min = 1.0;
+    for(size_t j = order.size(); j > 0; j--) {
+      double v = std::min(1.0, (tests / ((double) j)) * p[order[j - 1]]);
+      run_min = std::min(run_min, v);
+      adj[order[j - 1]] = run_min;
+    }
+  }
+}
+
+static bool readPairs(const std::string & fname, std::vector<ScanPair> & pairs)
+{
+  std::ifstream is(fname);
+  if(!is.is_open()) {
+    std::cerr << boost::format("Could not open pair file [%s].\n") % fname;
+    return false;
+  }
+  std::string line;
+  int line_num = 0;
+  while(std::getline(is, line)) {
+    line_num++;
+    boost::trim(line);
+    if(line.empty() || (line[0] == '#')) continue;
+    std::istringstream ls(line);
+    ScanPair pr;
+    if(!(ls >> pr.name >> pr.S_spec >> pr.X_spec)) {
+      std::cerr << boost::format("%s line %d: expected name, standard, and experiment.\n")
+	% fname % line_num;
+      return false;
+    }
+    pairs.push_back(pr);
+  }
+  return true;
+}
+
+int main(int argc, char * argv[])
+{
+  std::string pairs_fname, out_fname;
+  std::vector<std::string> pair_specs;
+  std::string method_name, correction;
+  double conf;
+  int num_threads;
+
+  namespace po = boost::program_options;
+
+  po::options_description desc("Options:");
+  desc.add_options()
+    ("help", "help message")
+    ("pairs", po::value<std::string>(&pairs_fname), "File of pairs to compare, one \"name standard experiment\" per line")
+    ("pair", po::value<std::vector<std::string> >(&pair_specs), "A pair to compare, as NAME,STANDARD,EXPERIMENT.  May be given more than once.")
+    ("out", po::value<std::string>(&out_fname)->default_value("-"), "Output table (- for stdout)")
+    ("correction", po::value<std::string>(&correction)->default_value("holm"), "Multiple comparison correction: holm, bh (Benjamini-Hochberg), or none")
+    ("method", po::value<std::string>(&method_name)->default_value("auto"), "KS p value: exact, asymptotic, or auto (exact if n * m <= 10^7)")
+    ("conf", po::value<double>(&conf)->default_value(0.95), "Confidence level for the risk ratio intervals")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of worker threads");
+
+  po::positional_options_description pos_opts ;
+  pos_opts.add("pairs", 1);
+  pos_opts.add("out", 1);
+
+  po::variables_map vm;
+
+  std::string what_am_i("Chi-squared, KS, and risk ratios for many standard/experiment histogram pairs\n\tWSPRLogStatScan <pair_file> [out]\n");
+
+  try {
+    po::store(po::command_line_parser(argc, argv).options(desc)
+	      .positional(pos_opts).run(), vm);
+
+    if(vm.count("help")) {
+      std::cout << what_am_i
+		<< desc << std::endl;
+      exit(-1);
+    }
+
+    po::notify(vm);
+  }
+  catch(po::required_option & e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+    std::cerr << what_am_i
+	      << desc << std::endl;
+    exit(-1);
+  }
+  catch(po::error & e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+    std::cerr << what_am_i
+	      << desc << std::endl;
+    exit(-1);
+  }
+
+  KolmogorovSmirnov::Method method;
+  if(method_name == "auto") method = KolmogorovSmirnov::AUTO;
+  else if(method_name == "exact") method = KolmogorovSmirnov::EXACT;
+  else if(method_name == "asymptotic") method = KolmogorovSmirnov::ASYMPTOTIC;
+  else {
+    std::cerr << "ERROR: method must be one of exact, asymptotic, or auto" << std::endl;
+    exit(-1);
+  }
+  if((correction != "holm") && (correction != "bh") && (correction != "none")) {
+    std::cerr << "ERROR: correction must be one of holm, bh, or none" << std::endl;
+    exit(-1);
+  }
+  if((conf <= 0.0) || (conf >= 1.0)) {
+    std::cerr << "ERROR: conf must be between 0 and 1" << std::endl;
+    exit(-1);
+  }
+
+  std::vector<ScanPair> pairs;
+  if(vm.count("pairs") && !readPairs(pairs_fname, pairs)) exit(-1);
+  for(auto & ps: pair_specs) {
+    std::vector<std::string> words;
+    boost::split(words, ps, boost::is_any_of(","));
+    if(words.size() != 3) {
+      std::cerr << boost::format("ERROR: --pair [%s] should be NAME,STANDARD,EXPERIMENT\n") % ps;
+      exit(-1);
+    }
+    ScanPair pr;
+    pr.name = words[0];
+    pr.S_spec = words[1];
+    pr.X_spec = words[2];
+    pairs.push_back(pr);
+  }
+  if(pairs.empty()) {
+    std::cerr << "ERROR: nothing to compare -- give a pair file or --pair\n";
+    std::cerr << what_am_i
+	      << desc << std::endl;
+    exit(-1);
+  }
+
+  // read everything first, so a bad spec stops us before any work
+  for(auto & pr: pairs) {
+    if(!pr.S.read(pr.S_spec) || !pr.X.read(pr.X_spec) || !pr.S.conform(pr.X, pr.S_spec, pr.X_spec)) {
+      std::cerr << boost::format("ERROR: could not read the histograms for pair [%s]\n") % pr.name;
+      exit(-1);
+    }
+  }
+
+  double z = boost::math::quantile(boost::math::normal(), 0.5 + 0.5 * conf);
+
+  if(num_threads < 1) num_threads = 1;
+  auto worker = [&](int w) {
+    for(size_t i = w; i < pairs.size(); i += num_threads) {
+      scanPair(pairs[i], method, z);
+    }
+  };
+  std::vector<std::thread> threads;
+  for(int w = 1; w < num_threads; w++) threads.push_back(std::thread(worker, w));
+  worker(0);
+  for(auto & t: threads) t.join();
+
+  std::vector<double> chi_p, ks_p, adj;
+  std::vector<bool> valid;
+  for(auto & pr: pairs) {
+    valid.push_back(pr.valid);
+    chi_p.push_back(pr.valid ? pr.chi_p : 1.0);
+    ks_p.push_back(pr.valid ? pr.ks.p_value : 1.0);
+  }
+  adjustP(chi_p, valid, correction, adj);
+  for(size_t i = 0; i < pairs.size(); i++) pairs[i].chi_p_adj = adj[i];
+  adjustP(ks_p, valid, correction, adj);
+  for(size_t i = 0; i < pairs.size(); i++) pairs[i].ks_p_adj = adj[i];
+
+  std::ofstream of;
+  if(out_fname != "-") {
+    of.open(out_fname);
+    if(!of.is_open()) {
+      std::cerr << boost::format("Could not open output file [%s].\n") % out_fname;
+      exit(-1);
+    }
+  }
+  std::ostream & os = (out_fname == "-") ? std::cout : of;
+
+  os << boost::format("# %d pairs, p values adjusted by %s, risk ratio intervals at %g\n")
+    % pairs.size() % correction % conf;
+  os << "# name n m X2 chi_p chi_p_adj D ks_p ks_p_adj ks_method"
+     << " rr_max rr_max_at rr_max_lo rr_max_hi rr_min rr_min_at rr_min_lo rr_min_hi\n";
+  // - for whatever there was nothing to compute
+  for(auto & pr: pairs) {
+    os << boost::format("%s %d %d") % pr.name % pr.n % pr.m;
+    if(pr.valid) {
+      os << boost::format(" %g %g %g %g %g %g %s")
+	% pr.X2 % pr.chi_p % pr.chi_p_adj
+	% pr.ks.D % pr.ks.p_value % pr.ks_p_adj % (pr.ks.exact ? "exact" : "asymptotic");
+    }
+    else {
+      os << " - - - - - - -";
+    }
+    if(pr.rr_valid) {
+      os << boost::format(" %g %g %g %g %g %g %g %g")
+	% pr.rr_max % pr.rr_max_at % pr.rr_max_lo % pr.rr_max_hi
+	% pr.rr_min % pr.rr_min_at % pr.rr_min_lo % pr.rr_min_hi;
+    }
+    else {
+      os << " - - - - - - - -";
+    }
+    os << "\n";
+  }
+}
@@ -1,5 +1,7 @@
 #include "WSPRLog.hxx"
-#include "SolarTime.hxx"
+#include "TimeHistoAnalysis.hxx"
+#include "WSPRLogPartial.hxx"
+#include "CountHistogram.hxx"
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
 #include <string>
@@ -9,85 +11,12 @@
 #include <math.h>
 #include <set>
 
-// accumulate number of reports per hour of the day at TX, RX, and midpoint
-class myWSPRLog : public WSPRLog {
-public:
-  myWSPRLog(const std::string & out_base_name) : WSPRLog() {
-    osrx.open(out_base_name + "_TH_rx.dat");
-    ostx.open(out_base_name + "_TH_tx.dat");
-    
-    for(int i = 0; i < 24; i++) {
-	rxhisto[i] = 0;
-	txhisto[i] = 0;
-    }
-  }
-
-  ~myWSPRLog() {
-  }
-
-
-  bool processEntry(WSPRLogEntry * ent) {
-    std::string from, to; 
-    double ft, tt, ftt; 
-    unsigned long et; 
-    double freq_diff;
-
-    if(ent == NULL) return false; 
-
-    to = ent->rxgrid;
-    from = ent->txgrid; 
-    et = ent->dtime; 
-
-    // calculate the "local time" for to, from, and midpath
-    SolarTime tx_time(et, from);
-    SolarTime rx_time(et, to);     
-
-    makeEntry(rxhisto, rx_time.getFHour());
-    makeEntry(txhisto, tx_time.getFHour());
-
-    return false;
-  }
-
-
-
-  void makeEntry(unsigned *histo, float hr) 
-  {
-    int ihr = (int) hr;
-    if(ihr > 23) ihr -= 24;
-
-    if(ihr < 0) ihr += 24; 
-
-    histo[ihr]++; 
-  }
-
-  void dumpTables() {
-    dumpTable(rxhisto, osrx);
-    dumpTable(txhisto, ostx);
-
-    osrx.close();
-    ostx.close();
-  }
-
-  void dumpTable(unsigned * histo, std::ostream & os) {
-    // first find total 
-    long total = 0;
-    long smax = 1; 
-    
-    for(int i = 0; i < 24; i++) {
-      os << histo[i] << std::endl; 
-    }
-  }
-
-private:
-  std::ofstream osrx, ostx;
-  unsigned rxhisto[24];
-  unsigned txhisto[24];
-}; 
-
 int main(int argc, char * argv[])
 {
   bool input_gzipped; 
-  std::string in_name, out_name; 
+  int num_threads; 
+  int band; 
+  std::string in_name, out_name, partial_name; 
   namespace po = boost::program_options;
 
   po::options_description desc("Options:");
@@ -96,6 +25,10 @@ int main(int argc, char * argv[])
     ("help", "help message")
     ("log", po::value<std::string>(&in_name)->required(), "Input log file (csv) in WSPR log format")
     ("out_base", po::value<std::string>(&out_name)->required(), "Output data file basename")
+    ("band", po::value<int>(&band), "Only use reports from this band (wsprnet band number, e.g. 10 for 30m)")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of worker threads")
+    ("partial", po::value<std::string>(&partial_name), "Also save the raw counts to this file, for WSPRLogMerge")
+    ("binary", "Also write the histograms as <out_base>_TH_rx.hist and <out_base>_TH_tx.hist, for the statistics tools")
     ("igz", po::value<bool>(&input_gzipped)->default_value(false), "if true, input file is gzip compressed");
   
   po::positional_options_description pos_opts ;
@@ -132,9 +65,25 @@ int main(int argc, char * argv[])
 
 
 
-  myWSPRLog wlog(out_name); 
+  WSPRLog wlog; 
+  TimeHistoAnalysis acc; 
 
-  wlog.readLog(in_name, input_gzipped);
+  // we only look at entries through getField
+  wlog.setLazyDecode(true); 
+  if(vm.count("band")) wlog.addPreFilter(WSPRLogEntry::BAND, band, band); 
+
+  wlog.readLog(in_name, input_gzipped, acc, num_threads);
   
-  wlog.dumpTables();
+  WSPRLogPartial part("TimeHisto"); 
+  acc.toPartial(part); 
+  WSPRLogReport::timeHisto(part, out_name);
+  acc.reportSkipped(); 
+  if(vm.count("partial") && !part.write(partial_name)) exit(-1); 
+  if(vm.count("binary")) {
+    for(auto tab: { "rx", "tx" }) {
+      CountHistogram h; 
+      h.fromPartial(part, tab); 
+      if(!h.write(out_name + "_TH_" + tab + ".hist")) exit(-1); 
+    }
+  }
 }
@@ -22,29 +22,50 @@ class myWSPRLog : public WSPRLog {
 public:
   myWSPRLog(const std::string fname) : WSPRLog() {
     os.open(fname); 
+    skipped = 0; 
   }
 
   ~myWSPRLog() {
+    flushBlock(); 
     os.close();
   }
 
   bool processEntry(WSPRLogEntry * ent) {
     if(ent == NULL) return false; 
+
+    if(!sol_block.add(ent->dtime, ent->txgrid, ent->rxgrid)) {
+      // no solar time without both ends
+      skipped++; 
+      return false; 
+    }
+    // hang on to the entry until its block has been converted
+    block_ents.push_back(ent); 
+    if(sol_block.full()) flushBlock(); 
     
-    // calculate solar time for rx, tx, and midpoint 
-    SolarTime tx_time(ent->dtime, ent->txgrid);
-    SolarTime rx_time(ent->dtime, ent->rxgrid);    
-    float mid_hour = TimeCorr::circularMean(24.0, tx_time.getFHour(), rx_time.getFHour());
+    return true; 
+  }
 
-    ent->dtime = ((int) floor(mid_hour * 60.0)); // minutes past the hour
+  void flushBlock() {
+    if(sol_block.empty()) return; 
 
-    ent->print(os);
-    
-    return false; 
+    // calculate solar time for rx, tx, and midpoint 
+    sol_block.compute(); 
+    for(size_t i = 0; i < block_ents.size(); i++) {
+      WSPRLogEntry * ent = block_ents[i]; 
+      ent->dtime = ((int) floor(sol_block.mid_hour[i] * 60.0)); // minutes past the hour
+      ent->print(os);
+      delete ent; 
+    }
+    sol_block.clear(); 
+    block_ents.clear(); 
   }
 
+  // spots with a grid that didn't decode
+  uint64_t skipped; 
 
 private:
+  SolarTimeBlock sol_block; 
+  std::vector<WSPRLogEntry *> block_ents; 
   std::ofstream os; 
 }; 
 
@@ -96,4 +117,8 @@ int main(int argc, char * argv[])
   myWSPRLog wlog(out_name);
 
   wlog.readLog(in_name);
+  wlog.flushBlock(); 
+  if(wlog.skipped) {
+    std::cerr << boost::format("Skipped %d spots with a malformed rx or tx grid\n") % wlog.skipped; 
+  }
 }
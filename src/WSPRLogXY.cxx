@@ -1,4 +1,5 @@
 #include "WSPRLog.hxx"
+#include "BinaryIO.hxx"
 
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
@@ -11,6 +12,9 @@
 #include <list>
 #include <math.h>
 #include <set>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
 
 // plot distance, azimuth pairs. 
 class myWSPRLog : public WSPRLog {
@@ -20,6 +24,9 @@ public:
     xsel = _xsel; 
     ysel = _ysel;
     os.open(out_name);
+
+    // we only look at entries through getField
+    setLazyDecode(true); 
   }
 
 
@@ -32,7 +39,7 @@ public:
     ent->getField(xsel, x);
     ent->getField(ysel, y);
 
-    os << x << " " << y << std::endl; 
+    os << x << " " << y << "\n"; 
     return false;
   }
 
@@ -42,10 +49,140 @@ private:
   WSPRLogEntry::Field xsel, ysel; 
 }; 
 
+// one axis of a binned plot: bins equal bins from lo to hi
+class XYAxis {
+public:
+  XYAxis() { lo = 0.0; hi = 1.0; bins = 1; }
+
+  // "lo:hi:bins"
+  bool parse(const std::string & spec) {
+    if(sscanf(spec.c_str(), "%lf:%lf:%d", &lo, &hi, &bins) != 3) return false; 
+    return (hi > lo) && (bins > 0); 
+  }
+
+  // the bin, or -1 if v is off the ends of the axis
+  int index(double v) const {
+    double x = (v - lo) * (((double) bins) / (hi - lo)); 
+    if(!(x >= 0.0)) return -1; 
+    int b = (int) x; 
+    return (b < bins) ? b : -1; 
+  }
+
+  double center(int b) const { 
+    return lo + (((double) b) + 0.5) * ((hi - lo) / ((double) bins)); 
+  }
+
+  double lo, hi; 
+  int bins; 
+}; 
+
+// counts of x, y pairs in a bins x bins matrix, so the output is
+// the same size however many spots there are.
+class myBinAccumulator : public WSPRLogAccumulator {
+public:
+  myBinAccumulator(WSPRLogEntry::Field _xsel, WSPRLogEntry::Field _ysel,
+		   const XYAxis & _xax, const XYAxis & _yax) {
+    xsel = _xsel; 
+    ysel = _ysel; 
+    xax = _xax; 
+    yax = _yax; 
+    // row major: a row for each y bin
+    counts.assign(((size_t) xax.bins) * ((size_t) yax.bins), 0); 
+    dropped = 0; 
+    no_value = 0; 
+  }
+
+  WSPRLogAccumulator * clone() const { 
+    return new myBinAccumulator(xsel, ysel, xax, yax); 
+  }
+
+  void merge(const WSPRLogAccumulator & other) {
+    const myBinAccumulator & o = static_cast<const myBinAccumulator &>(other); 
+    for(size_t i = 0; i < counts.size(); i++) counts[i] += o.counts[i]; 
+    dropped += o.dropped; 
+    no_value += o.no_value; 
+  }
+
+  void add(WSPRLogEntry * ent) {
+    double x, y; 
+    // integer fields (FREQ_DIFF, BAND ...) too, not just the doubles
+    if(!ent->getNumber(xsel, x) || !ent->getNumber(ysel, y)) {
+      no_value++; 
+      return; 
+    }
+    int xb = xax.index(x); 
+    int yb = yax.index(y); 
+    if((xb < 0) || (yb < 0)) {
+      dropped++; 
+      return; 
+    }
+    counts[((size_t) yb) * xax.bins + xb]++; 
+  }
+
+  uint64_t getDropped() const { return dropped; }
+  uint64_t getNoValue() const { return no_value; }
+
+  // text: a comment header, then a line of x counts for each y bin.
+  // gnuplot: plot 'file' matrix with image, numpy: loadtxt
+  void writeMatrix(std::ostream & os) {
+    os << boost::format("# x %g to %g in %d bins (columns), y %g to %g in %d bins (rows)\n")
+      % xax.lo % xax.hi % xax.bins % yax.lo % yax.hi % yax.bins; 
+    for(int yb = 0; yb < yax.bins; yb++) {
+      for(int xb = 0; xb < xax.bins; xb++) {
+	if(xb != 0) os << " "; 
+	os << counts[((size_t) yb) * xax.bins + xb]; 
+      }
+      os << "\n"; 
+    }
+  }
+
+  // gnuplot's "binary matrix": all float32, a first row of the number
+  // of columns and the x bin centers, then for each y bin its center
+  // and the counts.  plot 'file' binary matrix with image
+  void writeGnuplotBinary(std::ostream & os) {
+    BinaryIO::put<float>(os, (float) xax.bins); 
+    for(int xb = 0; xb < xax.bins; xb++) BinaryIO::put<float>(os, (float) xax.center(xb)); 
+    for(int yb = 0; yb < yax.bins; yb++) {
+      BinaryIO::put<float>(os, (float) yax.center(yb)); 
+      for(int xb = 0; xb < xax.bins; xb++) {
+	BinaryIO::put<float>(os, (float) counts[((size_t) yb) * xax.bins + xb]); 
+      }
+    }
+  }
+
+  // numpy .npy (version 1.0): a (y bins, x bins) array of uint64.
+  // Like the other binary files, this is in the machine's byte order,
+  // and the header says that order is little endian.
+  void writeNpy(std::ostream & os) {
+    std::string hdr = (boost::format("{'descr': '<u8', 'fortran_order': False, 'shape': (%d, %d), }")
+		       % yax.bins % xax.bins).str(); 
+    // magic, version, and length take 10 bytes; pad the header with
+    // spaces and a newline so the data starts on a 64 byte boundary
+    size_t total = 10 + hdr.size() + 1; 
+    hdr.append((64 - (total % 64)) % 64, ' '); 
+    hdr.push_back('\n'); 
+    os.write("\x93NUMPY\x01\x00", 8); 
+    BinaryIO::put<uint16_t>(os, hdr.size()); 
+    os.write(hdr.data(), hdr.size()); 
+    os.write((const char *) counts.data(), counts.size() * sizeof(uint64_t)); 
+  }
+
+private:
+  WSPRLogEntry::Field xsel, ysel; 
+  XYAxis xax, yax; 
+  std::vector<uint64_t> counts; 
+  uint64_t dropped; 
+  // spots where x or y isn't a number
+  uint64_t no_value; 
+}; 
+
 int main(int argc, char * argv[])
 {
   std::string in_name, out_name, x_field_selector, y_field_selector;
+  std::string x_axis_spec, y_axis_spec, format; 
   bool input_gzipped; 
+  int band; 
+  int num_threads; 
   namespace po = boost::program_options;
 
 
@@ -57,6 +194,11 @@ int main(int argc, char * argv[])
     ("out", po::value<std::string>(&out_name)->required(), "Output data file")
     ("x_field", po::value<std::string>(&x_field_selector)->required(), "Numeric field to use for x coordinate")
     ("y_field", po::value<std::string>(&y_field_selector)->required(), "Numeric field to use for y coordinate")
+    ("band", po::value<int>(&band), "Only use reports from this band (wsprnet band number, e.g. 10 for 30m)")
+    ("x_bins", po::value<std::string>(&x_axis_spec), "Bin x as lo:hi:bins.  With y_bins, write counts in a matrix instead of a line per spot.")
+    ("y_bins", po::value<std::string>(&y_axis_spec), "Bin y as lo:hi:bins")
+    ("format", po::value<std::string>(&format)->default_value("matrix"), "Binned output as a text matrix (matrix), gnuplot binary matrix (gnuplot), or numpy array (npy)")
+    ("threads", po::value<int>(&num_threads)->default_value(1), "Number of worker threads (binned output only)")
     ("igz", po::value<bool>(&input_gzipped)->default_value(false), "if true, input file is gzip compressed");
   
   po::positional_options_description pos_opts ;
@@ -103,7 +245,42 @@ int main(int argc, char * argv[])
     exit(-1); 
   }
 
+  if(vm.count("x_bins") || vm.count("y_bins")) {
+    XYAxis xax, yax; 
+    if(!xax.parse(x_axis_spec) || !yax.parse(y_axis_spec)) {
+      std::cerr << "ERROR: binned output needs both x_bins and y_bins, as lo:hi:bins with lo < hi\n"; 
+      exit(-1); 
+    }
+    if((format != "matrix") && (format != "gnuplot") && (format != "npy")) {
+      std::cerr << "ERROR: format must be one of matrix, gnuplot, or npy" << std::endl; 
+      exit(-1); 
+    }
+
+    WSPRLog wlog; 
+    myBinAccumulator acc(xsel, ysel, xax, yax); 
+    // we only look at entries through getField
+    wlog.setLazyDecode(true); 
+    if(vm.count("band")) wlog.addPreFilter(WSPRLogEntry::BAND, band, band); 
+    wlog.readLog(in_name, input_gzipped, acc, num_threads);
+
+    std::ofstream os(out_name, std::ios::binary); 
+    if(format == "matrix") acc.writeMatrix(os); 
+    else if(format == "gnuplot") acc.writeGnuplotBinary(os); 
+    else acc.writeNpy(os); 
+    os.close(); 
+
+    if(acc.getDropped()) {
+      std::cerr << boost::format("%d spots fell outside the x or y range and were not counted\n") % acc.getDropped(); 
+    }
+    if(acc.getNoValue()) {
+      std::cerr << boost::format("%d spots had no numeric x or y value and were not counted\n") % acc.getNoValue(); 
+    }
+    return 0; 
+  }
+
   myWSPRLog wlog(xsel, ysel, out_name); 
 
+  if(vm.count("band")) wlog.addPreFilter(WSPRLogEntry::BAND, band, band); 
+
   wlog.readLog(in_name, input_gzipped);
 }